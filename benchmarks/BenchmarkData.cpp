@@ -0,0 +1,59 @@
+#include "BenchmarkData.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+
+#include "utils/BencodeWriter.hpp"
+
+std::vector<std::filesystem::path> bench::ResourceTorrents() {
+    std::vector<std::filesystem::path> result;
+    for (const auto& entry : std::filesystem::directory_iterator(
+        TORRENT_CLIENT_RESOURCES_DIR
+    )) {
+        if (entry.path().extension() == ".torrent") {
+            result.push_back(entry.path());
+        }
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+std::filesystem::path bench::SyntheticTorrent(size_t piece_count) {
+    auto path = std::filesystem::temp_directory_path() / (
+        "torrent-client-bench-" + std::to_string(piece_count) + ".torrent"
+    );
+    if (std::filesystem::exists(path)) {
+        return path;
+    }
+
+    constexpr size_t kPieceLength = 256 * 1024;
+    std::string encoded;
+    utils::BencodeWriter writer(encoded);
+    writer.BeginDict()
+        .Key("announce").String("http://127.0.0.1:6969/announce")
+        .Key("comment").String("synthetic benchmark torrent")
+        .Key("info").BeginDict()
+            .Key("length").Integer(piece_count * kPieceLength)
+            .Key("name").String("synthetic.bin")
+            .Key("piece length").Integer(kPieceLength)
+            .Key("pieces").String(RandomBytes(piece_count * 20))
+        .End()
+    .End();
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file.write(encoded.data(), encoded.size())) {
+        throw std::runtime_error("Cannot write " + path.string());
+    }
+    return path;
+}
+
+std::string bench::RandomBytes(size_t size) {
+    std::mt19937 gen(42);
+    std::string result(size, '\0');
+    for (auto& ch : result) {
+        ch = static_cast<char>(gen());
+    }
+    return result;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+// .torrent files shipped in resources/.
+std::vector<std::filesystem::path> ResourceTorrents();
+
+// Single-file torrent with `piece_count` pieces, written once to the temp
+// directory and reused by every benchmark that asks for the same size.
+std::filesystem::path SyntheticTorrent(size_t piece_count);
+
+std::string RandomBytes(size_t size);
+
+} // namespace bench
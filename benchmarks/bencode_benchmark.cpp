@@ -0,0 +1,141 @@
+#include <benchmark/benchmark.h>
+
+#include "BenchmarkData.hpp"
+#include "core/TorrentCache.hpp"
+#include "core/TorrentFile.hpp"
+#include "utils/BencodeDocument.hpp"
+#include "utils/BencodeParser.hpp"
+#include "utils/BencodeStreamParser.hpp"
+#include "utils/BencodeTokenizer.hpp"
+#include "utils/BencodeWriter.hpp"
+#include "utils/InputBuffer.hpp"
+
+namespace {
+
+std::filesystem::path TorrentForArg(int64_t arg) {
+    if (arg >= 0) {
+        return bench::ResourceTorrents().at(arg);
+    }
+    return bench::SyntheticTorrent(100'000);
+}
+
+// Non-negative arguments index resources/*.torrent, -1 is the synthetic
+// 100k-piece torrent.
+void TorrentArgs(benchmark::internal::Benchmark* benchmark) {
+    for (size_t i = 0; i < bench::ResourceTorrents().size(); ++i) {
+        benchmark->Arg(i);
+    }
+    benchmark->Arg(-1);
+}
+
+// `bytes` is what one iteration consumed, the whole file by default.
+void SetLabel(
+    benchmark::State& state,
+    const std::filesystem::path& path,
+    size_t bytes
+) {
+    state.SetLabel(path.filename().string());
+    state.SetBytesProcessed(state.iterations() * bytes);
+}
+
+void SetLabel(benchmark::State& state, const std::filesystem::path& path) {
+    SetLabel(state, path, std::filesystem::file_size(path));
+}
+
+void BM_BencodeParser_ParseFromFile(benchmark::State& state) {
+    auto path = TorrentForArg(state.range(0));
+    for (auto _ : state) {
+        utils::BencodeParser parser;
+        benchmark::DoNotOptimize(parser.ParseFromFile(path.string()));
+        benchmark::DoNotOptimize(parser.GetPieceHashes());
+    }
+    SetLabel(state, path);
+}
+BENCHMARK(BM_BencodeParser_ParseFromFile)->Apply(TorrentArgs);
+
+void BM_BencodeTokenizer(benchmark::State& state) {
+    auto path = TorrentForArg(state.range(0));
+    auto buffer = utils::InputBuffer::FromFile(path.string());
+    auto input = buffer.View();
+    for (auto _ : state) {
+        utils::BencodeTokenizer tokenizer(input);
+        utils::BencodeToken token;
+        while (tokenizer.Next(token)) {
+            benchmark::DoNotOptimize(token);
+        }
+    }
+    SetLabel(state, path, input.size());
+}
+BENCHMARK(BM_BencodeTokenizer)->Apply(TorrentArgs);
+
+// Input arrives in 16 KiB chunks, as from a socket.
+void BM_BencodeStreamParser(benchmark::State& state) {
+    static constexpr size_t kChunkSize = 16 * 1024;
+    auto path = TorrentForArg(state.range(0));
+    auto buffer = utils::InputBuffer::FromFile(path.string());
+    auto input = buffer.View();
+    utils::BencodeHandler handler;
+    for (auto _ : state) {
+        utils::BencodeStreamParser parser(handler);
+        for (size_t offset = 0; offset < input.size(); offset += kChunkSize) {
+            parser.Feed(input.substr(offset, kChunkSize));
+        }
+        parser.Finish();
+    }
+    SetLabel(state, path, input.size());
+}
+BENCHMARK(BM_BencodeStreamParser)->Apply(TorrentArgs);
+
+void BM_BencodeDocument_FromFile(benchmark::State& state) {
+    auto path = TorrentForArg(state.range(0));
+    for (auto _ : state) {
+        auto document = utils::BencodeDocument::FromFile(path.string());
+        benchmark::DoNotOptimize(document.Query("info.piece length"));
+    }
+    SetLabel(state, path);
+}
+BENCHMARK(BM_BencodeDocument_FromFile)->Apply(TorrentArgs);
+
+void BM_LoadTorrentFile(benchmark::State& state) {
+    auto path = TorrentForArg(state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(LoadTorrentFile(path.string()));
+    }
+    SetLabel(state, path);
+}
+BENCHMARK(BM_LoadTorrentFile)->Apply(TorrentArgs);
+
+// Warm cache load, including the checksum of the .torrent that keys it;
+// the cache goes to the temp directory rather than the user's.
+void BM_LoadTorrentCache(benchmark::State& state) {
+    auto path = TorrentForArg(state.range(0));
+    auto cache_directory = std::filesystem::temp_directory_path() / "torrent-client-bench-cache";
+    SaveTorrentCache(LoadTorrentFile(path.string()), path, cache_directory);
+
+    for (auto _ : state) {
+        auto torrent_file = LoadTorrentCache(path, "", cache_directory);
+        if (!torrent_file) {
+            state.SkipWithError("metadata cache rejected");
+            break;
+        }
+        benchmark::DoNotOptimize(torrent_file->piece_hashes.Size());
+    }
+    SetLabel(state, path);
+}
+BENCHMARK(BM_LoadTorrentCache)->Apply(TorrentArgs);
+
+void BM_BencodeWriter_Document(benchmark::State& state) {
+    auto path = TorrentForArg(state.range(0));
+    auto document = utils::BencodeDocument::FromFile(path.string());
+    std::string output;
+    for (auto _ : state) {
+        output.clear();
+        utils::BencodeWriter writer(output);
+        writer.Value(document.Root());
+        benchmark::DoNotOptimize(output.data());
+    }
+    SetLabel(state, path);
+}
+BENCHMARK(BM_BencodeWriter_Document)->Apply(TorrentArgs);
+
+} // namespace
@@ -0,0 +1,67 @@
+#include <benchmark/benchmark.h>
+
+#include "BenchmarkData.hpp"
+#include "utils/Sha256.hpp"
+#include "utils/byte_tools.hpp"
+
+namespace {
+
+void BM_CalculateSha1(benchmark::State& state) {
+    auto data = bench::RandomBytes(state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(utils::CalculateSha1(data));
+    }
+    state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_CalculateSha1)->Arg(16 << 10)->Arg(256 << 10)->Arg(4 << 20);
+
+void BM_Sha256(benchmark::State& state) {
+    auto data = bench::RandomBytes(state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(utils::Sha256(data));
+    }
+    state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_Sha256)->Arg(64)->Arg(16 << 10)->Arg(4 << 20);
+
+void BM_Int32ToBytes(benchmark::State& state) {
+    int32_t value = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(utils::Int32ToBytes(value++));
+    }
+}
+BENCHMARK(BM_Int32ToBytes);
+
+void BM_BytesToInt32(benchmark::State& state) {
+    auto bytes = utils::Int32ToBytes(0x12345678);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(utils::BytesToInt32(bytes));
+    }
+}
+BENCHMARK(BM_BytesToInt32);
+
+void BM_Int64ToBytes(benchmark::State& state) {
+    uint64_t value = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(utils::Int64ToBytes(value++));
+    }
+}
+BENCHMARK(BM_Int64ToBytes);
+
+void BM_BytesToInt64(benchmark::State& state) {
+    auto bytes = utils::Int64ToBytes(0x0123456789abcdefULL);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(utils::BytesToInt64(bytes));
+    }
+}
+BENCHMARK(BM_BytesToInt64);
+
+void BM_HexEncode(benchmark::State& state) {
+    auto data = bench::RandomBytes(20);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(utils::HexEncode(data));
+    }
+}
+BENCHMARK(BM_HexEncode);
+
+} // namespace
@@ -0,0 +1,48 @@
+#include <benchmark/benchmark.h>
+
+#include "core/Block.hpp"
+#include "net/Message.hpp"
+
+namespace {
+
+void BM_Message_ParseHave(benchmark::State& state) {
+    auto message = wire::Encode(wire::Have{ 42 });
+    std::string_view data(message.data(), message.size());
+    for (auto _ : state) {
+        auto frame = wire::ParseFrame(data);
+        benchmark::DoNotOptimize(wire::Decode<wire::Have>(frame.payload));
+    }
+}
+BENCHMARK(BM_Message_ParseHave);
+
+void BM_Message_ParsePiece(benchmark::State& state) {
+    auto message = wire::EncodeWithTrailer(
+        wire::PieceHeader{ 42, 0 },
+        std::string(Block::kSize, 'x')
+    );
+    for (auto _ : state) {
+        auto frame = wire::ParseFrame(message);
+        benchmark::DoNotOptimize(wire::Decode<wire::PieceHeader>(frame.payload));
+        benchmark::DoNotOptimize(wire::Trailer<wire::PieceHeader>(frame.payload));
+    }
+}
+BENCHMARK(BM_Message_ParsePiece);
+
+void BM_Message_EncodeRequest(benchmark::State& state) {
+    uint32_t index = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(
+            wire::Encode(wire::Request{ index++, 3 * Block::kSize, Block::kSize })
+        );
+    }
+}
+BENCHMARK(BM_Message_EncodeRequest);
+
+void BM_Message_EncodeInterested(benchmark::State& state) {
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(wire::Encode<wire::Interested>());
+    }
+}
+BENCHMARK(BM_Message_EncodeInterested);
+
+} // namespace
@@ -0,0 +1,231 @@
+#include <cstdint>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <benchmark/benchmark.h>
+
+#include "BenchmarkData.hpp"
+#include "core/Piece.hpp"
+#include "utils/AlignedBuffer.hpp"
+#include "utils/Sha1Hasher.hpp"
+#include "utils/Sha256.hpp"
+#include "utils/byte_tools.hpp"
+
+namespace {
+
+uint64_t ReadCycleCounter() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+utils::Sha1Digest DigestOf(std::string_view data) {
+    utils::Sha1Hasher hasher;
+    hasher.Update(data);
+    return hasher.Finish();
+}
+
+Piece MakeRetrievedPiece(const std::string& data) {
+    Piece piece(0, data.size(), DigestOf(data));
+    while (auto block = piece.GetFirstMissingBlock()) {
+        piece.SaveBlock(block->offset, data.substr(block->offset, block->length));
+    }
+    return piece;
+}
+
+void SetBytesPerCycle(benchmark::State& state, uint64_t cycles, size_t bytes) {
+    state.SetBytesProcessed(state.iterations() * bytes);
+    if (cycles > 0) {
+        state.counters["bytes_per_cycle"] =
+            static_cast<double>(state.iterations() * bytes) / cycles;
+    }
+}
+
+void BM_Piece_SaveBlock(benchmark::State& state) {
+    const size_t length = state.range(0);
+    auto data = bench::RandomBytes(length);
+    auto digest = DigestOf(data);
+
+    for (auto _ : state) {
+        Piece piece(0, length, digest);
+        while (auto block = piece.GetFirstMissingBlock()) {
+            piece.SaveBlock(block->offset, data.substr(block->offset, block->length));
+        }
+        benchmark::DoNotOptimize(piece.AllBlocksRetrieved());
+    }
+    state.SetBytesProcessed(state.iterations() * length);
+}
+BENCHMARK(BM_Piece_SaveBlock)->Arg(256 << 10)->Arg(4 << 20);
+
+void BM_Piece_GetData(benchmark::State& state) {
+    auto piece = MakeRetrievedPiece(bench::RandomBytes(state.range(0)));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(piece.GetData());
+    }
+    state.SetBytesProcessed(state.iterations() * piece.GetLength());
+}
+BENCHMARK(BM_Piece_GetData)->Arg(256 << 10)->Arg(4 << 20);
+
+// Completing a piece the old way: verify from one GetData() copy, then
+// write from another.
+void BM_PieceCompletion_Legacy(benchmark::State& state) {
+    auto piece = MakeRetrievedPiece(bench::RandomBytes(state.range(0)));
+    const auto& hash = piece.GetHash();
+
+    uint64_t start = ReadCycleCounter();
+    for (auto _ : state) {
+        bool matches = utils::CalculateSha1(piece.GetData())
+            == std::string_view(hash.data(), hash.size());
+        std::string staged = piece.GetData();
+        benchmark::DoNotOptimize(matches);
+        benchmark::DoNotOptimize(staged.data());
+    }
+    SetBytesPerCycle(state, ReadCycleCounter() - start, piece.GetLength());
+}
+BENCHMARK(BM_PieceCompletion_Legacy)->Arg(256 << 10)->Arg(4 << 20);
+
+// Both completion paths are bound by SHA-1, which runs an order of
+// magnitude slower than the copies; this is the floor for either.
+void BM_PieceCompletion_HashOnly(benchmark::State& state) {
+    auto data = bench::RandomBytes(state.range(0));
+
+    uint64_t start = ReadCycleCounter();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(DigestOf(data));
+    }
+    SetBytesPerCycle(state, ReadCycleCounter() - start, data.size());
+}
+BENCHMARK(BM_PieceCompletion_HashOnly)->Arg(256 << 10)->Arg(4 << 20);
+
+void BM_PieceCompletion_Fused(benchmark::State& state) {
+    auto piece = MakeRetrievedPiece(bench::RandomBytes(state.range(0)));
+
+    uint64_t start = ReadCycleCounter();
+    for (auto _ : state) {
+        utils::AlignedBuffer staged(piece.GetLength());
+        bool matches = piece.CopyDataAndHash(staged.Data()) == piece.GetHash();
+        benchmark::DoNotOptimize(matches);
+        benchmark::DoNotOptimize(staged.Data());
+    }
+    SetBytesPerCycle(state, ReadCycleCounter() - start, piece.GetLength());
+}
+BENCHMARK(BM_PieceCompletion_Fused)->Arg(256 << 10)->Arg(4 << 20);
+
+std::vector<utils::Sha256Digest> LeafHashes(std::string_view data) {
+    std::vector<utils::Sha256Digest> leaves;
+    for (size_t offset = 0; offset < data.size(); offset += Block::kSize) {
+        leaves.push_back(utils::Sha256(data.substr(offset, Block::kSize)));
+    }
+    leaves.resize(utils::NextPowerOfTwo(leaves.size()));
+    return leaves;
+}
+
+Piece MakeMerklePiece(std::string_view data, const std::vector<utils::Sha256Digest>& leaves) {
+    Piece piece(0, data.size(), utils::Sha1Digest{});
+    piece.SetMerkleRoot(
+        utils::MerkleRoot(leaves, leaves.size()),
+        leaves.size(),
+        data.size()
+    );
+    return piece;
+}
+
+// Returns the number of bytes handed to the piece, re-requests included.
+size_t SaveAllBlocks(Piece& piece, const std::string& data, size_t corrupt_offset = SIZE_MAX) {
+    size_t transferred = 0;
+    while (auto block = piece.GetFirstMissingBlock()) {
+        transferred += block->length;
+        auto block_data = data.substr(block->offset, block->length);
+        if (block->offset == corrupt_offset) {
+            block_data[0] ^= 1;
+            corrupt_offset = SIZE_MAX;
+        }
+        piece.SaveBlock(block->offset, std::move(block_data));
+    }
+    return transferred;
+}
+
+// v1: blocks are stored as they arrive, the piece is hashed with SHA-1
+// while it is copied out on completion.
+void BM_PieceVerify_V1Sha1(benchmark::State& state) {
+    auto data = bench::RandomBytes(state.range(0));
+    auto digest = DigestOf(data);
+    utils::AlignedBuffer staged(data.size());
+
+    for (auto _ : state) {
+        Piece piece(0, data.size(), digest);
+        SaveAllBlocks(piece, data);
+        bool matches = piece.CopyDataAndHash(staged.Data()) == digest;
+        benchmark::DoNotOptimize(matches);
+    }
+    state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_PieceVerify_V1Sha1)->Arg(256 << 10)->Arg(4 << 20);
+
+// v2: every block is hashed with SHA-256 as it arrives, completion only
+// hashes the tree above the leaves.
+void BM_PieceVerify_V2Merkle(benchmark::State& state) {
+    auto data = bench::RandomBytes(state.range(0));
+    auto leaves = LeafHashes(data);
+    utils::AlignedBuffer staged(data.size());
+
+    for (auto _ : state) {
+        auto piece = MakeMerklePiece(data, leaves);
+        SaveAllBlocks(piece, data);
+        bool matches = piece.MerkleRootMatches();
+        piece.CopyData(staged.Data());
+        benchmark::DoNotOptimize(matches);
+    }
+    state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_PieceVerify_V2Merkle)->Arg(256 << 10)->Arg(4 << 20);
+
+// One corrupt block: v1 can only discard and re-download the whole piece,
+// v2 with leaf hashes rejects the block on arrival and fetches it again.
+void BM_CorruptBlockRecovery_V1(benchmark::State& state) {
+    auto data = bench::RandomBytes(state.range(0));
+    auto digest = DigestOf(data);
+    utils::AlignedBuffer staged(data.size());
+    size_t refetched = 0;
+
+    for (auto _ : state) {
+        Piece piece(0, data.size(), digest);
+        SaveAllBlocks(piece, data, data.size() / 2 / Block::kSize * Block::kSize);
+        if (piece.CopyDataAndHash(staged.Data()) != digest) {
+            piece.Reset();
+            refetched += data.size();
+            SaveAllBlocks(piece, data);
+        }
+        benchmark::DoNotOptimize(piece.CopyDataAndHash(staged.Data()) == digest);
+    }
+    state.counters["refetched_bytes"] = benchmark::Counter(
+        refetched, benchmark::Counter::kAvgIterations
+    );
+}
+BENCHMARK(BM_CorruptBlockRecovery_V1)->Arg(4 << 20);
+
+void BM_CorruptBlockRecovery_V2(benchmark::State& state) {
+    auto data = bench::RandomBytes(state.range(0));
+    auto leaves = LeafHashes(data);
+    size_t refetched = 0;
+
+    for (auto _ : state) {
+        auto piece = MakeMerklePiece(data, leaves);
+        piece.SetBlockHashes(leaves);
+        refetched += SaveAllBlocks(
+            piece, data, data.size() / 2 / Block::kSize * Block::kSize
+        ) - data.size();
+        benchmark::DoNotOptimize(piece.MerkleRootMatches());
+    }
+    state.counters["refetched_bytes"] = benchmark::Counter(
+        refetched, benchmark::Counter::kAvgIterations
+    );
+}
+BENCHMARK(BM_CorruptBlockRecovery_V2)->Arg(4 << 20);
+
+} // namespace
@@ -0,0 +1,116 @@
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "core/PieceStorage.hpp"
+#include "core/TorrentFile.hpp"
+#include "utils/byte_tools.hpp"
+
+namespace {
+
+struct Workload {
+    TorrentFile torrent_file;
+    std::string piece_data;
+};
+
+Workload MakeWorkload(size_t total_size, size_t piece_length) {
+    Workload workload;
+    workload.piece_data.resize(piece_length);
+
+    std::mt19937 gen(42);
+    for (auto& ch : workload.piece_data) {
+        ch = static_cast<char>(gen());
+    }
+
+    auto& torrent_file = workload.torrent_file;
+    torrent_file.name = "storage-throughput.bin";
+    torrent_file.piece_length = piece_length;
+    torrent_file.length = total_size;
+
+    // Every piece carries the same bytes, the last one is truncated.
+    std::string full_hash = utils::CalculateSha1(workload.piece_data);
+    std::string packed_hashes;
+    for (size_t offset = 0; offset < total_size; offset += piece_length) {
+        size_t length = std::min(piece_length, total_size - offset);
+        if (length == piece_length) {
+            packed_hashes += full_hash;
+        } else {
+            packed_hashes += utils::CalculateSha1(
+                std::string_view(workload.piece_data).substr(0, length)
+            );
+        }
+    }
+    torrent_file.piece_hashes = PieceHashes(packed_hashes);
+    torrent_file.files.push_back(TorrentFile::File{torrent_file.name, total_size, 0, ""});
+
+    return workload;
+}
+
+void Run(
+    const Workload& workload,
+    const std::filesystem::path& output_directory,
+    bool direct_io
+) {
+    StorageOptions options;
+    options.direct_io = direct_io;
+    options.read_cache_bytes = 0;
+
+    auto start = std::chrono::steady_clock::now();
+
+    PieceStorage storage(workload.torrent_file, output_directory, options);
+    while (auto piece = storage.GetNextPieceToDownload()) {
+        while (auto block = piece->GetFirstMissingBlock()) {
+            piece->SaveBlock(
+                block->offset,
+                workload.piece_data.substr(block->offset, block->length)
+            );
+        }
+        storage.PieceProcessed(piece);
+    }
+    storage.CloseOutputFile();
+
+    auto elapsed = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start
+    ).count();
+    double mib = static_cast<double>(workload.torrent_file.length) / (1 << 20);
+
+    std::cout
+        << std::left << std::setw(10)
+        << (direct_io ? (storage.IsDirectIo() ? "direct" : "fallback") : "buffered")
+        << std::fixed << std::setprecision(1)
+        << mib / elapsed << " MiB/s ("
+        << std::setprecision(3) << elapsed << " s)"
+        << std::endl;
+
+    std::filesystem::remove(output_directory / workload.torrent_file.name);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr
+            << "Usage: "
+            << argv[0]
+            << " <output-directory> [size-MiB] [piece-KiB]"
+            << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::filesystem::path output_directory = argv[1];
+    size_t size_mib = argc > 2 ? std::stoul(argv[2]) : 1024;
+    size_t piece_kib = argc > 3 ? std::stoul(argv[3]) : 4096;
+
+    // Odd tail so the unaligned last piece is exercised as well.
+    auto workload = MakeWorkload(
+        size_mib * (1 << 20) + 12345,
+        piece_kib * 1024
+    );
+
+    Run(workload, output_directory, false);
+    Run(workload, output_directory, true);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,90 @@
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "core/LocalTracker.hpp"
+#include "core/TrackerAnnouncer.hpp"
+
+namespace {
+
+constexpr size_t kSwarmSize = 200;
+
+LocalTrackerOptions SwarmOptions() {
+    LocalTrackerOptions options;
+    for (uint32_t n = 1; n <= kSwarmSize; ++n) {
+        options.peers.push_back(Peer::FromIpv4(0x0A000000 | n, 6881));
+    }
+    // Repeated rounds would otherwise grow the swarm with our own entry.
+    options.track_announcers = false;
+    return options;
+}
+
+AnnounceParams BenchmarkParams() {
+    AnnounceParams params;
+    params.info_hash = std::string(20, 'b');
+    params.peer_id = "-BM0001-benchmark000";
+    params.port = 6881;
+    params.left = 1;
+    return params;
+}
+
+// Distinct URLs for one tracker, so each counts as its own tracker.
+std::vector<std::string> TrackerUrls(const std::string& announce_url, size_t count) {
+    std::vector<std::string> urls;
+    for (size_t i = 0; i < count; ++i) {
+        urls.push_back(announce_url + "?tracker=" + std::to_string(i));
+    }
+    return urls;
+}
+
+void RunRounds(benchmark::State& state, TrackerAnnouncer& announcer, const std::vector<std::string>& urls) {
+    auto params = BenchmarkParams();
+    std::atomic<bool> stop{false};
+    size_t peers = 0;
+    size_t failures = 0;
+    for (auto _ : state) {
+        // Waits for every tracker, so lossy rounds include retransmits.
+        announcer.AnnounceAll(urls, params, stop, [&](const AnnounceResult& result) {
+            peers += result.peers.size();
+            failures += result.error.empty() ? 0 : 1;
+        }, announcer.RoundBudget());
+    }
+    state.SetItemsProcessed(state.iterations() * urls.size());
+    state.counters["peers"] = benchmark::Counter(peers, benchmark::Counter::kAvgIterations);
+    state.counters["failures"] = benchmark::Counter(failures, benchmark::Counter::kAvgIterations);
+}
+
+void BM_AnnounceRound_Http(benchmark::State& state) {
+    LocalTracker tracker(SwarmOptions());
+    TrackerAnnouncer announcer;
+    RunRounds(state, announcer, TrackerUrls(tracker.HttpAnnounceUrl(), state.range(0)));
+}
+BENCHMARK(BM_AnnounceRound_Http)->Arg(1)->Arg(16)->Arg(64)->UseRealTime();
+
+void BM_AnnounceRound_Udp(benchmark::State& state) {
+    LocalTracker tracker(SwarmOptions());
+    TrackerAnnouncer announcer;
+    RunRounds(state, announcer, TrackerUrls(tracker.UdpAnnounceUrl(), state.range(0)));
+}
+BENCHMARK(BM_AnnounceRound_Udp)->Arg(1)->Arg(16)->Arg(64)->UseRealTime();
+
+// 20 ms trackers dropping a tenth of the packets, retransmitting after
+// 50 ms instead of BEP 15's 15 s to keep the rounds short.
+void BM_AnnounceRound_UdpLossy(benchmark::State& state) {
+    auto options = SwarmOptions();
+    options.latency = std::chrono::milliseconds(20);
+    options.loss_rate = 0.1;
+    LocalTracker tracker(options);
+
+    UdpTrackerOptions udp_options;
+    udp_options.retransmit_timeout = std::chrono::milliseconds(50);
+    udp_options.max_retransmits = 4;
+    UdpTrackerEngine engine(udp_options);
+    TrackerAnnouncer announcer(engine);
+    RunRounds(state, announcer, TrackerUrls(tracker.UdpAnnounceUrl(), state.range(0)));
+}
+BENCHMARK(BM_AnnounceRound_UdpLossy)->Arg(16)->UseRealTime();
+
+} // namespace
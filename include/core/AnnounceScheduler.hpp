@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core/TrackerAnnouncer.hpp"
+#include "core/TrackerRanking.hpp"
+
+struct TransferStats {
+    uint64_t uploaded = 0;
+    uint64_t downloaded = 0;
+    uint64_t left = 0;
+};
+
+// Keeps one torrent announced for as long as it runs. Each tracker is
+// re-announced on its own interval, never sooner than its min interval,
+// and failing trackers are retried with exponential backoff. Started,
+// completed and stopped events carry the torrent's live counters. Every
+// answer, and a scrape after the first round and then every
+// kScrapeInterval, feeds the tracker ranking that orders each round.
+class AnnounceScheduler {
+public:
+    using StatsProvider = std::function<TransferStats()>;
+
+    AnnounceScheduler(TrackerAnnouncer& announcer, TrackerRanking& ranking);
+    ~AnnounceScheduler();
+
+    AnnounceScheduler(const AnnounceScheduler&) = delete;
+    AnnounceScheduler& operator=(const AnnounceScheduler&) = delete;
+
+    // Announces started to every tracker right away. on_result runs on the
+    // scheduler thread; stats is asked for the counters before each round.
+    void Start(
+        const std::vector<std::string>& trackers,
+        const AnnounceParams& params,
+        StatsProvider stats,
+        TrackerAnnouncer::ResultCallback on_result
+    );
+
+    // Announces completed to the trackers that saw the torrent start.
+    void Completed();
+
+    // Re-announces early to get more peers, as soon as each tracker's min
+    // interval allows.
+    void RequestPeers();
+
+    // Ends the schedule, then tells the trackers that saw the torrent
+    // start that it stopped, waiting at most kStopTimeout. The stats
+    // provider must stay valid until this returns.
+    void Stop();
+
+    // True from Start until the first round is over and whenever a round
+    // is in progress.
+    bool IsAnnouncing() const { return announcing; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Tracker {
+        std::string url;
+        Clock::time_point next_announce;
+        // Earliest time the tracker accepts an extra announce.
+        Clock::time_point earliest_announce;
+        int failures = 0;
+        // The tracker acknowledged the event.
+        bool started = false;
+        bool completed = false;
+    };
+
+    static constexpr std::chrono::seconds kDefaultInterval{1800};
+    static constexpr std::chrono::seconds kDefaultMinInterval{120};
+    static constexpr std::chrono::seconds kRetryDelay{30};
+    static constexpr std::chrono::seconds kMaxRetryDelay{1800};
+    static constexpr std::chrono::seconds kStopTimeout{3};
+    static constexpr std::chrono::seconds kScrapeInterval{1800};
+
+    void Run();
+    TrackerEvent NextEvent(const Tracker& tracker) const;
+    void AnnounceRound(TrackerEvent event, const std::vector<std::string>& urls);
+    void ScrapeRound();
+    void HandleResult(const AnnounceParams& sent, const AnnounceResult& result);
+    Tracker* FindTracker(const std::string& url);
+
+    TrackerAnnouncer& announcer;
+    TrackerRanking& ranking;
+    AnnounceParams params;
+    StatsProvider stats;
+    TrackerAnnouncer::ResultCallback on_result;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<Tracker> trackers;
+    Clock::time_point next_scrape;
+    bool download_complete = false;
+    std::atomic<bool> stopping{false};
+    std::atomic<bool> announcing{false};
+    std::thread worker;
+};
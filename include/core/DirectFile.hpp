@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "utils/AlignedBuffer.hpp"
+
+// File opened for unbuffered I/O (O_DIRECT, or F_NOCACHE on macOS), so
+// bulk writes bypass the page cache. Writes go straight out of aligned
+// piece buffers; only the unaligned tail of the last piece is copied into
+// a small bounce buffer, padded, and trimmed off the file afterwards.
+class DirectFile {
+public:
+    static constexpr size_t kAlignment = utils::AlignedBuffer::kAlignment;
+
+    DirectFile(const std::string& path, uint64_t size);
+    ~DirectFile();
+
+    DirectFile(const DirectFile&) = delete;
+    DirectFile& operator=(const DirectFile&) = delete;
+
+    static bool IsAligned(uint64_t value);
+
+    void Write(uint64_t offset, const utils::AlignedBuffer& data);
+    utils::AlignedBuffer Read(uint64_t offset, size_t length);
+    void Close();
+
+private:
+    void WriteAll(uint64_t offset, const char* data, size_t length);
+
+    int fd;
+    uint64_t size;
+    utils::AlignedBuffer tail_buffer;
+};
@@ -1,67 +1,100 @@
 #pragma once
 
-#include <array>
+#include <cstdint>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
-#include "core/TorrentFile.hpp"
 #include "core/UdpTracker.hpp"
 #include "net/Peer.hpp"
+#include "utils/BencodeStreamParser.hpp"
 
 class HttpTracker {
 public:
-    explicit HttpTracker(const std::string& url);
-
-    void UpdatePeers(
-        const TorrentFile& torrent_file,
-        const std::string& peer_id,
-        int port
-    );
-
-    const std::vector<Peer>& GetPeers() const;
-    std::string GetTrackerUrl() const;
-    bool IsWorking() const;
-    void PrintStats() const;
-    void SetPeers(const std::vector<Peer>& new_peers) { peers = new_peers; }
-
-private:
-    static constexpr std::array<std::string_view, 7> kBackupUdpTrackers = {
-        "udp://tracker.openbittorrent.com:80",
-        "udp://tracker.internetwarriors.net:1337",
-        "udp://tracker.leechers-paradise.org:6969",
-        "udp://tracker.coppersurfer.tk:6969",
-        "udp://open.stealth.si:80",
-        "udp://exodus.desync.com:6969",
-        "udp://tracker.torrent.eu.org:451"
+    static bool IsUdpTracker(const std::string& url);
+    static std::pair<std::string, int> ParseUdpUrl(const std::string& url);
+    // Scrape URL of an HTTP announce URL. Throws when it has none.
+    static std::string ScrapeUrl(const std::string& announce_url);
+
+    // Tracker responses are read through a BencodeStreamParser as the body
+    // arrives, so the body itself is never kept in memory.
+    class ResponseReader : public utils::BencodeHandler {
+    public:
+        void OnKey(std::string_view key) override;
+        void OnInteger(int64_t value) override;
+        void OnStringBegin(size_t length) override;
+        void OnStringData(std::string_view fragment) override;
+        void OnStringEnd() override;
+        void OnListBegin() override;
+        void OnDictBegin() override;
+        void OnEnd() override;
+
+        // Throws the tracker's failure reason, if it sent one.
+        void CheckFailure() const;
+
+    protected:
+        // Key of the value being read in each enclosing container,
+        // outermost first; empty inside lists.
+        std::vector<std::string> keys;
+
+    private:
+        static constexpr size_t kMaxFailureLength = 1024;
+
+        std::optional<std::string> failure_reason;
+        bool reading_failure = false;
     };
 
-    bool IsUdpTracker() const;
-    bool IsUdpTracker(const std::string& url) const;
-    std::pair<std::string, int> ParseUdpUrl(const std::string& url);
-    Peer ConvertTrackerPeer(const UdpTracker::TrackerPeer& tracker_peer);
-
-    void UpdatePeersHttp(
-        const TorrentFile& torrent_file,
-        const std::string& peer_id,
-        int port,
-        const std::string& url
-    );
-
-    void UpdatePeersUdp(
-        const TorrentFile& torrent_file,
-        const std::string& peer_id,
-        int port,
-        const std::string& url
-    );
-    
-    void ParseTrackerResponse(const std::string& response);
-    void ParseTrackerResponse(const std::string& response, const std::string& url);
-    void ParseCompactPeers(const std::string& peers_data);
-    void ParseCompactBinaryPeers(const std::string& peers_data);
-    void ParseDictionaryPeers(const std::string& peers_data);
-
-private:
-    std::string tracker_url;
-    std::vector<Peer> peers;
-};
+    // Announce response: compact `peers` and BEP 7 `peers6` lists are
+    // decoded chunk by chunk, dictionary peer lists entry by entry.
+    class AnnounceReader : public ResponseReader {
+    public:
+        void OnInteger(int64_t value) override;
+        void OnStringBegin(size_t length) override;
+        void OnStringData(std::string_view fragment) override;
+        void OnStringEnd() override;
+        void OnDictBegin() override;
+        void OnEnd() override;
+
+        const std::vector<Peer>& GetPeers() const { return peers; }
+        // Seconds requested by the tracker, 0 when it named none.
+        int64_t GetInterval() const { return interval; }
+        int64_t GetMinInterval() const { return min_interval; }
+
+    private:
+        static constexpr size_t kMaxIpLength = 64;
+
+        bool InPeerDictionary() const;
 
+        std::vector<Peer> peers;
+        int64_t interval = 0;
+        int64_t min_interval = 0;
+
+        // Bytes per peer of the compact list being read, 0 otherwise.
+        size_t compact_size = 0;
+        std::string partial_peer;
+
+        bool reading_ip = false;
+        std::string ip;
+        int64_t port = -1;
+    };
+
+    // Scrape response, keeping only the requested info-hashes' counters.
+    class ScrapeReader : public ResponseReader {
+    public:
+        explicit ScrapeReader(std::vector<std::string> info_hashes);
+
+        void OnInteger(int64_t value) override;
+        void OnDictBegin() override;
+
+        // Swarm sizes in request order; torrents the tracker does not know
+        // are left at zero. Throws the failure reason, or when the
+        // response has no files dictionary.
+        std::vector<UdpTracker::ScrapeStats> GetStats() const;
+
+    private:
+        std::vector<std::string> info_hashes;
+        std::vector<UdpTracker::ScrapeStats> stats;
+        bool has_files = false;
+    };
+};
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "core/UdpTracker.hpp"
+#include "net/Peer.hpp"
+
+struct LocalTrackerOptions {
+    // Literal IPv4 or IPv6 address both servers listen on. Port 0 picks a
+    // free port, see LocalTracker::HttpPort and UdpPort.
+    std::string bind_address = "127.0.0.1";
+    uint16_t http_port = 0;
+    uint16_t udp_port = 0;
+
+    // Handed out for every torrent and counted as seeders.
+    std::vector<Peer> peers;
+    // Announcing clients join their torrent's swarm until they stop.
+    bool track_announcers = true;
+    // Peers per answer when the client does not ask for a number.
+    size_t default_num_want = 50;
+
+    uint32_t interval = 1800;
+    // Sent to HTTP clients when not 0, UDP has no field for it.
+    uint32_t min_interval = 0;
+
+    // Added before every answer.
+    std::chrono::milliseconds latency{0};
+    // Share of UDP datagrams dropped on arrival, from 0 to 1. HTTP requests
+    // are only delayed, TCP would resend lost segments anyway.
+    double loss_rate = 0.0;
+};
+
+struct LocalTrackerStats {
+    uint64_t http_announces = 0;
+    uint64_t http_scrapes = 0;
+    uint64_t udp_connects = 0;
+    uint64_t udp_announces = 0;
+    uint64_t udp_scrapes = 0;
+    uint64_t udp_dropped = 0;
+};
+
+// Stand-in tracker serving HTTP announce and scrape and the BEP 15 UDP
+// protocol from one background thread, so the tracker code can be tested
+// and benchmarked on a machine without internet access.
+class LocalTracker {
+public:
+    // Throws when a socket cannot be bound.
+    explicit LocalTracker(const LocalTrackerOptions& options = {});
+    ~LocalTracker();
+
+    LocalTracker(const LocalTracker&) = delete;
+    LocalTracker& operator=(const LocalTracker&) = delete;
+
+    uint16_t HttpPort() const { return http_port; }
+    uint16_t UdpPort() const { return udp_port; }
+    std::string HttpAnnounceUrl() const;
+    std::string UdpAnnounceUrl() const;
+
+    // Peers handed out for one torrent on top of LocalTrackerOptions::peers,
+    // replacing earlier ones.
+    void SetPeers(const std::string& info_hash, std::vector<Peer> peers);
+
+    LocalTrackerStats Stats() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+    using Query = std::multimap<std::string, std::string>;
+
+    struct Swarm {
+        std::vector<Peer> configured;
+        // Announcing peers and whether they are seeding.
+        std::unordered_map<Peer, bool, PeerHash> announcers;
+        uint32_t completed = 0;
+    };
+
+    struct Announce {
+        std::string info_hash;
+        Peer peer;
+        uint64_t left = 0;
+        // Numbered like TrackerEvent.
+        int event = 0;
+        size_t num_want = 0;
+    };
+
+    struct AnnounceReply {
+        uint32_t seeders = 0;
+        uint32_t leechers = 0;
+        std::vector<Peer> peers;
+    };
+
+    struct HttpConnection {
+        // Tells delayed answers apart from a reused descriptor's.
+        uint64_t serial = 0;
+        Peer client;
+        std::string input;
+        std::string output;
+        // Answers still waiting out the latency.
+        size_t pending = 0;
+        bool close_when_done = false;
+    };
+
+    static constexpr size_t kMaxRequestSize = 16 * 1024;
+    static constexpr size_t kMaxDatagramSize = 2048;
+    static constexpr std::chrono::seconds kConnectionIdLifetime{60};
+
+    int Listen(int type, uint16_t port, uint16_t& bound_port) const;
+    void CloseSockets();
+    void Run();
+    void Delay(std::function<void()> action);
+    void RunTimers();
+
+    void AcceptHttp();
+    void ReadHttp(int fd);
+    void WriteHttp(int fd);
+    void CloseHttp(int fd);
+    void HandleHttpRequests(int fd, HttpConnection& connection);
+    std::string HttpAnnounce(const Query& query, const Peer& client);
+    std::string HttpScrape(const Query& query);
+
+    void ReadUdp();
+    // Empty when the packet is not worth an answer.
+    std::string UdpResponse(std::string_view packet, const sockaddr_storage& from);
+    uint64_t ConnectionId(const sockaddr_storage& from, int64_t epoch) const;
+
+    AnnounceReply HandleAnnounce(const Announce& announce, int family);
+    UdpTracker::ScrapeStats SwarmStats(const std::string& info_hash) const;
+
+    const LocalTrackerOptions options;
+    int http_fd = -1;
+    int udp_fd = -1;
+    int wake_fd = -1;
+    uint16_t http_port = 0;
+    uint16_t udp_port = 0;
+    uint64_t connection_secret = 0;
+
+    // Only touched by the tracker thread.
+    std::unordered_map<int, HttpConnection> http_connections;
+    uint64_t next_serial = 1;
+    std::multimap<Clock::time_point, std::function<void()>> timers;
+    std::mt19937_64 random;
+
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, Swarm> swarms;
+    LocalTrackerStats stats;
+    std::thread worker;
+};
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Parsed magnet URI (BEP 9). Only v1 "urn:btih:" exact topics are
+// understood; the info-hash is stored raw, like TorrentFile::info_hash.
+struct MagnetLink {
+    std::string info_hash;
+    std::string name;
+    std::vector<std::string> trackers;
+    size_t length = 0;
+};
+
+bool IsMagnetLink(const std::string& source);
+MagnetLink ParseMagnetLink(const std::string& uri);
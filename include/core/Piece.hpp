@@ -5,20 +5,50 @@
 #include <vector>
 
 #include "Block.hpp"
+#include "utils/Sha1Hasher.hpp"
+#include "utils/Sha256.hpp"
 
 class Piece {
 public:
-    Piece(size_t index, size_t length, const std::string& hash);
+    Piece(size_t index, size_t length, const utils::Sha1Digest& hash);
 
     bool HashMatches() const;
     Block* GetFirstMissingBlock();
     size_t GetIndex() const;
-    void SaveBlock(size_t blockOffset, std::string data);
+    // Returns false if the block fails its merkle leaf check; it is then
+    // missing again and will be requested anew. A block that is already
+    // retrieved is left as it is. Throws if there is no block at the
+    // offset or the data is not exactly the block's length.
+    bool SaveBlock(size_t blockOffset, std::string data);
     bool AllBlocksRetrieved() const;
     std::string GetData() const;
-    std::string GetDataHash() const;
-    std::string GetHash() const;
+    utils::Sha1Digest GetDataHash() const;
+
+    // Copies the piece into `destination` (GetLength() bytes) and hashes
+    // each block right after copying it, while it is still in cache.
+    // Returns the SHA-1 of the copied data.
+    utils::Sha1Digest CopyDataAndHash(char* destination) const;
+    const utils::Sha1Digest& GetHash() const;
+    void CopyData(char* destination) const;
+
+    // BEP 52: blocks are hashed with SHA-256 as they are saved. Until leaf
+    // hashes are known only the piece root can be checked on completion;
+    // afterwards every block is checked against its own leaf on arrival.
+    void SetMerkleRoot(
+        const utils::Sha256Digest& root,
+        size_t leaf_count,
+        size_t data_length
+    );
+    bool HasMerkleRoot() const;
+    bool HasBlockHashes() const;
+    bool MerkleRootMatches() const;
+
+    // Accepts `leaves` if they hash up to the piece root. Saved blocks that
+    // do not match their leaf are dropped, so only they are downloaded again.
+    bool SetBlockHashes(std::vector<utils::Sha256Digest> leaves);
+
     void Reset();
+    void ResetPendingBlocks();
 
     bool IsDownloading() const;
     bool IsComplete() const;
@@ -28,9 +58,18 @@ public:
 private:
     size_t index;
     size_t length;
-    std::string hash;
+    utils::Sha1Digest hash;
     std::vector<Block> blocks;
     size_t bytes_downloaded;
+
+    bool BlockMatchesLeaf(const Block& block, utils::Sha256Digest& leaf) const;
+    size_t DataLeafCount() const;
+
+    utils::Sha256Digest merkle_root{};
+    size_t merkle_leaf_count = 0;
+    size_t merkle_data_length = 0;
+    std::vector<utils::Sha256Digest> block_hashes;
+    std::vector<utils::Sha256Digest> expected_block_hashes;
 };
 
 using PiecePtr = std::shared_ptr<Piece>;
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "utils/AlignedBuffer.hpp"
+
+class PieceCache {
+public:
+    using PieceData = std::shared_ptr<const utils::AlignedBuffer>;
+
+    struct Stats {
+        uint64_t hits;
+        uint64_t misses;
+        size_t size_bytes;
+        size_t capacity_bytes;
+    };
+
+    explicit PieceCache(size_t capacity_bytes);
+
+    PieceData Get(size_t piece_index);
+    void Put(size_t piece_index, utils::AlignedBuffer data);
+    Stats GetStats() const;
+
+private:
+    using Entry = std::pair<size_t, PieceData>;
+
+    void EvictToCapacity();
+
+    // Most recently used entries are kept at the front.
+    std::list<Entry> lru;
+    std::unordered_map<size_t, std::list<Entry>::iterator> entries;
+    size_t capacity_bytes;
+    size_t size_bytes;
+    mutable std::mutex mutex;
+
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+};
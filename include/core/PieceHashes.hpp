@@ -0,0 +1,38 @@
+#pragma once
+
+#include <memory>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "utils/Sha1Hasher.hpp"
+
+// Immutable table of SHA-1 piece digests packed back to back in a single
+// allocation. Copies share the table, so storage, connections and
+// verification all refer to the same bytes. The table may also live in
+// memory owned by someone else, e.g. a mapped metadata cache.
+class PieceHashes {
+public:
+    using Digest = utils::Sha1Digest;
+    static constexpr size_t kHashSize = sizeof(Digest);
+
+    PieceHashes() = default;
+
+    // `packed` is the "pieces" string of the info dictionary.
+    explicit PieceHashes(std::string_view packed);
+
+    // Refers to `digests` without copying; `owner` keeps them alive.
+    PieceHashes(std::shared_ptr<const void> owner, std::span<const Digest> digests);
+
+    size_t Size() const;
+    bool Empty() const;
+    const Digest& operator[](size_t index) const;
+    bool Matches(size_t index, const Digest& digest) const;
+
+    std::span<const Digest> All() const;
+    std::string_view Packed() const;
+
+private:
+    std::shared_ptr<const void> owner;
+    std::span<const Digest> digests;
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "utils/Sha256.hpp"
+
+// BEP 52 (v2) merkle roots per piece, indexed like the pieces of the
+// output file. Like PieceHashes, copies share one immutable table.
+class PieceLayers {
+public:
+    struct Entry {
+        // Root of the piece's subtree: a "piece layers" hash, or the
+        // file's "pieces root" when the file fits in a single piece.
+        utils::Sha256Digest root;
+        uint32_t file_index;
+        // Index of the piece's first 16 KiB leaf within its file tree and
+        // number of leaves under `root`, padding included. A leaf count
+        // of zero marks a piece without v2 hashes.
+        uint32_t first_leaf;
+        uint32_t leaf_count;
+        // Bytes of file data in the piece; the rest of a v1 piece is pad
+        // file content, which is not part of the merkle tree.
+        uint32_t data_length;
+    };
+
+    PieceLayers() = default;
+    explicit PieceLayers(std::vector<Entry> entries);
+    PieceLayers(std::shared_ptr<const void> owner, std::span<const Entry> entries);
+
+    size_t Size() const;
+    bool Empty() const;
+    bool HasRoot(size_t index) const;
+    const Entry& operator[](size_t index) const;
+    std::span<const Entry> All() const;
+
+private:
+    std::shared_ptr<const void> owner;
+    std::span<const Entry> entries;
+};
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstdint>
+
+enum class PiecePriority : uint8_t {
+    kSkip = 0,
+    kLow,
+    kNormal,
+    kHigh,
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Set of piece indices kept as a bitmap. Intersecting two sets walks
+// 64 pieces per step, which keeps piece picking cheap on big torrents.
+class PieceSet {
+public:
+    static constexpr size_t kNone = static_cast<size_t>(-1);
+
+    PieceSet() = default;
+    explicit PieceSet(size_t piece_count);
+
+    // BITFIELD payload layout: the high bit of the first byte is piece 0.
+    static PieceSet FromBitfield(std::string_view bitfield, size_t piece_count);
+
+    // Indices past the piece count are ignored.
+    void Insert(size_t index);
+    void Erase(size_t index);
+    bool Contains(size_t index) const;
+    bool Empty() const;
+    size_t Size() const;
+    void Clear();
+
+    // Lowest index in the set, kNone when it is empty.
+    size_t First() const;
+    // Lowest index in both sets, kNone when they have none in common.
+    size_t FirstCommon(const PieceSet& other) const;
+
+private:
+    std::vector<uint64_t> words;
+    size_t piece_count = 0;
+    size_t size = 0;
+};
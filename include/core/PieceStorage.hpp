@@ -1,30 +1,87 @@
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <filesystem>
 #include <fstream>
+#include <memory>
 #include <mutex>
-#include <queue>
+#include <string>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
+#include "core/DirectFile.hpp"
 #include "core/Piece.hpp"
+#include "core/PieceCache.hpp"
+#include "core/PiecePriority.hpp"
+#include "core/PieceSet.hpp"
 #include "core/TorrentFile.hpp"
 
+struct StorageOptions {
+    // Memory budget for verified pieces kept around for serving peers.
+    size_t read_cache_bytes = 64 * 1024 * 1024;
+    // Also cache pieces as they are written, not only those read back by
+    // ReadBlock. Only pays off when peers ask for fresh pieces right away.
+    bool cache_written_pieces = false;
+
+    // Write pieces with O_DIRECT, bypassing the page cache. Falls back to
+    // buffered I/O when the piece length is not aligned or the file system
+    // does not support it.
+    bool direct_io = false;
+};
+
 class PieceStorage {
 public:
     PieceStorage(
         const TorrentFile& torrent_file,
-        const std::filesystem::path& output_directory
+        const std::filesystem::path& output_directory,
+        const StorageOptions& options = {}
     );
 
+    // Highest priority first, partial pieces before untouched ones and
+    // lower indices first within each group.
     PiecePtr GetNextPieceToDownload();
+    PiecePtr GetNextPieceToDownload(const PieceSet& available);
     void PieceProcessed(const PiecePtr& piece);
+    // False once the piece was skipped or requeued after being handed
+    // out, its holder should drop it without calling Enqueue.
+    bool IsInFlight(const PiecePtr& piece) const;
+
+    // Blocks already retrieved are kept, so whoever picks the piece up
+    // next only requests the missing ones.
     void Enqueue(const PiecePtr& piece);
     bool QueueIsEmpty() const;
     bool IsPieceAlreadySaved(size_t piece_index) const;
     size_t TotalPiecesCount() const;
+    size_t WantedPiecesCount() const;
     size_t PiecesSavedToDiscCount() const;
 
+    // Tracker counters: payload bytes received for completed pieces,
+    // including ones that failed verification, and bytes still missing
+    // from pieces that are not skipped.
+    uint64_t DownloadedBytes() const;
+    uint64_t BytesLeft() const;
+
+    // File priorities are folded into piece priorities: a piece shared by
+    // several files gets the highest priority among them. Changing a file
+    // priority overwrites any per-piece priority set on its pieces.
+    void SetFilePriority(size_t file_index, PiecePriority priority);
+    void SetPiecePriority(size_t piece_index, PiecePriority priority);
+    PiecePriority GetPiecePriority(size_t piece_index) const;
+
+    // Reads part of a saved piece for a peer's REQUEST. A cache miss
+    // loads the whole piece, so requests for its neighbouring blocks are
+    // served from memory.
+    std::string ReadBlock(size_t piece_index, size_t offset, size_t length);
+    // BITFIELD payload announcing the saved pieces.
+    std::string SavedPiecesBitfield() const;
+    PieceCache::Stats GetReadCacheStats() const;
+    bool IsDirectIo() const;
+    // Why StorageOptions::direct_io fell back to buffered I/O, empty when
+    // it was not asked for or is in use.
+    const std::string& DirectIoFallbackReason() const;
+
     void CloseOutputFile();
     bool IsDownloadComplete() const;
     bool HasActiveWork() const;
@@ -32,20 +89,49 @@ public:
     void ForceRequeueMissingPieces();
 
 private:
-    void SavePieceToDisk(const PiecePtr& piece);
-    void InitializeOutputFile();
+    static constexpr size_t kQueuedPriorityLevels = 3;
+
+    void SavePieceToDisk(size_t piece_index, utils::AlignedBuffer data);
+    void InitializeOutputFile(bool direct_io);
+    utils::AlignedBuffer ReadPieceFromDisk(size_t piece_index);
+
+    PiecePtr MakePiece(size_t piece_index) const;
+    size_t PieceLength(size_t piece_index) const;
+    static size_t LevelOf(PiecePriority priority);
+    void QueuePiece(PiecePtr piece);
+    // Rebuilds the per-priority sets from queued_pieces, dropping pieces
+    // that are skipped by now.
+    void ReindexQueue();
+    PiecePtr TakeFirst(const PieceSet* available);
+    void RecomputePiecePriorities();
+    void ApplyPriorityChange(const std::vector<PiecePriority>& previous);
+    // False when the piece is no longer the handed out one.
+    bool ReleaseInFlight(const PiecePtr& piece);
 
-    std::queue<PiecePtr> remaining_pieces_queue;
+    // Queued pieces by index; skipped pieces are never queued. The sets
+    // index them per priority level, ordered from kHigh to kLow.
+    std::vector<PiecePtr> queued_pieces;
+    std::array<PieceSet, kQueuedPriorityLevels> partial_pieces;
+    std::array<PieceSet, kQueuedPriorityLevels> untouched_pieces;
+    std::vector<PiecePriority> file_priorities;
+    std::vector<PiecePriority> piece_priorities;
+    // Pieces handed out by GetNextPieceToDownload and not yet returned.
+    std::unordered_map<size_t, PiecePtr> in_flight;
     mutable std::mutex queue_mutex;
 
-    std::ofstream file;
+    std::fstream file;
+    std::unique_ptr<DirectFile> direct_file;
+    std::string direct_io_fallback_reason;
     mutable std::mutex file_mutex;
 
+    PieceCache read_cache;
+    bool cache_written_pieces;
+
     std::unordered_set<size_t> saved_pieces;
+    std::atomic<uint64_t> downloaded_bytes{0};
 
     std::filesystem::path output_directory;
     size_t default_piece_length;
     size_t total_piece_count;
     TorrentFile torrent_file;
 };
-
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <string>
+
+#include "core/TorrentFile.hpp"
+
+// Binary cache of a parsed .torrent, stored in the user's cache directory
+// as "<checksum>.meta", keyed by a checksum of the .torrent's contents.
+// The layout is flat and 8-byte aligned: a header with the info-hash, a
+// string table, the file table, then the packed SHA-1 piece hashes and
+// v2 layer entries, which are used in place from the memory mapping. A
+// checksum of the cache itself and the source's size and checksum guard
+// against stale or damaged caches.
+
+// "$XDG_CACHE_HOME/torrent-client", falling back to
+// "$HOME/.cache/torrent-client"; empty when neither is set.
+std::filesystem::path TorrentCacheDirectory();
+
+std::filesystem::path TorrentCachePath(
+    const std::filesystem::path& torrent_path,
+    const std::filesystem::path& cache_directory = TorrentCacheDirectory()
+);
+
+// Returns nothing if the cache is missing, stale, damaged or (when
+// given) recorded for a different info-hash.
+std::optional<TorrentFile> LoadTorrentCache(
+    const std::filesystem::path& torrent_path,
+    const std::string& expected_info_hash = "",
+    const std::filesystem::path& cache_directory = TorrentCacheDirectory()
+);
+
+void SaveTorrentCache(
+    const TorrentFile& torrent_file,
+    const std::filesystem::path& torrent_path,
+    const std::filesystem::path& cache_directory = TorrentCacheDirectory()
+);
+
+// LoadTorrentFile through the cache: a valid cache is mapped, anything
+// else falls back to parsing and refreshes the cache on a best-effort
+// basis.
+TorrentFile LoadTorrentFileCached(const std::string& filename);
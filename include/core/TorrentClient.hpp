@@ -1,14 +1,26 @@
 #pragma once
 
+#include <array>
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <filesystem>
+#include <functional>
+#include <map>
 #include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
-#include "core/HttpTracker.hpp"
+#include "core/AnnounceScheduler.hpp"
+#include "core/MagnetLink.hpp"
+#include "core/PiecePriority.hpp"
 #include "core/PieceStorage.hpp"
 #include "core/TorrentFile.hpp"
 #include "core/TorrentTask.hpp"
+#include "core/TrackerAnnouncer.hpp"
+#include "core/TrackerRanking.hpp"
 #include "net/PeerConnection.hpp"
 #include "utils/Timer.hpp"
 
@@ -22,9 +34,35 @@ public:
         const std::filesystem::path& output_directory
     );
 
+    // Fetches the metadata from the swarm unless a cached
+    // <info-hash>.torrent in the output directory already matches, then
+    // downloads it like a regular torrent file.
+    void DownloadMagnet(
+        const std::string& magnet_uri,
+        const std::filesystem::path& output_directory
+    );
+
     const std::string& GetPeerId() const { return peer_id; }
     void SetPeerId(const std::string& new_peer_id) { peer_id = new_peer_id; }
 
+    // Applied to the storage of the next DownloadTorrent call, file
+    // priorities first, so per-piece priorities can refine them, and to
+    // the running download's storage right away. Throws out_of_range for
+    // an index the running download does not have.
+    void SetFilePriority(size_t file_index, PiecePriority priority);
+    void SetPiecePriority(size_t piece_index, PiecePriority priority);
+    // Used for the storage of every following download, e.g. to write
+    // one torrent with O_DIRECT.
+    void SetStorageOptions(const StorageOptions& options) { storage_options = options; }
+
+    // Keeps a binary copy of loaded torrent files in the user's cache
+    // directory so later loads skip bencode parsing, see TorrentCache.hpp.
+    void SetMetadataCacheEnabled(bool enabled) { metadata_cache_enabled = enabled; }
+
+    // Off leaves only the torrent's own trackers, e.g. a LocalTracker for
+    // runs without internet access.
+    void SetDefaultTrackersEnabled(bool enabled) { default_trackers_enabled = enabled; }
+
     TorrentTask GetCurrentTask() const;
     std::vector<std::string> GetLogMessages(size_t max_count = 50) const;
     void PauseDownload();
@@ -36,7 +74,32 @@ public:
     bool IsStopRequested() const;
 
 private:
+    using Clock = std::chrono::steady_clock;
+
+    // Startup milestones, each logged once per download with the time
+    // since the download began.
+    enum class StartupStage : uint32_t {
+        kTorrentLoaded,
+        kAnnounceStarted,
+        kStorageReady,
+        kFirstTrackerAnswer,
+        kFirstPeer,
+        kFirstConnectAttempt,
+        kMetadataReceived,
+        kFirstPiece,
+    };
+
     static constexpr int kPiecesLeftToEnterEndgame = 20;
+    static constexpr int kMaxMetadataAttempts = 5;
+    static constexpr std::chrono::seconds kMetadataTimeout{60};
+    static constexpr uint16_t kListenPort = 12345;
+
+    static constexpr std::array<std::string_view, 4> kDefaultTrackers = {
+        "udp://tracker.opentrackr.org:1337/announce",
+        "udp://open.stealth.si:80/announce",
+        "udp://exodus.desync.com:6969/announce",
+        "udp://tracker.torrent.eu.org:451/announce"
+    };
 
     std::string peer_id;
     std::atomic<bool> is_terminated{false};
@@ -47,20 +110,63 @@ private:
     TorrentTask current_task;
     mutable std::mutex log_mutex;
     std::vector<std::string> log_messages;
+    mutable std::mutex connections_mutex;
     std::vector<std::shared_ptr<PeerConnection>> peer_connections;
     Timer timer;
 
+    // The scheduler keeps the trackers announced while a download runs;
+    // peers reach the running session through pending_peers as soon as
+    // each tracker answers. The ranking outlives single downloads, so
+    // later torrents start with the trackers that answered best.
+    TrackerAnnouncer announcer;
+    TrackerRanking tracker_ranking;
+    AnnounceScheduler scheduler{announcer, tracker_ranking};
+    std::mutex swarm_mutex;
+    std::condition_variable swarm_changed;
+    std::vector<Peer> pending_peers;
+    std::unordered_set<Peer, PeerHash> known_peers;
+    // Announcing starts before the storage exists; until it is set the
+    // announced counters are those of an empty download.
+    std::atomic<const PieceStorage*> announced_storage{nullptr};
+
+    Clock::time_point startup_begin;
+    std::atomic<uint32_t> startup_stages{0};
+    // Stages reached while fetching a magnet's metadata are logged as
+    // such, and those the download reaches again are logged once more.
+    std::atomic<bool> fetching_metadata{false};
+
+    // Set from the UI thread while the download thread applies them.
+    std::mutex priority_mutex;
+    std::map<size_t, PiecePriority> file_priorities;
+    std::map<size_t, PiecePriority> piece_priorities;
+    PieceStorage* prioritized_storage = nullptr;
+    StorageOptions storage_options;
+    bool metadata_cache_enabled = false;
+    bool default_trackers_enabled = true;
+
     void AddLogMessage(const std::string& message);
     void UpdateTaskStatus(TorrentStatus status);
     void UpdateTaskFromPieceStorage(const PieceStorage& storage);
-    void UpdateTaskFromTracker(const HttpTracker& tracker);
+    void ApplyPriorities(PieceStorage* pieces);
+    void BeginStartup();
+    void MarkStartupStage(StartupStage stage, const std::string& detail = "");
 
     std::string GenerateRandomSuffix(size_t length = 4);
 
     bool RunDownloadMultithread(
+        PieceStorage& pieces,
+        const TorrentFile& torrent_file
+    );
+
+    void ConnectPendingPeers(
         PieceStorage& pieces,
         const TorrentFile& torrent_file,
-        const HttpTracker& tracker
+        std::vector<std::thread>& peer_threads
+    );
+
+    void DownloadTorrentFile(
+        const std::filesystem::path& torrent_file_path,
+        const std::filesystem::path& output_directory
     );
 
     void DownloadFromTracker(
@@ -68,6 +174,38 @@ private:
         PieceStorage& pieces
     );
 
+    std::vector<std::string> TrackerUrls(
+        const std::vector<std::string>& announce_urls
+    );
+
+    void Announce(
+        const TorrentFile& torrent_file,
+        const std::vector<std::string>& trackers,
+        const std::atomic<bool>& stop,
+        const std::function<void(const std::vector<Peer>&)>& on_peers
+    );
+
+    void StartAnnounce(
+        const TorrentFile& torrent_file,
+        const std::vector<std::string>& trackers
+    );
+    void StopAnnounce();
+    bool WaitForPeers();
+    void WaitForNewPeers(std::chrono::milliseconds timeout);
+    void AddDiscoveredPeers(const std::vector<Peer>& peers);
+    void ForgetPeer(const Peer& peer);
+    bool AllConnectionsEnded() const;
+
+    bool IsCachedMetadataValid(
+        const std::filesystem::path& torrent_file_path,
+        const std::string& info_hash
+    );
+
+    void FetchMetadata(
+        const MagnetLink& magnet,
+        const std::filesystem::path& torrent_file_path
+    );
+
     void CleanupConnections();
 };
 
@@ -3,15 +3,35 @@
 #include <string>
 #include <vector>
 
+#include "core/PieceHashes.hpp"
+#include "core/PieceLayers.hpp"
+
 struct TorrentFile {
+    struct File {
+        std::string path;
+        size_t length;
+        size_t offset;
+        // v2 merkle root of the file, empty for v1 and pad files.
+        std::string pieces_root;
+    };
+
     std::string announce;
+    std::vector<std::string> announce_list;
     std::string comment;
-    std::vector<std::string> piece_hashes;
+    PieceHashes piece_hashes;
+    std::vector<File> files;
     size_t piece_length;
     size_t length;
     std::string name;
     std::string info_hash;
+
+    // 2 for v2 and hybrid torrents. Hybrid torrents keep the v1 layout and
+    // info-hash; pure v2 torrents place every file on a piece boundary and
+    // use the truncated SHA-256 info-hash.
+    int meta_version = 1;
+    PieceLayers piece_layers;
+
+    size_t PieceCount() const;
 };
 
 TorrentFile LoadTorrentFile(const std::string& filename);
-
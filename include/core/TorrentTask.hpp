@@ -13,7 +13,8 @@ enum class TorrentStatus {
     kCompleted,
     kStopped,
     kError,
-    kConnected
+    kConnected,
+    kFetchingMetadata
 };
 
 struct TorrentTask {
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <curl/curl.h>
+
+#include "core/UdpTrackerEngine.hpp"
+#include "net/CurlShare.hpp"
+#include "net/DnsResolver.hpp"
+#include "net/Peer.hpp"
+#include "utils/BencodeStreamParser.hpp"
+
+// Values match the UDP tracker protocol.
+enum class TrackerEvent {
+    kNone = 0,
+    kCompleted = 1,
+    kStarted = 2,
+    kStopped = 3,
+};
+
+struct AnnounceParams {
+    std::string info_hash;
+    std::string peer_id;
+    uint16_t port = 0;
+    uint64_t uploaded = 0;
+    uint64_t downloaded = 0;
+    uint64_t left = 0;
+    TrackerEvent event = TrackerEvent::kNone;
+};
+
+struct AnnounceResult {
+    std::string url;
+    std::vector<Peer> peers;
+    // Re-announce delays asked for by the tracker, 0 when not given.
+    std::chrono::seconds interval{0};
+    std::chrono::seconds min_interval{0};
+    // Time the tracker took to answer or fail.
+    std::chrono::milliseconds latency{0};
+    // Empty when the tracker answered.
+    std::string error;
+};
+
+struct ScrapeResult {
+    std::string url;
+    // One entry per scraped info-hash, in request order.
+    std::vector<UdpTracker::ScrapeStats> stats;
+    std::chrono::milliseconds latency{0};
+    // Empty when the tracker answered.
+    std::string error;
+};
+
+// Announces to and scrapes many trackers at once: HTTP(S) trackers through one curl
+// multi handle, UDP trackers through the shared UdpTrackerEngine. Tracker
+// hosts are looked up through the shared DnsResolver. HTTP connections are
+// kept alive between rounds and TLS sessions are resumed through the shared
+// CurlShare. Not thread-safe, one round at a time.
+class TrackerAnnouncer {
+public:
+    using ResultCallback = std::function<void(const AnnounceResult&)>;
+    using ScrapeCallback = std::function<void(const ScrapeResult&)>;
+
+    explicit TrackerAnnouncer(
+        UdpTrackerEngine& udp_engine = UdpTrackerEngine::Shared(),
+        DnsResolver& resolver = DnsResolver::Shared(),
+        CurlShare& curl_share = CurlShare::Shared()
+    );
+    ~TrackerAnnouncer();
+
+    TrackerAnnouncer(const TrackerAnnouncer&) = delete;
+    TrackerAnnouncer& operator=(const TrackerAnnouncer&) = delete;
+
+    // Calls on_result on this thread as each tracker answers or fails, so
+    // the first peers are usable long before the slowest tracker times out.
+    // Returns once every tracker is done, on timeout, or when stop is set.
+    // Without a timeout the round also ends kUdpGrace after the first UDP
+    // tracker answered, once every HTTP tracker is done; UDP trackers that
+    // are still silent then are reported as timed out. With a timeout
+    // every tracker is waited for up to it.
+    void AnnounceAll(
+        const std::vector<std::string>& urls,
+        const AnnounceParams& params,
+        const std::atomic<bool>& stop,
+        const ResultCallback& on_result,
+        std::optional<std::chrono::milliseconds> timeout = std::nullopt
+    );
+
+    // Asks every tracker for the swarm sizes of up to
+    // UdpTracker::kMaxScrapeHashes torrents, reporting like AnnounceAll.
+    // HTTP trackers whose announce URL has no scrape counterpart fail.
+    void ScrapeAll(
+        const std::vector<std::string>& urls,
+        const std::vector<std::string>& info_hashes,
+        const std::atomic<bool>& stop,
+        const ScrapeCallback& on_result,
+        std::optional<std::chrono::milliseconds> timeout = std::nullopt
+    );
+
+    // Longest an HTTP request or a UDP request with all its retransmits
+    // can take, plus time for the host lookup.
+    std::chrono::milliseconds RoundBudget() const;
+
+private:
+    // Hands a closure from another thread to the round's thread to run.
+    using Delivery = std::function<void(std::function<void()>)>;
+
+    // Reads a 200 response body as it arrives. report hands on what was
+    // read once the body is complete and throws when it makes no sense.
+    struct HttpReader {
+        std::unique_ptr<utils::BencodeHandler> handler;
+        std::function<void(std::chrono::milliseconds latency)> report;
+    };
+
+    // What a round asks of each tracker and how it reports the outcome.
+    struct RoundHandlers {
+        // Request URL for an HTTP(S) tracker. Throws when there is none.
+        std::function<std::string(CURL* handle, const std::string& url)> http_url;
+        std::function<HttpReader(const std::string& url)> http_reader;
+        // Starts a UDP request and returns its engine id. The request hands
+        // its report to deliver once, from any thread.
+        std::function<uint64_t(
+            const std::string& url,
+            const UdpEndpoint& endpoint,
+            Delivery deliver
+        )> start_udp;
+        std::function<void(
+            const std::string& url,
+            const std::string& error,
+            std::chrono::milliseconds latency
+        )> on_error;
+    };
+
+    void RunRound(
+        const std::vector<std::string>& urls,
+        const std::atomic<bool>& stop,
+        const RoundHandlers& handlers,
+        std::chrono::milliseconds timeout,
+        bool wait_for_all
+    );
+
+    static constexpr std::chrono::milliseconds kHttpTimeout{10000};
+    static constexpr std::chrono::milliseconds kHttpConnectTimeout{5000};
+    static constexpr std::chrono::milliseconds kPollInterval{50};
+    static constexpr std::chrono::milliseconds kLookupAllowance{5000};
+    // How long other UDP trackers get once the first one answered.
+    static constexpr std::chrono::milliseconds kUdpGrace{2000};
+    static constexpr long kMaxIdleConnections = 64;
+
+    UdpTrackerEngine& udp_engine;
+    DnsResolver& resolver;
+    CurlShare& curl_share;
+    CURLM* multi;
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "core/TrackerAnnouncer.hpp"
+
+// Remembers how each tracker answered announces and scrapes, and orders
+// tracker lists so that the best-connected trackers come first. Thread-safe.
+class TrackerRanking {
+public:
+    void RecordAnnounce(const AnnounceResult& result);
+    // Failed scrapes are ignored, many trackers do not support scrape.
+    void RecordScrape(const ScrapeResult& result);
+
+    // Answering trackers first, then trackers not heard from yet, then
+    // failing ones. Answering trackers are ordered by swarm size and then
+    // by latency; the order of urls breaks ties.
+    std::vector<std::string> Rank(const std::vector<std::string>& urls) const;
+
+private:
+    struct Health {
+        // Summed over the scraped torrents.
+        uint64_t seeders = 0;
+        uint64_t leechers = 0;
+        bool scraped = false;
+        // Stand-in for the swarm size until a scrape answers.
+        size_t announced_peers = 0;
+        std::chrono::milliseconds latency{0};
+        bool answered = false;
+        int failures = 0;
+    };
+
+    static int Tier(const Health* health);
+    static int SwarmClass(const Health& health);
+
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, Health> trackers;
+};
@@ -2,56 +2,66 @@
 
 #include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 
-#include "net/UdpConnection.hpp"
+#include "net/Peer.hpp"
 
 class UdpTracker {
 public:
-    struct TrackerPeer {
-        uint32_t ip;
-        uint16_t port;
-    };
-
     struct TrackerResponse {
         uint32_t interval;
         uint32_t leechers;
         uint32_t seeders;
-        std::vector<TrackerPeer> peers;
+        std::vector<Peer> peers;
     };
 
-    UdpTracker(const std::string& host, int port, int timeout_sec = 5);
-
-    TrackerResponse Announce(
-        const std::string& info_hash,
-        const std::string& peer_id,
-        uint64_t downloaded,
-        uint64_t left,
-        uint64_t uploaded,
-        int event,
-        int wanted_number,
-        uint16_t port
-    );
-
-private:
-    std::string host;
-    int port;
-    int timeout_sec;
+    struct ScrapeStats {
+        uint32_t seeders = 0;
+        uint32_t completed = 0;
+        uint32_t leechers = 0;
+    };
 
-    UdpConnection udp_client;
+    // Info-hashes that fit into one scrape packet.
+    static constexpr size_t kMaxScrapeHashes = 74;
 
-    uint64_t Connect();
+    // Packet builders and parsers, shared with TrackerAnnouncer which drives
+    // many trackers over one socket. Parsers throw on a tracker error, a
+    // wrong action or a transaction id mismatch.
+    static std::string ConnectRequest(uint32_t transaction_id);
+    static uint64_t ParseConnectResponse(
+        std::string_view response,
+        uint32_t transaction_id
+    );
 
-    TrackerResponse AnnounceWithConnection(
+    static std::string AnnounceRequest(
         uint64_t connection_id,
+        uint32_t transaction_id,
         const std::string& info_hash,
         const std::string& peer_id,
         uint64_t downloaded,
         uint64_t left,
         uint64_t uploaded,
         int event,
-        int wanted_number,
+        int num_want,
         uint16_t port
     );
+    // Announces sent over IPv6 are answered with 18-byte IPv6 peers.
+    static TrackerResponse ParseAnnounceResponse(
+        std::string_view response,
+        uint32_t transaction_id,
+        int family = AF_INET
+    );
 
+    static std::string ScrapeRequest(
+        uint64_t connection_id,
+        uint32_t transaction_id,
+        const std::vector<std::string>& info_hashes
+    );
+    // One entry per requested info-hash, in request order.
+    static std::vector<ScrapeStats> ParseScrapeResponse(
+        std::string_view response,
+        uint32_t transaction_id,
+        size_t hash_count
+    );
 };
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "core/UdpTracker.hpp"
+
+struct UdpEndpoint {
+    sockaddr_storage address{};
+    socklen_t length = 0;
+
+    bool operator==(const UdpEndpoint& other) const;
+};
+
+struct UdpEndpointHash {
+    size_t operator()(const UdpEndpoint& endpoint) const;
+};
+
+struct UdpTrackerOptions {
+    // BEP 15 retransmission: the n-th attempt waits
+    // retransmit_timeout * 2^n before the request is sent again.
+    std::chrono::milliseconds retransmit_timeout{15000};
+
+    // Retransmissions per announce before the tracker is given up on. One
+    // keeps a lost datagram from failing the tracker while bounding a
+    // request to 45 s with the default timeout.
+    int max_retransmits = 1;
+};
+
+// Drives UDP tracker announces and scrapes for every torrent in the process over one
+// non-blocking socket per address family. Responses are routed through a
+// transaction id table and timeouts come from a timer queue, so a request
+// costs a table entry instead of a socket and a blocked thread. Connection
+// ids are cached per tracker, so repeat announces take one round trip.
+class UdpTrackerEngine {
+public:
+    struct AnnounceRequest {
+        std::string info_hash;
+        std::string peer_id;
+        uint64_t downloaded = 0;
+        uint64_t left = 0;
+        uint64_t uploaded = 0;
+        int event = 0;
+        int num_want = -1;
+        uint16_t port = 0;
+    };
+
+    struct AnnounceResult {
+        UdpTracker::TrackerResponse response{};
+        // Empty when the tracker answered.
+        std::string error;
+    };
+
+    struct ScrapeResult {
+        // One entry per requested info hash, in request order.
+        std::vector<UdpTracker::ScrapeStats> stats;
+        // Empty when the tracker answered.
+        std::string error;
+    };
+
+    using AnnounceCallback = std::function<void(AnnounceResult)>;
+    using ScrapeCallback = std::function<void(ScrapeResult)>;
+
+    // Engine shared by all trackers and torrents of the process.
+    static UdpTrackerEngine& Shared();
+
+    explicit UdpTrackerEngine(const UdpTrackerOptions& options = {});
+    ~UdpTrackerEngine();
+
+    UdpTrackerEngine(const UdpTrackerEngine&) = delete;
+    UdpTrackerEngine& operator=(const UdpTrackerEngine&) = delete;
+
+    // on_done runs once on the engine thread. Cancel drops the request, but
+    // a callback that is already under way may still run, so it should only
+    // capture state it co-owns. Returns an id for Cancel.
+    uint64_t Announce(
+        const UdpEndpoint& tracker,
+        AnnounceRequest request,
+        AnnounceCallback on_done
+    );
+
+    // Scrapes up to UdpTracker::kMaxScrapeHashes torrents in one request.
+    // on_done is called like Announce's, and the id works with Cancel too.
+    uint64_t Scrape(
+        const UdpEndpoint& tracker,
+        std::vector<std::string> info_hashes,
+        ScrapeCallback on_done
+    );
+
+    void Cancel(uint64_t request_id);
+
+    // Time a request may take before on_done reports a timeout, with every
+    // retransmission waited out.
+    std::chrono::milliseconds RequestBudget() const;
+
+    size_t PendingCount() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Stage {
+        kConnect,
+        kRequest,
+    };
+
+    struct Transaction {
+        uint64_t request_id = 0;
+        UdpEndpoint tracker;
+        // A transaction with scrape hashes is a scrape, otherwise an announce.
+        AnnounceRequest request;
+        std::vector<std::string> scrape_hashes;
+        AnnounceCallback on_announced;
+        ScrapeCallback on_scraped;
+        Stage stage = Stage::kConnect;
+        uint64_t connection_id = 0;
+        Clock::time_point connection_expires;
+        bool cached_connection = false;
+        int retransmits = 0;
+        Clock::time_point deadline;
+    };
+
+    struct CachedConnection {
+        uint64_t connection_id = 0;
+        Clock::time_point expires;
+    };
+
+    // A finished transaction's callback, bound to its result and run
+    // outside the lock.
+    using Completion = std::function<void()>;
+
+    static constexpr std::chrono::milliseconds kMaxPollWait{1000};
+    static constexpr std::chrono::seconds kConnectionIdLifetime{60};
+    static constexpr int kMaxBackoffExponent = 8;
+    static constexpr int kReceiveBufferSize = 1 << 20;
+
+    void Run();
+    void Wake() const;
+    uint64_t Submit(Transaction transaction);
+    void Start(Transaction transaction, std::vector<Completion>& completed);
+    void Dispatch(Transaction transaction);
+    void Send(uint32_t transaction_id, Transaction& transaction);
+    void Receive(int socket_fd, std::vector<Completion>& completed);
+    void HandleResponse(
+        uint32_t transaction_id,
+        std::string_view response,
+        std::vector<Completion>& completed
+    );
+    void Complete(
+        Transaction& transaction,
+        uint32_t transaction_id,
+        std::string_view response,
+        std::vector<Completion>& completed
+    );
+    void CompleteWithError(
+        Transaction& transaction,
+        const std::string& error,
+        std::vector<Completion>& completed
+    );
+    void ExpireTimers(std::vector<Completion>& completed);
+    void Fail(
+        uint32_t transaction_id,
+        const std::string& error,
+        std::vector<Completion>& completed
+    );
+    uint32_t NewTransactionId();
+    int SocketFor(const UdpEndpoint& endpoint) const;
+    std::chrono::milliseconds RetransmitTimeout(int attempt) const;
+
+    const UdpTrackerOptions options;
+    int ipv4_socket = -1;
+    int ipv6_socket = -1;
+    int wake_fd = -1;
+
+    mutable std::mutex mutex;
+    bool stopping = false;
+    uint64_t next_request_id = 1;
+    std::vector<Transaction> submitted;
+    std::unordered_map<uint32_t, Transaction> transactions;
+    std::multimap<Clock::time_point, uint32_t> timers;
+    std::unordered_map<UdpEndpoint, CachedConnection, UdpEndpointHash> connections;
+    std::thread worker;
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <mutex>
+
+#include <curl/curl.h>
+
+// Curl share handle for tracker requests. DNS answers and TLS sessions are
+// shared by every handle attached to it, so a re-announce over HTTPS
+// resumes the TLS session instead of running a full handshake, even from a
+// new easy handle. Connections themselves stay pooled per multi handle or
+// easy handle. Thread-safe.
+class CurlShare {
+public:
+    // Share handle used by all trackers of the process. Initializes curl.
+    static CurlShare& Shared();
+
+    CurlShare();
+    ~CurlShare();
+
+    CurlShare(const CurlShare&) = delete;
+    CurlShare& operator=(const CurlShare&) = delete;
+
+    // Makes handle use the shared caches, keep its connections alive and
+    // accept compressed responses.
+    void Attach(CURL* handle) const;
+
+private:
+    // Trackers keep idle connections open for about this long.
+    static constexpr std::chrono::seconds kIdleConnectionLifetime{300};
+
+    static void Lock(CURL* handle, curl_lock_data data, curl_lock_access access, void* self);
+    static void Unlock(CURL* handle, curl_lock_data data, void* self);
+
+    CURLSH* share;
+    std::array<std::mutex, CURL_LOCK_DATA_LAST> locks;
+};
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <sys/socket.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct DnsResolverOptions {
+    size_t worker_count = 4;
+
+    // getaddrinfo does not report record TTLs, so answers are kept for a
+    // fixed time. Failures are cached too, for a shorter time.
+    std::chrono::seconds cache_ttl{300};
+    std::chrono::seconds negative_ttl{30};
+
+    // Expired answers are still handed out for this long while a refresh
+    // runs in the background, so re-announces never wait on DNS.
+    std::chrono::seconds stale_ttl{3600};
+};
+
+// Resolves host names on a small worker pool with a cache shared by every
+// tracker client. Concurrent lookups of the same host are merged into one.
+class DnsResolver {
+public:
+    struct Result {
+        // IPv4 and IPv6 addresses in getaddrinfo order, port left at 0.
+        std::vector<sockaddr_storage> addresses;
+        // Empty when the host resolved.
+        std::string error;
+    };
+
+    using Callback = std::function<void(const Result&)>;
+
+    // Resolver shared by all trackers and torrents of the process.
+    static DnsResolver& Shared();
+
+    explicit DnsResolver(const DnsResolverOptions& options = {});
+    ~DnsResolver();
+
+    DnsResolver(const DnsResolver&) = delete;
+    DnsResolver& operator=(const DnsResolver&) = delete;
+
+    // Calls on_done right away on a cache hit, otherwise later on a
+    // resolver thread. Lookups still queued on destruction are dropped.
+    void Resolve(const std::string& host, Callback on_done);
+
+    // Blocking variant. Must not be called from a Resolve callback.
+    Result ResolveNow(const std::string& host);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct CacheEntry {
+        Result result;
+        Clock::time_point expires;
+    };
+
+    void Run();
+    static Result Lookup(const std::string& host);
+
+    const DnsResolverOptions options;
+
+    std::mutex mutex;
+    std::condition_variable queue_changed;
+    bool stopping = false;
+    std::deque<std::string> queue;
+    std::unordered_map<std::string, std::vector<Callback>> in_flight;
+    std::unordered_map<std::string, CacheEntry> cache;
+    std::vector<std::thread> workers;
+};
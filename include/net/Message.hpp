@@ -1,7 +1,14 @@
 #pragma once
 
+#include <array>
 #include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+
+#include "utils/Endian.hpp"
 
 enum class MessageId : uint8_t {
     kChoke = 0,
@@ -15,15 +22,234 @@ enum class MessageId : uint8_t {
     kCancel,
     kPort,
     kKeepAlive,
+    kExtended = 20,
+    kHashRequest = 21,
+    kHashes = 22,
+    kHashReject = 23,
 };
 
-struct Message {
+// Peer wire codec. Every message type is a small struct with a fixed-size
+// part at constexpr offsets that is encoded into, or decoded from, a
+// caller-provided span; variable data (block, bitfield, hashes, extension
+// body) follows it as a trailer. Nothing here allocates except
+// EncodeWithTrailer.
+namespace wire {
+
+inline constexpr size_t kLengthPrefixSize = 4;
+inline constexpr size_t kHeaderSize = kLengthPrefixSize + 1;
+inline constexpr size_t kMessageIdCount = 24;
+
+// One complete message; payload points into the buffer it was parsed from.
+struct Frame {
     MessageId id;
-    size_t message_length;
-    std::string payload;
+    std::string_view payload;
+};
+
+// Parses a length-prefixed message as returned by TcpConnection.
+Frame ParseFrame(std::string_view data);
+
+template <MessageId Id>
+struct Empty {
+    static constexpr MessageId kId = Id;
+    static constexpr size_t kPayloadSize = 0;
+
+    void EncodePayload(std::span<char, kPayloadSize>) const {}
+
+    static Empty DecodePayload(std::span<const char, kPayloadSize>) {
+        return {};
+    }
+};
+
+using Choke = Empty<MessageId::kChoke>;
+using Unchoke = Empty<MessageId::kUnchoke>;
+using Interested = Empty<MessageId::kInterested>;
+using NotInterested = Empty<MessageId::kNotInterested>;
+// Followed by the bitfield itself.
+using BitField = Empty<MessageId::kBitField>;
+
+struct Have {
+    static constexpr MessageId kId = MessageId::kHave;
+    static constexpr size_t kPayloadSize = 4;
+
+    uint32_t index = 0;
+
+    void EncodePayload(std::span<char, kPayloadSize> out) const {
+        utils::StoreBigEndian(out.data(), index);
+    }
+
+    static Have DecodePayload(std::span<const char, kPayloadSize> in) {
+        return { utils::LoadBigEndian<uint32_t>(in.data()) };
+    }
+};
+
+template <MessageId Id>
+struct BlockRange {
+    static constexpr MessageId kId = Id;
+    static constexpr size_t kPayloadSize = 12;
+
+    uint32_t index = 0;
+    uint32_t offset = 0;
+    uint32_t length = 0;
+
+    void EncodePayload(std::span<char, kPayloadSize> out) const {
+        utils::StoreBigEndian(out.data(), index);
+        utils::StoreBigEndian(out.data() + 4, offset);
+        utils::StoreBigEndian(out.data() + 8, length);
+    }
+
+    static BlockRange DecodePayload(std::span<const char, kPayloadSize> in) {
+        return {
+            utils::LoadBigEndian<uint32_t>(in.data()),
+            utils::LoadBigEndian<uint32_t>(in.data() + 4),
+            utils::LoadBigEndian<uint32_t>(in.data() + 8),
+        };
+    }
+};
+
+using Request = BlockRange<MessageId::kRequest>;
+using Cancel = BlockRange<MessageId::kCancel>;
+
+// Followed by the block data.
+struct PieceHeader {
+    static constexpr MessageId kId = MessageId::kPiece;
+    static constexpr size_t kPayloadSize = 8;
+
+    uint32_t index = 0;
+    uint32_t offset = 0;
+
+    void EncodePayload(std::span<char, kPayloadSize> out) const {
+        utils::StoreBigEndian(out.data(), index);
+        utils::StoreBigEndian(out.data() + 4, offset);
+    }
 
-    static Message Parse(const std::string& message_string);
-    static Message Init(MessageId id, const std::string& payload);
-    std::string ToString() const;
+    static PieceHeader DecodePayload(std::span<const char, kPayloadSize> in) {
+        return {
+            utils::LoadBigEndian<uint32_t>(in.data()),
+            utils::LoadBigEndian<uint32_t>(in.data() + 4),
+        };
+    }
 };
 
+struct Port {
+    static constexpr MessageId kId = MessageId::kPort;
+    static constexpr size_t kPayloadSize = 2;
+
+    uint16_t port = 0;
+
+    void EncodePayload(std::span<char, kPayloadSize> out) const {
+        utils::StoreBigEndian(out.data(), port);
+    }
+
+    static Port DecodePayload(std::span<const char, kPayloadSize> in) {
+        return { utils::LoadBigEndian<uint16_t>(in.data()) };
+    }
+};
+
+// Followed by the extension's bencoded body.
+struct ExtendedHeader {
+    static constexpr MessageId kId = MessageId::kExtended;
+    static constexpr size_t kPayloadSize = 1;
+
+    uint8_t extension_id = 0;
+
+    void EncodePayload(std::span<char, kPayloadSize> out) const {
+        out[0] = static_cast<char>(extension_id);
+    }
+
+    static ExtendedHeader DecodePayload(std::span<const char, kPayloadSize> in) {
+        return { static_cast<uint8_t>(in[0]) };
+    }
+};
+
+// BEP 52 hash request, hashes (followed by the hashes) and hash reject.
+template <MessageId Id>
+struct HashRange {
+    static constexpr MessageId kId = Id;
+    static constexpr size_t kPayloadSize = 48;
+
+    std::array<char, 32> pieces_root{};
+    uint32_t base_layer = 0;
+    uint32_t index = 0;
+    uint32_t length = 0;
+    uint32_t proof_layers = 0;
+
+    void EncodePayload(std::span<char, kPayloadSize> out) const {
+        std::memcpy(out.data(), pieces_root.data(), pieces_root.size());
+        utils::StoreBigEndian(out.data() + 32, base_layer);
+        utils::StoreBigEndian(out.data() + 36, index);
+        utils::StoreBigEndian(out.data() + 40, length);
+        utils::StoreBigEndian(out.data() + 44, proof_layers);
+    }
+
+    static HashRange DecodePayload(std::span<const char, kPayloadSize> in) {
+        HashRange range;
+        std::memcpy(range.pieces_root.data(), in.data(), range.pieces_root.size());
+        range.base_layer = utils::LoadBigEndian<uint32_t>(in.data() + 32);
+        range.index = utils::LoadBigEndian<uint32_t>(in.data() + 36);
+        range.length = utils::LoadBigEndian<uint32_t>(in.data() + 40);
+        range.proof_layers = utils::LoadBigEndian<uint32_t>(in.data() + 44);
+        return range;
+    }
+};
+
+using HashRequest = HashRange<MessageId::kHashRequest>;
+using HashesHeader = HashRange<MessageId::kHashes>;
+using HashReject = HashRange<MessageId::kHashReject>;
+
+template <typename T>
+inline constexpr size_t kEncodedSize = kHeaderSize + T::kPayloadSize;
+
+template <typename T>
+using EncodedMessage = std::array<char, kEncodedSize<T>>;
+
+template <typename T>
+void Encode(
+    const T& message,
+    std::span<char, kEncodedSize<T>> out,
+    size_t trailer_size = 0
+) {
+    utils::StoreBigEndian(
+        out.data(),
+        static_cast<uint32_t>(1 + T::kPayloadSize + trailer_size)
+    );
+    out[kLengthPrefixSize] = static_cast<char>(T::kId);
+    message.EncodePayload(out.template subspan<kHeaderSize>());
+}
+
+template <typename T>
+EncodedMessage<T> Encode(const T& message = {}) {
+    EncodedMessage<T> out;
+    Encode(message, std::span<char, kEncodedSize<T>>(out));
+    return out;
+}
+
+template <typename T>
+std::string EncodeWithTrailer(const T& message, std::string_view trailer) {
+    std::string out(kEncodedSize<T> + trailer.size(), '\0');
+    Encode(
+        message,
+        std::span<char, kEncodedSize<T>>(out.data(), kEncodedSize<T>),
+        trailer.size()
+    );
+    std::memcpy(out.data() + kEncodedSize<T>, trailer.data(), trailer.size());
+    return out;
+}
+
+// Decodes the fixed part of a payload; the trailer starts at
+// T::kPayloadSize.
+template <typename T>
+T Decode(std::string_view payload) {
+    if (payload.size() < T::kPayloadSize) {
+        throw std::runtime_error("Message payload too short");
+    }
+    return T::DecodePayload(
+        std::span<const char, T::kPayloadSize>(payload.data(), T::kPayloadSize)
+    );
+}
+
+template <typename T>
+std::string_view Trailer(std::string_view payload) {
+    return payload.substr(T::kPayloadSize);
+}
+
+} // namespace wire
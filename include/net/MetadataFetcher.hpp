@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "net/Peer.hpp"
+#include "net/TcpConnection.hpp"
+
+// Downloads the info dictionary of a magnet link over the extension
+// protocol (BEP 10) and ut_metadata (BEP 9). Several peers work on the
+// same metadata at once and claim pieces from a shared table, and idle
+// peers duplicate the last outstanding requests, so the slowest peer
+// never holds up completion. Peers may keep arriving while a fetch runs,
+// so the first tracker to answer is enough to get going.
+class MetadataFetcher {
+public:
+    static constexpr size_t kMetadataPieceSize = 16 * 1024;
+    static constexpr size_t kMaxMetadataSize = 16 * 1024 * 1024;
+    static constexpr size_t kMaxParallelPeers = 8;
+
+    MetadataFetcher(std::string info_hash, std::string self_peer_id);
+    ~MetadataFetcher();
+
+    MetadataFetcher(const MetadataFetcher&) = delete;
+    MetadataFetcher& operator=(const MetadataFetcher&) = delete;
+
+    // Queues peers from any thread, before or during Fetch. Connections
+    // start right away, up to kMaxParallelPeers at a time.
+    void AddPeers(const std::vector<Peer>& peers);
+
+    // Promises that no more peers are coming, so Fetch gives up as soon as
+    // the queued ones are exhausted instead of waiting for the timeout.
+    void EndOfPeers();
+
+    // Returns the bencoded info dictionary once its SHA-1 matches the
+    // info-hash; throws if no peer delivered it within the timeout.
+    std::string Fetch(
+        const std::atomic<bool>& stop_requested,
+        std::chrono::seconds timeout
+    );
+
+    // Fetches from a fixed peer list.
+    std::string Fetch(
+        const std::vector<Peer>& peers,
+        const std::atomic<bool>& stop_requested,
+        std::chrono::seconds timeout
+    );
+
+private:
+    enum class PieceState : uint8_t {
+        kMissing,
+        kRequested,
+        kReceived,
+    };
+
+    static constexpr uint8_t kExtendedHandshakeId = 0;
+    static constexpr uint8_t kUtMetadataId = 1;
+    static constexpr size_t kMaxInflightRequests = 4;
+    static constexpr int kMaxIdleReads = 3;
+    static constexpr int kMaxHashFailures = 3;
+
+    void Worker();
+    void JoinWorkers();
+    void FetchFromPeer(const Peer& peer);
+    void PerformHandshake(TcpConnection& socket) const;
+    uint8_t PerformExtendedHandshake(TcpConnection& socket);
+
+    bool RegisterConnection(const std::shared_ptr<TcpConnection>& socket);
+    void UnregisterConnection(const std::shared_ptr<TcpConnection>& socket);
+    void SetMetadataSize(size_t size);
+    bool ClaimPiece(const std::vector<size_t>& own_requests, size_t& index);
+    void ReleasePieces(const std::vector<size_t>& indices);
+    void StorePiece(size_t index, std::string_view data);
+    void Finish(bool verified);
+
+    std::string info_hash;
+    std::string self_peer_id;
+
+    std::mutex mutex;
+    std::condition_variable finished;
+    std::deque<Peer> pending_peers;
+    std::vector<std::shared_ptr<TcpConnection>> connections;
+    std::vector<std::thread> workers;
+    size_t running_workers = 0;
+    bool peers_complete = false;
+    bool done = false;
+    bool verified = false;
+    int hash_failures = 0;
+
+    size_t metadata_size = 0;
+    std::string metadata;
+    std::vector<PieceState> piece_states;
+    size_t received_pieces = 0;
+};
@@ -1,9 +1,47 @@
 #pragma once
 
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <string>
+#include <string_view>
 
+// Peer endpoint in wire form. IPv4 addresses are kept IPv4-mapped
+// (::ffff:a.b.c.d), so both families share one 16-byte layout and compare
+// and hash as plain bytes. Every constructor turns IPv4-mapped IPv6
+// addresses into IPv4 peers.
 struct Peer {
-    std::string ip;
-    int port;
+    // Sizes of one peer in the compact "peers" and "peers6" formats.
+    static constexpr size_t kCompactIpv4Size = 6;
+    static constexpr size_t kCompactIpv6Size = 18;
+
+    std::array<uint8_t, 16> address{};
+    uint16_t port = 0;
+    uint8_t family = AF_INET;
+
+    // address is in host byte order.
+    static Peer FromIpv4(uint32_t address, uint16_t port);
+    // Address bytes followed by the port, both in network byte order.
+    static Peer FromCompact(std::string_view bytes);
+    // Throws when ip is not an IPv4 or IPv6 literal.
+    static Peer FromString(std::string_view ip, uint16_t port);
+    // Throws for families other than AF_INET and AF_INET6.
+    static Peer FromSockaddr(const sockaddr_storage& storage);
+
+    bool IsIpv6() const { return family == AF_INET6; }
+    std::string Ip() const;
+    // "1.2.3.4:6881" or "[2001:db8::1]:6881".
+    std::string ToString() const;
+    socklen_t ToSockaddr(sockaddr_storage& storage) const;
+    // Inverse of FromCompact: 6 bytes for IPv4, 18 for IPv6.
+    std::string ToCompact() const;
+
+    bool operator==(const Peer& other) const = default;
 };
 
+struct PeerHash {
+    size_t operator()(const Peer& peer) const;
+};
@@ -1,10 +1,13 @@
 #pragma once
 
+#include <array>
 #include <atomic>
 #include <unordered_set>
 
+#include "core/PieceSet.hpp"
 #include "core/PieceStorage.hpp"
 #include "core/TorrentFile.hpp"
+#include "net/Message.hpp"
 #include "net/Peer.hpp"
 #include "net/TcpConnection.hpp"
 
@@ -18,49 +21,57 @@ public:
     );
 
     void Run();
+    // Safe from any thread, Run closes the socket on its way out.
     void Terminate();
     bool IsTerminated() const;
     std::string GetPeerId() const;
     bool Failed() const;
 
 private:
-    class PeerPiecesAvailability {
-    public:
-        PeerPiecesAvailability() = default;
-        PeerPiecesAvailability(std::string bitfield, size_t size);
-
-        bool IsPieceAvailable(size_t piece_index) const;
-        void SetPieceAvailability(size_t piece_index);
-
-    private:
-        std::string bitfield;
-        size_t size = 0;
-    };
-
     bool EstablishConnection();
     void PerformHandshake();
+    void SendBitfield();
     void ReceiveBitfield();
     void SendInterested();
     void MainLoop();
-    void ProcessMessage(const std::string& message_data);
+    void ProcessMessage(std::string_view message_data);
+    void OnChoke(std::string_view payload);
+    void OnUnchoke(std::string_view payload);
+    void OnInterested(std::string_view payload);
+    void OnNotInterested(std::string_view payload);
+    void OnHave(std::string_view payload);
+    void OnRequest(std::string_view payload);
+    void OnPiece(std::string_view payload);
+    void OnHashes(std::string_view payload);
     void RequestBlock(const Block* block);
+    void RequestBlockHashes(const Piece& piece);
     void HandleConnectionError();
     PiecePtr GetNextAvailablePiece();
 
+    using MessageHandler = void (PeerConnection::*)(std::string_view payload);
+    static const std::array<MessageHandler, wire::kMessageIdCount> kMessageHandlers;
+
     static constexpr int kMaxInflightBlocks = 16;
+    // Blocks failing their merkle leaf before the peer is dropped.
+    static constexpr int kMaxLeafFailures = 4;
+    // Longer REQUESTs are ignored.
+    static constexpr uint32_t kMaxServedBlockLength = 128 * 1024;
 
-    TorrentFile torrent_file;
+    const TorrentFile& torrent_file;
     TcpConnection socket;
     std::string self_peer_id;
     std::string peer_id;
 
-    PeerPiecesAvailability pieces_availability;
+    PieceSet pieces_availability;
     PieceStorage& piece_storage;
 
     PiecePtr piece_in_progress;
     std::unordered_set<size_t> inflight_offsets;
 
     bool is_choked = true;
+    bool is_choking_peer = true;
+    bool supports_v2 = false;
+    int leaf_failures = 0;
     std::atomic<bool> is_terminated = false;
     bool has_failed = false;
 };
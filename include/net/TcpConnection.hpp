@@ -9,34 +9,46 @@
 #include <atomic>
 #include <chrono>
 #include <cstring>
+#include <mutex>
 #include <string>
+#include <string_view>
+
+#include "net/Peer.hpp"
 
 class TcpConnection {
 public:
     explicit TcpConnection(
-        std::string ip,
-        int port, 
+        const Peer& peer,
         std::chrono::milliseconds connect_timeout, 
         std::chrono::milliseconds read_timeout
     );
 
     ~TcpConnection();
 
+    // Fails once the connection was closed or interrupted.
     void EstablishConnection();
-    void SendData(const std::string& data) const;
+    void SendData(std::string_view data) const;
     std::string ReceiveData(size_t buffer_size = 0) const;
+    // Only for the thread using the connection: the descriptor is closed
+    // and its number may be reused right away.
     void CloseConnection();
     void ForceClose();
-    const std::string& GetIp() const;
-    int GetPort() const;
+    // Safe from any thread: wakes up blocked calls and makes further ones
+    // fail, leaving the close to the thread using the connection.
+    void Interrupt();
+    const Peer& GetPeer() const;
     bool IsTerminated() const;
 
 private:
-    const std::string ip;
-    const int port;
+    void CloseSocket();
+
+    const Peer peer;
     std::chrono::milliseconds connect_timeout;
     std::chrono::milliseconds read_timeout;
     mutable std::atomic<bool> force_close{false};
-    mutable int socket_fd;
+    // Changed by the owning thread only, under fd_mutex so Interrupt never
+    // shuts down a descriptor that was closed and reused.
+    int socket_fd;
+    std::mutex fd_mutex;
 };
 
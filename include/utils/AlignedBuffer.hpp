@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string_view>
+#include <utility>
+
+namespace utils {
+
+// Uninitialized heap buffer whose start and capacity are aligned for
+// direct I/O. Bytes past Size() up to Capacity() are scratch space.
+class AlignedBuffer {
+public:
+    static constexpr size_t kAlignment = 4096;
+
+    AlignedBuffer() = default;
+
+    explicit AlignedBuffer(size_t size) :
+        size(size),
+        capacity(AlignUp(size))
+    {
+        if (capacity == 0) {
+            return;
+        }
+
+        // glibc serves large aligned_alloc() requests with a fresh mmap()
+        // every time, so over-allocate from malloc() and align by hand.
+        storage.reset(static_cast<char*>(std::malloc(capacity + kAlignment - 1)));
+        if (!storage) {
+            throw std::bad_alloc();
+        }
+
+        auto address = reinterpret_cast<std::uintptr_t>(storage.get());
+        buffer = storage.get() + (AlignUp(address) - address);
+    }
+
+    AlignedBuffer(AlignedBuffer&& other) noexcept :
+        storage(std::move(other.storage)),
+        buffer(std::exchange(other.buffer, nullptr)),
+        size(std::exchange(other.size, 0)),
+        capacity(std::exchange(other.capacity, 0))
+    {}
+
+    AlignedBuffer& operator=(AlignedBuffer&& other) noexcept {
+        storage = std::move(other.storage);
+        buffer = std::exchange(other.buffer, nullptr);
+        size = std::exchange(other.size, 0);
+        capacity = std::exchange(other.capacity, 0);
+        return *this;
+    }
+
+    static constexpr size_t AlignUp(size_t value) {
+        return (value + kAlignment - 1) / kAlignment * kAlignment;
+    }
+
+    char* Data() { return buffer; }
+    const char* Data() const { return buffer; }
+    size_t Size() const { return size; }
+    size_t Capacity() const { return capacity; }
+    std::string_view View() const { return { buffer, size }; }
+
+private:
+    struct FreeDeleter {
+        void operator()(char* ptr) const { std::free(ptr); }
+    };
+
+    std::unique_ptr<char, FreeDeleter> storage;
+    char* buffer = nullptr;
+    size_t size = 0;
+    size_t capacity = 0;
+};
+
+} // namespace utils
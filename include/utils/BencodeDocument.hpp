@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "utils/InputBuffer.hpp"
+
+namespace utils {
+
+// Read-only bencode value tree. Nodes live in one array in document order
+// and refer to the input buffer instead of copying it. Container children
+// are stored as contiguous index ranges; dictionary ranges are sorted by
+// key, so lookups are binary searches and list indexing is O(1).
+class BencodeDocument {
+public:
+    enum class Type : uint8_t {
+        kInteger,
+        kString,
+        kList,
+        kDict,
+    };
+
+    struct Node {
+        Type type;
+        uint8_t prefix_length;
+        uint32_t first_child;
+        uint32_t child_count;
+        std::string_view key;
+
+        // Payload for strings, which is preceded by prefix_length bytes of
+        // length and ':'; the complete encoding for other types.
+        std::string_view data;
+        int64_t integer;
+    };
+
+    class Value {
+    public:
+        Value() = default;
+
+        explicit operator bool() const { return nodes != nullptr; }
+        bool IsInteger() const { return Is(Type::kInteger); }
+        bool IsString() const { return Is(Type::kString); }
+        bool IsList() const { return Is(Type::kList); }
+        bool IsDict() const { return Is(Type::kDict); }
+
+        int64_t AsInteger() const;
+        std::string_view AsString() const;
+        int64_t IntegerOr(int64_t fallback) const;
+        std::string_view StringOr(std::string_view fallback) const;
+
+        // Encoded bytes of the value, e.g. for hashing the info dictionary.
+        std::string_view Raw() const;
+        std::string_view Key() const;
+
+        size_t Size() const;
+        Value operator[](size_t index) const;
+        Value Find(std::string_view key) const;
+
+    private:
+        friend class BencodeDocument;
+
+        Value(const BencodeDocument* document, uint32_t index) :
+            nodes(document->nodes.data()),
+            children(document->children.data()),
+            index(index)
+        {}
+
+        bool Is(Type type) const;
+        const Node& Get() const { return nodes[index]; }
+
+        const Node* nodes = nullptr;
+        const uint32_t* children = nullptr;
+        uint32_t index = 0;
+    };
+
+    static BencodeDocument Parse(InputBuffer buffer);
+    static BencodeDocument FromFile(const std::string& filename);
+    static BencodeDocument FromString(std::string data);
+
+    Value Root() const;
+
+    // Dotted path with list indices, e.g. "info.files[3].length". Returns
+    // a null Value when any step is missing.
+    Value Query(std::string_view path) const;
+
+    size_t NodeCount() const { return nodes.size(); }
+
+private:
+    BencodeDocument() = default;
+
+    void Build();
+
+    InputBuffer buffer;
+    std::vector<Node> nodes;
+    std::vector<uint32_t> children;
+};
+
+} // namespace utils
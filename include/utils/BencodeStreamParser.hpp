@@ -0,0 +1,75 @@
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace utils {
+
+class BencodeHandler {
+public:
+    virtual ~BencodeHandler() = default;
+
+    virtual void OnKey(std::string_view key) { static_cast<void>(key); }
+    virtual void OnInteger(int64_t value) { static_cast<void>(value); }
+
+    // String values are delivered in fragments as they arrive, so a large
+    // value never has to be held in memory at once.
+    virtual void OnStringBegin(size_t length) { static_cast<void>(length); }
+    virtual void OnStringData(std::string_view fragment) { static_cast<void>(fragment); }
+    virtual void OnStringEnd() {}
+
+    virtual void OnListBegin() {}
+    virtual void OnDictBegin() {}
+    virtual void OnEnd() {}
+};
+
+// Push parser: input is fed in arbitrary chunks and parsing state is kept
+// between them. Memory use is bounded by the longest dictionary key.
+class BencodeStreamParser {
+public:
+    static constexpr size_t kMaxDepth = 64;
+    static constexpr size_t kMaxKeyLength = 4096;
+
+    explicit BencodeStreamParser(BencodeHandler& handler);
+
+    // Returns the number of bytes consumed. Fewer than chunk.size() are
+    // consumed only once the top-level value is complete.
+    size_t Feed(std::string_view chunk);
+    // Throws unless a complete top-level value was fed.
+    void Finish() const;
+    bool IsComplete() const;
+
+private:
+    enum class State : uint8_t {
+        kValue,
+        kStringLength,
+        kStringData,
+        kInteger,
+        kComplete,
+    };
+
+    void BeginValue(char current_char);
+    void EndValue();
+    void EnterContainer(bool dict);
+    bool ExpectsKey() const;
+
+    BencodeHandler& handler;
+    State state;
+
+    size_t depth;
+    std::bitset<kMaxDepth> is_dict;
+    std::bitset<kMaxDepth> expects_key;
+
+    // Digits of the integer or string length being read.
+    std::array<char, 24> digits;
+    size_t digits_count;
+
+    size_t string_remaining;
+    bool string_is_key;
+    std::string key;
+};
+
+} // namespace utils
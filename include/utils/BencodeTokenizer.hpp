@@ -0,0 +1,59 @@
+#pragma once
+
+#include <bitset>
+#include <cstdint>
+#include <string_view>
+
+namespace utils {
+
+struct BencodeToken {
+    enum class Type : uint8_t {
+        kInteger,
+        kString,
+        kListBegin,
+        kDictBegin,
+        kEnd,
+    };
+
+    Type type;
+    bool is_key;
+
+    // Nesting depth of the token, 0 for the top-level value. kEnd has the
+    // depth of the container it closes.
+    size_t depth;
+
+    // Offset of the token's first byte ('i', 'l', 'd', 'e' or the length
+    // prefix) in the input.
+    size_t offset;
+
+    // Payload of kString, digits of kInteger; points into the input.
+    std::string_view data;
+    int64_t integer;
+};
+
+// Pull tokenizer over an immutable bencoded buffer. Tokens refer to the
+// input instead of copying it, integers are decoded in place, and nothing
+// is allocated while tokenizing.
+class BencodeTokenizer {
+public:
+    static constexpr size_t kMaxDepth = 64;
+
+    explicit BencodeTokenizer(std::string_view input);
+
+    // Returns false once the top-level value has been fully consumed.
+    bool Next(BencodeToken& token);
+    size_t Offset() const;
+
+private:
+    std::string_view ReadString(size_t& index) const;
+    void EnterContainer(bool is_dict);
+
+    std::string_view input;
+    size_t index;
+    size_t depth;
+    bool finished;
+    std::bitset<kMaxDepth> is_dict;
+    std::bitset<kMaxDepth> expects_key;
+};
+
+} // namespace utils
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "utils/BencodeDocument.hpp"
+#include "utils/Sha1Hasher.hpp"
+
+namespace utils {
+
+// Streaming bencode encoder appending straight into a caller-owned
+// buffer. Dictionary keys must be written in ascending byte order, which
+// keeps the output canonical without buffering; out-of-order keys throw.
+class BencodeWriter {
+public:
+    static constexpr size_t kMaxDepth = 64;
+
+    explicit BencodeWriter(std::string& output);
+
+    BencodeWriter& Integer(int64_t value);
+    BencodeWriter& String(std::string_view value);
+    BencodeWriter& BeginList();
+    BencodeWriter& BeginDict();
+    BencodeWriter& Key(std::string_view key);
+    BencodeWriter& End();
+
+    // Copies a parsed value; document dictionaries are already sorted.
+    BencodeWriter& Value(const BencodeDocument::Value& value);
+
+    // Appends an already encoded value verbatim, for bytes that must not be
+    // re-encoded such as an info dictionary behind a known info-hash.
+    BencodeWriter& Raw(std::string_view encoded);
+
+    // Everything written between BeginHash and EndHash is hashed as it is
+    // produced, e.g. the info dictionary for the info-hash.
+    void BeginHash();
+    Sha1Digest EndHash();
+
+    bool IsComplete() const;
+
+private:
+    struct Frame {
+        bool is_dict;
+        bool expects_key;
+        size_t last_key_offset;
+        size_t last_key_length;
+        bool has_key;
+    };
+
+    static constexpr size_t kHashFlushSize = 16 * 1024;
+
+    void BeforeValue();
+    void AfterValue();
+    void Append(std::string_view data);
+    void Append(char ch);
+    void FlushHash();
+
+    std::string& output;
+    std::array<Frame, kMaxDepth> frames;
+    size_t depth;
+    bool complete;
+
+    std::optional<Sha1Hasher> hasher;
+    size_t hashed_offset;
+};
+
+} // namespace utils
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <bit>
+#include <concepts>
+#include <cstring>
+
+namespace utils {
+
+template <std::unsigned_integral T>
+constexpr T ByteSwap(T value) {
+#if defined(__cpp_lib_byteswap)
+    return std::byteswap(value);
+#else
+    if constexpr (sizeof(T) == 1) {
+        return value;
+    } else if constexpr (sizeof(T) == 2) {
+        return __builtin_bswap16(value);
+    } else if constexpr (sizeof(T) == 4) {
+        return __builtin_bswap32(value);
+    } else {
+        return __builtin_bswap64(value);
+    }
+#endif
+}
+
+template <std::unsigned_integral T>
+constexpr T HostToBigEndian(T value) {
+    if constexpr (std::endian::native == std::endian::little) {
+        return ByteSwap(value);
+    } else {
+        return value;
+    }
+}
+
+// Unaligned big-endian access for wire formats.
+template <std::unsigned_integral T>
+T LoadBigEndian(const char* data) {
+    T value;
+    std::memcpy(&value, data, sizeof(T));
+    return HostToBigEndian(value);
+}
+
+template <std::unsigned_integral T>
+void StoreBigEndian(char* data, T value) {
+    value = HostToBigEndian(value);
+    std::memcpy(data, &value, sizeof(T));
+}
+
+} // namespace utils
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace utils {
+
+// Immutable input bytes, either a read-only memory mapping of a file or
+// an owned string. Views handed out stay valid while the buffer lives,
+// including across moves.
+class InputBuffer {
+public:
+    InputBuffer() = default;
+    ~InputBuffer();
+
+    InputBuffer(InputBuffer&& other) noexcept;
+    InputBuffer& operator=(InputBuffer&& other) noexcept;
+    InputBuffer(const InputBuffer&) = delete;
+    InputBuffer& operator=(const InputBuffer&) = delete;
+
+    static InputBuffer FromFile(const std::string& filename);
+    static InputBuffer FromString(std::string data);
+
+    std::string_view View() const;
+
+private:
+    void Release();
+
+    void* mapping = nullptr;
+    size_t mapping_size = 0;
+    std::unique_ptr<std::string> owned;
+};
+
+} // namespace utils
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <string_view>
+
+#include <openssl/evp.h>
+
+namespace utils {
+
+using Sha1Digest = std::array<char, 20>;
+
+class Sha1Hasher {
+public:
+    Sha1Hasher();
+
+    void Update(std::string_view data);
+    Sha1Digest Finish();
+
+private:
+    struct ContextDeleter {
+        void operator()(EVP_MD_CTX* context) const { EVP_MD_CTX_free(context); }
+    };
+
+    std::unique_ptr<EVP_MD_CTX, ContextDeleter> context;
+};
+
+} // namespace utils
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <array>
+#include <span>
+#include <string_view>
+
+namespace utils {
+
+using Sha256Digest = std::array<char, 32>;
+
+// One-shot SHA-256. OpenSSL selects the SHA-NI or AVX2 block function at
+// runtime, which matters for the many small inputs of merkle trees.
+Sha256Digest Sha256(std::string_view data);
+
+// Hash of two concatenated child nodes of a merkle tree.
+Sha256Digest Sha256Pair(const Sha256Digest& left, const Sha256Digest& right);
+
+// Root of a BEP 52 merkle tree over `nodes`, padded with `pad` up to
+// `width` nodes (a power of two no smaller than nodes.size()). Leaves are
+// padded with zero digests; upper layers pass the root of an all-zero
+// subtree of matching size, see PadDigest.
+Sha256Digest MerkleRoot(
+    std::span<const Sha256Digest> nodes,
+    size_t width,
+    const Sha256Digest& pad = {}
+);
+
+// Root of a subtree made only of `leaf_count` zero leaves.
+Sha256Digest PadDigest(size_t leaf_count);
+
+size_t NextPowerOfTwo(size_t value);
+
+} // namespace utils
@@ -15,5 +15,9 @@ std::string CalculateSha1(std::string_view msg);
 std::string HexEncode(std::string_view input);
 std::string BytesToHex(std::string_view bytes);
 
+// URL query decoding: %XX escapes and '+' for space. Malformed escapes are
+// kept as they are.
+std::string PercentDecode(std::string_view value);
+
 } // namespace utils
 
@@ -0,0 +1,253 @@
+#include "core/AnnounceScheduler.hpp"
+
+#include <algorithm>
+#include <map>
+
+AnnounceScheduler::AnnounceScheduler(
+    TrackerAnnouncer& announcer,
+    TrackerRanking& ranking
+) :
+    announcer(announcer),
+    ranking(ranking)
+{}
+
+AnnounceScheduler::~AnnounceScheduler() {
+    Stop();
+}
+
+void AnnounceScheduler::Start(
+    const std::vector<std::string>& tracker_urls,
+    const AnnounceParams& announce_params,
+    StatsProvider stats_provider,
+    TrackerAnnouncer::ResultCallback result_callback
+) {
+    Stop();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    params = announce_params;
+    stats = std::move(stats_provider);
+    on_result = std::move(result_callback);
+
+    auto now = Clock::now();
+    trackers.clear();
+    for (const auto& url : tracker_urls) {
+        trackers.push_back({ url, now, now });
+    }
+    next_scrape = now;
+
+    download_complete = false;
+    stopping = false;
+    announcing = true;
+    worker = std::thread(&AnnounceScheduler::Run, this);
+}
+
+void AnnounceScheduler::Completed() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        download_complete = true;
+
+        auto now = Clock::now();
+        for (auto& tracker : trackers) {
+            if (tracker.started && !tracker.completed) {
+                tracker.next_announce = now;
+            }
+        }
+    }
+    wake.notify_all();
+}
+
+void AnnounceScheduler::RequestPeers() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& tracker : trackers) {
+            if (tracker.started && tracker.failures == 0) {
+                tracker.next_announce = std::min(tracker.next_announce, tracker.earliest_announce);
+            }
+        }
+    }
+    wake.notify_all();
+}
+
+void AnnounceScheduler::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+
+    std::vector<std::string> to_complete;
+    std::vector<std::string> to_stop;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& tracker : trackers) {
+            if (!tracker.started) {
+                continue;
+            }
+            if (download_complete && !tracker.completed) {
+                to_complete.push_back(tracker.url);
+            }
+            to_stop.push_back(tracker.url);
+        }
+        trackers.clear();
+    }
+
+    std::atomic<bool> never_stop{false};
+    auto announce_final = [&](TrackerEvent event, const std::vector<std::string>& urls) {
+        if (urls.empty()) {
+            return;
+        }
+
+        AnnounceParams final_params = params;
+        auto counters = stats();
+        final_params.uploaded = counters.uploaded;
+        final_params.downloaded = counters.downloaded;
+        final_params.left = counters.left;
+        final_params.event = event;
+        announcer.AnnounceAll(urls, final_params, never_stop, [](const AnnounceResult&) {}, kStopTimeout);
+    };
+
+    // A completed event still queued goes out first, trackers count
+    // finished downloads from it.
+    announce_final(TrackerEvent::kCompleted, to_complete);
+    announce_final(TrackerEvent::kStopped, to_stop);
+
+    announcing = false;
+}
+
+void AnnounceScheduler::Run() {
+    while (true) {
+        std::map<TrackerEvent, std::vector<std::string>> due;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (!stopping) {
+                auto now = Clock::now();
+                auto next = Clock::time_point::max();
+                for (auto& tracker : trackers) {
+                    if (tracker.next_announce > now) {
+                        next = std::min(next, tracker.next_announce);
+                        continue;
+                    }
+
+                    // Keeps a tracker the round does not report on from
+                    // spinning the loop.
+                    tracker.next_announce = now + kRetryDelay;
+                    due[NextEvent(tracker)].push_back(tracker.url);
+                }
+                if (!due.empty()) {
+                    break;
+                }
+
+                announcing = false;
+                if (next == Clock::time_point::max()) {
+                    wake.wait(lock);
+                } else {
+                    wake.wait_until(lock, next);
+                }
+            }
+            if (stopping) {
+                return;
+            }
+            announcing = true;
+        }
+
+        for (const auto& [event, urls] : due) {
+            AnnounceRound(event, urls);
+        }
+
+        if (!stopping && Clock::now() >= next_scrape) {
+            announcing = false;
+            ScrapeRound();
+        }
+    }
+}
+
+TrackerEvent AnnounceScheduler::NextEvent(const Tracker& tracker) const {
+    if (!tracker.started) {
+        return TrackerEvent::kStarted;
+    }
+    if (download_complete && !tracker.completed) {
+        return TrackerEvent::kCompleted;
+    }
+    return TrackerEvent::kNone;
+}
+
+void AnnounceScheduler::AnnounceRound(
+    TrackerEvent event,
+    const std::vector<std::string>& urls
+) {
+    AnnounceParams round_params = params;
+    auto counters = stats();
+    round_params.uploaded = counters.uploaded;
+    round_params.downloaded = counters.downloaded;
+    round_params.left = counters.left;
+    round_params.event = event;
+
+    announcer.AnnounceAll(ranking.Rank(urls), round_params, stopping, [&](const AnnounceResult& result) {
+        ranking.RecordAnnounce(result);
+        HandleResult(round_params, result);
+        on_result(result);
+    });
+}
+
+void AnnounceScheduler::ScrapeRound() {
+    std::vector<std::string> urls;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& tracker : trackers) {
+            urls.push_back(tracker.url);
+        }
+        next_scrape = Clock::now() + kScrapeInterval;
+    }
+
+    announcer.ScrapeAll(
+        urls,
+        { params.info_hash },
+        stopping,
+        [this](const ScrapeResult& result) { ranking.RecordScrape(result); }
+    );
+}
+
+void AnnounceScheduler::HandleResult(
+    const AnnounceParams& sent,
+    const AnnounceResult& result
+) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Tracker* tracker = FindTracker(result.url);
+    if (!tracker) {
+        return;
+    }
+
+    auto now = Clock::now();
+    if (!result.error.empty()) {
+        auto backoff = kRetryDelay * (1 << std::min(tracker->failures, 6));
+        tracker->next_announce = now + std::min<std::chrono::seconds>(backoff, kMaxRetryDelay);
+        ++tracker->failures;
+        return;
+    }
+
+    tracker->failures = 0;
+    if (sent.event == TrackerEvent::kStarted) {
+        // Starting as a seeder makes a completed event meaningless.
+        tracker->started = true;
+        tracker->completed = sent.left == 0;
+    } else if (sent.event == TrackerEvent::kCompleted) {
+        tracker->completed = true;
+    }
+
+    auto interval = result.interval > std::chrono::seconds(0) ? result.interval : kDefaultInterval;
+    auto min_interval = result.min_interval > std::chrono::seconds(0)
+        ? result.min_interval
+        : std::min(interval, kDefaultMinInterval);
+    tracker->next_announce = now + std::max(interval, min_interval);
+    tracker->earliest_announce = now + min_interval;
+}
+
+AnnounceScheduler::Tracker* AnnounceScheduler::FindTracker(const std::string& url) {
+    auto tracker = std::find_if(trackers.begin(), trackers.end(), [&url](const Tracker& entry) {
+        return entry.url == url;
+    });
+    return tracker == trackers.end() ? nullptr : &*tracker;
+}
@@ -0,0 +1,147 @@
+#include "core/DirectFile.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+DirectFile::DirectFile(const std::string& path, uint64_t size) :
+    fd(-1),
+    size(size),
+    tail_buffer(kAlignment)
+{
+    int flags = O_RDWR | O_CREAT | O_TRUNC;
+#ifdef O_DIRECT
+    flags |= O_DIRECT;
+#endif
+
+    fd = open(path.c_str(), flags, 0644);
+    if (fd < 0) {
+        throw std::runtime_error(
+            "[DirectFile] Failed to open " +
+            path +
+            ": " +
+            strerror(errno)
+        );
+    }
+
+#if !defined(O_DIRECT) && defined(F_NOCACHE)
+    fcntl(fd, F_NOCACHE, 1);
+#endif
+
+    if (ftruncate(fd, size) < 0) {
+        int error = errno;
+        close(fd);
+        throw std::runtime_error(
+            "[DirectFile] Failed to resize " +
+            path +
+            ": " +
+            strerror(error)
+        );
+    }
+}
+
+DirectFile::~DirectFile() {
+    Close();
+}
+
+bool DirectFile::IsAligned(uint64_t value) {
+    return value % kAlignment == 0;
+}
+
+void DirectFile::Write(uint64_t offset, const utils::AlignedBuffer& data) {
+    if (fd < 0) {
+        throw std::runtime_error("[DirectFile] File is closed");
+    }
+
+    if (!IsAligned(offset)) {
+        throw std::invalid_argument("[DirectFile] Unaligned write");
+    }
+
+    size_t tail_length = data.Size() % kAlignment;
+    size_t body_length = data.Size() - tail_length;
+    WriteAll(offset, data.Data(), body_length);
+
+    if (tail_length == 0) {
+        return;
+    }
+
+    std::memcpy(tail_buffer.Data(), data.Data() + body_length, tail_length);
+    std::memset(tail_buffer.Data() + tail_length, 0, kAlignment - tail_length);
+    WriteAll(offset + body_length, tail_buffer.Data(), kAlignment);
+
+    if (offset + body_length + kAlignment > size && ftruncate(fd, size) < 0) {
+        throw std::runtime_error(
+            std::string("[DirectFile] Failed to trim tail: ") + strerror(errno)
+        );
+    }
+}
+
+void DirectFile::WriteAll(uint64_t offset, const char* data, size_t length) {
+    size_t written = 0;
+    while (written < length) {
+        ssize_t code = pwrite(
+            fd,
+            data + written,
+            length - written,
+            offset + written
+        );
+
+        if (code < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error(
+                std::string("[DirectFile] Write error: ") + strerror(errno)
+            );
+        }
+        written += code;
+    }
+}
+
+utils::AlignedBuffer DirectFile::Read(uint64_t offset, size_t length) {
+    if (fd < 0) {
+        throw std::runtime_error("[DirectFile] File is closed");
+    }
+
+    if (!IsAligned(offset)) {
+        throw std::invalid_argument("[DirectFile] Unaligned read");
+    }
+
+    utils::AlignedBuffer data(length);
+    size_t received = 0;
+    while (received < length) {
+        ssize_t code = pread(
+            fd,
+            data.Data() + received,
+            data.Capacity() - received,
+            offset + received
+        );
+
+        if (code < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error(
+                std::string("[DirectFile] Read error: ") + strerror(errno)
+            );
+        }
+
+        if (code == 0) {
+            throw std::runtime_error("[DirectFile] Unexpected end of file");
+        }
+        received += code;
+    }
+
+    return data;
+}
+
+void DirectFile::Close() {
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+        fd = -1;
+    }
+}
@@ -1,56 +1,11 @@
 #include "core/HttpTracker.hpp"
 
-#include <cpr/cpr.h>
+#include <algorithm>
+#include <stdexcept>
 
 #include "core/UdpTracker.hpp"
-#include "utils/BencodeParser.hpp"
-
-HttpTracker::HttpTracker(const std::string& url) : tracker_url(url) {}
-
-void HttpTracker::UpdatePeers(
-    const TorrentFile& torrent_file,
-    const std::string& peer_id,
-    int port
-) {
-    std::vector<std::string> all_trackers = { tracker_url };
-
-    if (IsUdpTracker()) {
-        for (const auto& backup : kBackupUdpTrackers) {
-            if (backup != tracker_url) {
-                all_trackers.push_back(std::string(backup));
-            }
-        }
-    }
-
-    for (size_t i = 0; i < all_trackers.size() && peers.empty(); ++i) {
-        const auto& current_tracker = all_trackers[i];
-
-        try {
-            if (IsUdpTracker(current_tracker)) {
-                UpdatePeersUdp(torrent_file, peer_id, port, current_tracker);
-            } else {
-                UpdatePeersHttp(torrent_file, peer_id, port, current_tracker);
-            }
-
-            if (!peers.empty()) {
-                break;
-            }
-
-        } catch (const std::exception& error) {
-            // ignore tracker errors, try next one
-        }
-    }
 
-    if (peers.empty()) {
-        throw std::runtime_error("All trackers failed - no peers found");
-    }
-}
-
-bool HttpTracker::IsUdpTracker() const {
-    return IsUdpTracker(tracker_url);
-}
-
-bool HttpTracker::IsUdpTracker(const std::string& url) const {
+bool HttpTracker::IsUdpTracker(const std::string& url) {
     return url.substr(0, 6) == "udp://";
 }
 
@@ -66,6 +21,19 @@ std::pair<std::string, int> HttpTracker::ParseUdpUrl(const std::string& url) {
         host_port = host_port.substr(0, slash_pos);
     }
 
+    // IPv6 literals are bracketed: udp://[2001:db8::1]:6969.
+    if (!host_port.empty() && host_port.front() == '[') {
+        size_t bracket_pos = host_port.find(']');
+        if (bracket_pos == std::string::npos) {
+            throw std::runtime_error("Invalid UDP URL: " + url);
+        }
+        std::string host = host_port.substr(1, bracket_pos - 1);
+        if (bracket_pos + 1 < host_port.size() && host_port[bracket_pos + 1] == ':') {
+            return {host, std::stoi(host_port.substr(bracket_pos + 2))};
+        }
+        return {host, 80};
+    }
+
     size_t colon_pos = host_port.find(':');
     if (colon_pos != std::string::npos) {
         std::string host = host_port.substr(0, colon_pos);
@@ -76,181 +44,208 @@ std::pair<std::string, int> HttpTracker::ParseUdpUrl(const std::string& url) {
     }
 }
 
-Peer HttpTracker::ConvertTrackerPeer(const UdpTracker::TrackerPeer& tracker_peer) {
-    Peer peer;
+std::string HttpTracker::ScrapeUrl(const std::string& announce_url) {
+    // The scrape convention: the last path segment starts with "announce"
+    // and the scrape URL swaps that word for "scrape".
+    size_t query = announce_url.find('?');
+    size_t segment = announce_url.rfind('/', query);
+    if (
+        segment == std::string::npos
+        || announce_url.compare(segment + 1, 8, "announce") != 0
+    ) {
+        throw std::runtime_error("Tracker does not support scrape: " + announce_url);
+    }
 
-    peer.ip =
-        std::to_string((tracker_peer.ip >> 24) & 0xFF) +
-        "." +
-        std::to_string((tracker_peer.ip >> 16) & 0xFF) + "." +
-        std::to_string((tracker_peer.ip >> 8) & 0xFF) +
-        "." +
-        std::to_string(tracker_peer.ip & 0xFF);
+    std::string url = announce_url;
+    url.replace(segment + 1, 8, "scrape");
+    return url;
+}
 
-    peer.port = tracker_peer.port;
+void HttpTracker::ResponseReader::OnKey(std::string_view key) {
+    keys.back() = key;
+}
 
-    return peer;
+void HttpTracker::ResponseReader::OnInteger(int64_t) {
+    if (keys.empty()) {
+        throw std::runtime_error("Tracker response is not a dictionary");
+    }
 }
 
-void HttpTracker::UpdatePeersHttp(
-    const TorrentFile& torrent_file,
-    const std::string& peer_id,
-    int port,
-    const std::string& url
-) {
-    cpr::Response tracker_response = cpr::Get(
-        cpr::Url{url},
-        cpr::Parameters{
-            {"info_hash", torrent_file.info_hash},
-            {"peer_id", peer_id},
-            {"port", std::to_string(port)},
-            {"uploaded", "0"},
-            {"downloaded", "0"},
-            {"left", std::to_string(torrent_file.length)},
-            {"compact", "1"}
-        },
-        cpr::Timeout{10000},
-        cpr::ConnectTimeout{5000}
-    );
-
-    if (tracker_response.status_code != 200) {
-        throw std::runtime_error(
-            "HTTP " +
-            std::to_string(tracker_response.status_code) +
-            ": " +
-            tracker_response.error.message
-        );
+void HttpTracker::ResponseReader::OnStringBegin(size_t) {
+    if (keys.empty()) {
+        throw std::runtime_error("Tracker response is not a dictionary");
     }
 
-    ParseTrackerResponse(tracker_response.text, url);
+    if (keys.size() == 1 && keys[0] == "failure reason") {
+        reading_failure = true;
+        failure_reason.emplace();
+    }
 }
 
-void HttpTracker::UpdatePeersUdp(
-    const TorrentFile& torrent_file,
-    const std::string& peer_id,
-    int port,
-    const std::string& url
-) {
-    try {
-        auto [host, tracker_port] = ParseUdpUrl(url);
-
-        UdpTracker udp_tracker(host, tracker_port, 8);
-
-        auto response = udp_tracker.Announce(
-            torrent_file.info_hash,  // info_hash (20 bytes)
-            peer_id,                 // peer_id (20 bytes)
-            0,                       // downloaded
-            torrent_file.length,     // left
-            0,                       // uploaded
-            2,                       // event: 2 = started
-            -1,                      // num_want: -1 = default
-            port                     // port
-        );
+void HttpTracker::ResponseReader::OnStringData(std::string_view fragment) {
+    if (reading_failure) {
+        size_t room = kMaxFailureLength - failure_reason->size();
+        failure_reason->append(fragment.substr(0, room));
+    }
+}
 
-        peers.clear();
-        for (const auto& tracker_peer : response.peers) {
-            peers.push_back(ConvertTrackerPeer(tracker_peer));
-        }
+void HttpTracker::ResponseReader::OnStringEnd() {
+    reading_failure = false;
+}
 
-    } catch (const std::exception& e) {
-        throw;
+void HttpTracker::ResponseReader::OnListBegin() {
+    if (keys.empty()) {
+        throw std::runtime_error("Tracker response is not a dictionary");
     }
+    keys.emplace_back();
 }
 
-void HttpTracker::ParseTrackerResponse(const std::string& response) {
-    ParseTrackerResponse(response, tracker_url);
+void HttpTracker::ResponseReader::OnDictBegin() {
+    keys.emplace_back();
 }
 
-void HttpTracker::ParseTrackerResponse(
-    const std::string& response,
-    const std::string& url
-) {
-    utils::BencodeParser parser;
-    auto parsed = parser.ParseFromString(response);
+void HttpTracker::ResponseReader::OnEnd() {
+    keys.pop_back();
+}
 
-    std::string peers_data;
-    std::string failure_reason;
+void HttpTracker::ResponseReader::CheckFailure() const {
+    if (failure_reason) {
+        throw std::runtime_error("Tracker failure: " + *failure_reason);
+    }
+}
 
-    for (size_t i = 0; i < parsed.size(); ++i) {
-        if (parsed[i] == "peers" && i + 1 < parsed.size()) {
-            peers_data = parsed[i + 1];
-        }
-        if (parsed[i] == "failure reason" && i + 1 < parsed.size()) {
-            failure_reason = parsed[i + 1];
-        }
-        if (parsed[i] == "interval" && i + 1 < parsed.size()) {
-            // do nothing
-        }
+bool HttpTracker::AnnounceReader::InPeerDictionary() const {
+    return keys.size() == 3 && keys[0] == "peers";
+}
+
+void HttpTracker::AnnounceReader::OnInteger(int64_t value) {
+    ResponseReader::OnInteger(value);
+    if (keys.size() == 1 && keys[0] == "interval") {
+        interval = std::max<int64_t>(value, 0);
+    } else if (keys.size() == 1 && keys[0] == "min interval") {
+        min_interval = std::max<int64_t>(value, 0);
+    } else if (InPeerDictionary() && keys[2] == "port") {
+        port = value;
     }
+}
 
-    if (!failure_reason.empty()) {
-        throw std::runtime_error("Tracker failure: " + failure_reason);
+void HttpTracker::AnnounceReader::OnStringBegin(size_t length) {
+    ResponseReader::OnStringBegin(length);
+    if (InPeerDictionary() && keys[2] == "ip") {
+        reading_ip = true;
+        ip.clear();
+        return;
     }
 
-    if (peers_data.empty()) {
+    if (keys.size() != 1 || (keys[0] != "peers" && keys[0] != "peers6")) {
+        return;
+    }
+
+    compact_size = keys[0] == "peers" ? Peer::kCompactIpv4Size : Peer::kCompactIpv6Size;
+    if (length % compact_size != 0) {
         throw std::runtime_error(
-            "No peers data in tracker response from " +
-            url
+            "Malformed compact peer list of " +
+            std::to_string(length) +
+            " bytes"
         );
     }
-
-    ParseCompactPeers(peers_data);
+    peers.reserve(peers.size() + length / compact_size);
+    partial_peer.clear();
 }
 
-void HttpTracker::ParseCompactPeers(const std::string& peers_data) {
-    peers.clear();
+void HttpTracker::AnnounceReader::OnStringData(std::string_view fragment) {
+    ResponseReader::OnStringData(fragment);
+    if (reading_ip) {
+        ip.append(fragment.substr(0, kMaxIpLength - std::min(ip.size(), kMaxIpLength)));
+        return;
+    }
 
-    if (peers_data.size() % 6 == 0 && !peers_data.empty()) {
-        ParseCompactBinaryPeers(peers_data);
-    } else {
-        ParseDictionaryPeers(peers_data);
+    if (compact_size == 0) {
+        return;
     }
-}
 
-void HttpTracker::ParseCompactBinaryPeers(const std::string& peers_data) {
-    static constexpr size_t kPeerSize = 6;
-    const size_t peer_count = peers_data.size() / kPeerSize;
-    peers.reserve(peer_count);
-
-    for (size_t i = 0; i < peers_data.size(); i += kPeerSize) {
-        std::string ip =
-            std::to_string(static_cast<uint8_t>(peers_data[i])) +
-            "." +
-            std::to_string(static_cast<uint8_t>(peers_data[i + 1])) +
-            "." +
-            std::to_string(static_cast<uint8_t>(peers_data[i + 2])) +
-            "." +
-            std::to_string(static_cast<uint8_t>(peers_data[i + 3]));
-
-        int port = (
-            static_cast<uint8_t>(peers_data[i + 4]) << 8) |
-            static_cast<uint8_t>(peers_data[i + 5]
-        );
+    // A peer may be split across fragments.
+    if (!partial_peer.empty()) {
+        size_t needed = compact_size - partial_peer.size();
+        partial_peer.append(fragment.substr(0, needed));
+        fragment.remove_prefix(std::min(needed, fragment.size()));
+        if (partial_peer.size() < compact_size) {
+            return;
+        }
+        peers.push_back(Peer::FromCompact(partial_peer));
+        partial_peer.clear();
+    }
 
-        peers.emplace_back(Peer{ip, port});
+    while (fragment.size() >= compact_size) {
+        peers.push_back(Peer::FromCompact(fragment.substr(0, compact_size)));
+        fragment.remove_prefix(compact_size);
     }
+    partial_peer.assign(fragment);
 }
 
-void HttpTracker::ParseDictionaryPeers(const std::string& peers_data) {
-    static_cast<void>(peers_data);
-    throw std::runtime_error(
-        "Non-compact peer format not supported. Use compact=1 in tracker request."
-    );
+void HttpTracker::AnnounceReader::OnStringEnd() {
+    ResponseReader::OnStringEnd();
+    compact_size = 0;
+    reading_ip = false;
 }
 
-const std::vector<Peer>& HttpTracker::GetPeers() const {
-    return peers;
+void HttpTracker::AnnounceReader::OnDictBegin() {
+    ResponseReader::OnDictBegin();
+    if (InPeerDictionary()) {
+        ip.clear();
+        port = -1;
+    }
 }
 
-std::string HttpTracker::GetTrackerUrl() const {
-    return tracker_url;
+void HttpTracker::AnnounceReader::OnEnd() {
+    // Host names are skipped, peers are dialed by address.
+    if (InPeerDictionary() && !ip.empty() && 0 <= port && port <= 65535) {
+        try {
+            peers.push_back(Peer::FromString(ip, static_cast<uint16_t>(port)));
+        } catch (const std::exception&) {
+        }
+    }
+    ResponseReader::OnEnd();
 }
 
-bool HttpTracker::IsWorking() const {
-    return !peers.empty();
+HttpTracker::ScrapeReader::ScrapeReader(std::vector<std::string> info_hashes) :
+    info_hashes(std::move(info_hashes)),
+    stats(this->info_hashes.size())
+{}
+
+void HttpTracker::ScrapeReader::OnDictBegin() {
+    ResponseReader::OnDictBegin();
+    if (keys.size() == 2 && keys[0] == "files") {
+        has_files = true;
+    }
 }
 
-void HttpTracker::PrintStats() const {
+void HttpTracker::ScrapeReader::OnInteger(int64_t value) {
+    ResponseReader::OnInteger(value);
+    if (keys.size() != 3 || keys[0] != "files") {
+        return;
+    }
+
+    value = std::max<int64_t>(value, 0);
+    for (size_t i = 0; i < info_hashes.size(); ++i) {
+        if (info_hashes[i] != keys[1]) {
+            continue;
+        }
 
+        if (keys[2] == "complete") {
+            stats[i].seeders = value;
+        } else if (keys[2] == "downloaded") {
+            stats[i].completed = value;
+        } else if (keys[2] == "incomplete") {
+            stats[i].leechers = value;
+        }
+    }
 }
 
+std::vector<UdpTracker::ScrapeStats> HttpTracker::ScrapeReader::GetStats() const {
+    CheckFailure();
+    if (!has_files) {
+        throw std::runtime_error("Scrape response has no files dictionary");
+    }
+    return stats;
+}
@@ -0,0 +1,657 @@
+#include "core/LocalTracker.hpp"
+
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+
+#include "utils/BencodeWriter.hpp"
+#include "utils/byte_tools.hpp"
+
+namespace {
+
+constexpr uint64_t kUdpProtocolId = 0x41727101980;
+constexpr size_t kInfoHashSize = 20;
+constexpr size_t kMaxNumWant = 200;
+
+enum UdpAction : int32_t {
+    kConnect = 0,
+    kAnnounce = 1,
+    kScrape = 2,
+    kError = 3,
+};
+
+std::optional<uint64_t> ParseNumber(std::string_view text) {
+    uint64_t value = 0;
+    auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (error != std::errc() || end != text.data() + text.size()) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+bool IEquals(std::string_view a, std::string_view b) {
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+        return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+    });
+}
+
+std::string HttpMessage(int status, std::string_view reason, const std::string& body, bool close) {
+    std::string message = "HTTP/1.1 " + std::to_string(status) + " " + std::string(reason) + "\r\n";
+    message += "Content-Type: text/plain\r\n";
+    message += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+    if (close) {
+        message += "Connection: close\r\n";
+    }
+    message += "\r\n";
+    message += body;
+    return message;
+}
+
+std::string FailureResponse(std::string_view reason) {
+    std::string body;
+    utils::BencodeWriter(body).BeginDict().Key("failure reason").String(reason).End();
+    return body;
+}
+
+std::string UdpError(std::string_view transaction_id, std::string_view message) {
+    return utils::Int32ToBytes(kError) + std::string(transaction_id) + std::string(message);
+}
+
+std::string UrlHost(const std::string& address) {
+    return address.find(':') == std::string::npos ? address : "[" + address + "]";
+}
+
+} // namespace
+
+LocalTracker::LocalTracker(const LocalTrackerOptions& options) :
+    options(options),
+    random(std::random_device{}())
+{
+    connection_secret = random();
+    try {
+        wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (wake_fd < 0) {
+            throw std::runtime_error(
+                "Failed to create eventfd: " + std::string(strerror(errno))
+            );
+        }
+        http_fd = Listen(SOCK_STREAM, options.http_port, http_port);
+        udp_fd = Listen(SOCK_DGRAM, options.udp_port, udp_port);
+    } catch (...) {
+        CloseSockets();
+        throw;
+    }
+
+    worker = std::thread(&LocalTracker::Run, this);
+}
+
+LocalTracker::~LocalTracker() {
+    uint64_t one = 1;
+    [[maybe_unused]] auto written = write(wake_fd, &one, sizeof(one));
+    worker.join();
+
+    for (const auto& [fd, connection] : http_connections) {
+        close(fd);
+    }
+    CloseSockets();
+}
+
+std::string LocalTracker::HttpAnnounceUrl() const {
+    return "http://" + UrlHost(options.bind_address) + ":" + std::to_string(http_port) + "/announce";
+}
+
+std::string LocalTracker::UdpAnnounceUrl() const {
+    return "udp://" + UrlHost(options.bind_address) + ":" + std::to_string(udp_port) + "/announce";
+}
+
+void LocalTracker::SetPeers(const std::string& info_hash, std::vector<Peer> peers) {
+    std::lock_guard<std::mutex> lock(mutex);
+    swarms[info_hash].configured = std::move(peers);
+}
+
+LocalTrackerStats LocalTracker::Stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+int LocalTracker::Listen(int type, uint16_t port, uint16_t& bound_port) const {
+    sockaddr_storage address{};
+    socklen_t length = Peer::FromString(options.bind_address, port).ToSockaddr(address);
+
+    int fd = socket(address.ss_family, type | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to create tracker socket: " + std::string(strerror(errno)));
+    }
+
+    int enable = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    if (
+        bind(fd, reinterpret_cast<sockaddr*>(&address), length) < 0
+        || (type == SOCK_STREAM && listen(fd, SOMAXCONN) < 0)
+        || getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length) < 0
+    ) {
+        std::string error = strerror(errno);
+        close(fd);
+        throw std::runtime_error(
+            "Failed to bind tracker to " + options.bind_address + ":" + std::to_string(port) + ": " + error
+        );
+    }
+
+    bound_port = Peer::FromSockaddr(address).port;
+    return fd;
+}
+
+void LocalTracker::CloseSockets() {
+    for (int fd : { http_fd, udp_fd, wake_fd }) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+void LocalTracker::Run() {
+    std::vector<pollfd> fds;
+    while (true) {
+        fds.assign({
+            { wake_fd, POLLIN, 0 },
+            { http_fd, POLLIN, 0 },
+            { udp_fd, POLLIN, 0 },
+        });
+        for (const auto& [fd, connection] : http_connections) {
+            short events = POLLIN;
+            if (!connection.output.empty()) {
+                events |= POLLOUT;
+            }
+            fds.push_back({ fd, events, 0 });
+        }
+
+        int wait_ms = -1;
+        if (!timers.empty()) {
+            auto wait = std::chrono::ceil<std::chrono::milliseconds>(timers.begin()->first - Clock::now());
+            wait_ms = static_cast<int>(std::max<int64_t>(wait.count(), 0));
+        }
+        if (poll(fds.data(), fds.size(), wait_ms) < 0 && errno != EINTR) {
+            return;
+        }
+
+        if (fds[0].revents) {
+            return;
+        }
+        if (fds[1].revents & POLLIN) {
+            AcceptHttp();
+        }
+        if (fds[2].revents & POLLIN) {
+            ReadUdp();
+        }
+        for (size_t i = 3; i < fds.size(); ++i) {
+            if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                ReadHttp(fds[i].fd);
+            }
+            if ((fds[i].revents & POLLOUT) && http_connections.contains(fds[i].fd)) {
+                WriteHttp(fds[i].fd);
+            }
+        }
+        RunTimers();
+    }
+}
+
+void LocalTracker::Delay(std::function<void()> action) {
+    if (options.latency <= std::chrono::milliseconds(0)) {
+        action();
+        return;
+    }
+    timers.emplace(Clock::now() + options.latency, std::move(action));
+}
+
+void LocalTracker::RunTimers() {
+    auto now = Clock::now();
+    while (!timers.empty() && timers.begin()->first <= now) {
+        auto action = std::move(timers.begin()->second);
+        timers.erase(timers.begin());
+        action();
+    }
+}
+
+void LocalTracker::AcceptHttp() {
+    while (true) {
+        sockaddr_storage address{};
+        socklen_t length = sizeof(address);
+        int fd = accept4(http_fd, reinterpret_cast<sockaddr*>(&address), &length, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+
+        // Keep-alive answers are small, Nagle would hold each one back.
+        int enable = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+        HttpConnection connection;
+        connection.serial = next_serial++;
+        connection.client = Peer::FromSockaddr(address);
+        http_connections[fd] = std::move(connection);
+    }
+}
+
+void LocalTracker::ReadHttp(int fd) {
+    auto found = http_connections.find(fd);
+    if (found == http_connections.end()) {
+        return;
+    }
+    auto& connection = found->second;
+
+    char buffer[4096];
+    while (true) {
+        ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+        if (received > 0) {
+            connection.input.append(buffer, received);
+            continue;
+        }
+        if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        CloseHttp(fd);
+        return;
+    }
+
+    HandleHttpRequests(fd, connection);
+    if (connection.input.size() > kMaxRequestSize) {
+        CloseHttp(fd);
+        return;
+    }
+    WriteHttp(fd);
+}
+
+void LocalTracker::WriteHttp(int fd) {
+    auto& connection = http_connections.at(fd);
+    while (!connection.output.empty()) {
+        ssize_t sent = send(fd, connection.output.data(), connection.output.size(), MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return;
+            }
+            CloseHttp(fd);
+            return;
+        }
+        connection.output.erase(0, sent);
+    }
+
+    if (connection.close_when_done && connection.pending == 0) {
+        CloseHttp(fd);
+    }
+}
+
+void LocalTracker::CloseHttp(int fd) {
+    close(fd);
+    http_connections.erase(fd);
+}
+
+void LocalTracker::HandleHttpRequests(int fd, HttpConnection& connection) {
+    // Requests are GETs without a body, pipelined ones are answered in order.
+    while (!connection.close_when_done) {
+        size_t head_end = connection.input.find("\r\n\r\n");
+        if (head_end == std::string::npos) {
+            return;
+        }
+        std::string head = connection.input.substr(0, head_end);
+        connection.input.erase(0, head_end + 4);
+
+        std::string_view lines(head);
+        std::string_view request_line = lines.substr(0, lines.find("\r\n"));
+        size_t target_start = request_line.find(' ');
+        size_t target_end = request_line.rfind(' ');
+        if (target_start == std::string_view::npos || target_end <= target_start) {
+            connection.close_when_done = true;
+            connection.output += HttpMessage(400, "Bad Request", "", true);
+            return;
+        }
+        std::string_view method = request_line.substr(0, target_start);
+        std::string_view target = request_line.substr(target_start + 1, target_end - target_start - 1);
+        std::string_view version = request_line.substr(target_end + 1);
+
+        bool keep_alive = version == "HTTP/1.1";
+        size_t line_start = request_line.size();
+        while (line_start < lines.size()) {
+            line_start += 2;
+            size_t line_end = std::min(lines.find("\r\n", line_start), lines.size());
+            std::string_view line = lines.substr(line_start, line_end - line_start);
+            line_start = line_end;
+
+            size_t colon = line.find(':');
+            if (colon == std::string_view::npos || !IEquals(line.substr(0, colon), "connection")) {
+                continue;
+            }
+            std::string_view value = line.substr(colon + 1);
+            value.remove_prefix(std::min(value.find_first_not_of(' '), value.size()));
+            keep_alive = IEquals(value, "keep-alive") || (keep_alive && !IEquals(value, "close"));
+        }
+        connection.close_when_done = !keep_alive;
+
+        std::string_view path = target.substr(0, target.find('?'));
+        Query query;
+        if (path.size() < target.size()) {
+            std::string_view rest = target.substr(path.size() + 1);
+            while (!rest.empty()) {
+                std::string_view pair = rest.substr(0, rest.find('&'));
+                rest.remove_prefix(std::min(pair.size() + 1, rest.size()));
+                size_t equals = pair.find('=');
+                query.emplace(
+                    utils::PercentDecode(pair.substr(0, equals)),
+                    equals == std::string_view::npos ? "" : utils::PercentDecode(pair.substr(equals + 1))
+                );
+            }
+        }
+
+        std::string message;
+        if (method != "GET") {
+            message = HttpMessage(405, "Method Not Allowed", "", !keep_alive);
+        } else if (path == "/announce") {
+            message = HttpMessage(200, "OK", HttpAnnounce(query, connection.client), !keep_alive);
+        } else if (path == "/scrape") {
+            message = HttpMessage(200, "OK", HttpScrape(query), !keep_alive);
+        } else {
+            message = HttpMessage(404, "Not Found", "", !keep_alive);
+        }
+
+        ++connection.pending;
+        Delay([this, fd, serial = connection.serial, message = std::move(message)] {
+            auto found = http_connections.find(fd);
+            if (found == http_connections.end() || found->second.serial != serial) {
+                return;
+            }
+            --found->second.pending;
+            found->second.output += message;
+            if (options.latency > std::chrono::milliseconds(0)) {
+                WriteHttp(fd);
+            }
+        });
+    }
+}
+
+std::string LocalTracker::HttpAnnounce(const Query& query, const Peer& client) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++stats.http_announces;
+    }
+
+    auto value = [&query](const std::string& key) -> std::optional<std::string> {
+        auto found = query.find(key);
+        return found == query.end() ? std::nullopt : std::optional(found->second);
+    };
+
+    auto info_hash = value("info_hash");
+    if (!info_hash || info_hash->size() != kInfoHashSize) {
+        return FailureResponse("Invalid info_hash");
+    }
+    auto port = ParseNumber(value("port").value_or(""));
+    if (!port || *port > UINT16_MAX) {
+        return FailureResponse("Invalid port");
+    }
+
+    Announce announce;
+    announce.info_hash = *info_hash;
+    announce.peer = client;
+    announce.peer.port = static_cast<uint16_t>(*port);
+    announce.left = ParseNumber(value("left").value_or("")).value_or(0);
+
+    auto event = value("event").value_or("");
+    announce.event = event == "completed" ? 1 : event == "started" ? 2 : event == "stopped" ? 3 : 0;
+
+    auto num_want = ParseNumber(value("numwant").value_or(""));
+    announce.num_want = num_want ? std::min<size_t>(*num_want, kMaxNumWant) : options.default_num_want;
+
+    AnnounceReply reply = HandleAnnounce(announce, AF_UNSPEC);
+
+    std::string peers;
+    std::string peers6;
+    for (const auto& peer : reply.peers) {
+        (peer.IsIpv6() ? peers6 : peers) += peer.ToCompact();
+    }
+
+    std::string body;
+    utils::BencodeWriter writer(body);
+    writer.BeginDict()
+        .Key("complete").Integer(reply.seeders)
+        .Key("incomplete").Integer(reply.leechers)
+        .Key("interval").Integer(options.interval);
+    if (options.min_interval > 0) {
+        writer.Key("min interval").Integer(options.min_interval);
+    }
+    writer.Key("peers").String(peers);
+    if (!peers6.empty()) {
+        writer.Key("peers6").String(peers6);
+    }
+    writer.End();
+    return body;
+}
+
+std::string LocalTracker::HttpScrape(const Query& query) {
+    std::vector<std::string> info_hashes;
+    auto [begin, end] = query.equal_range("info_hash");
+    for (auto entry = begin; entry != end; ++entry) {
+        if (entry->second.size() == kInfoHashSize) {
+            info_hashes.push_back(entry->second);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++stats.http_scrapes;
+        // A scrape without hashes asks for every torrent.
+        if (begin == end) {
+            for (const auto& [info_hash, swarm] : swarms) {
+                info_hashes.push_back(info_hash);
+            }
+        }
+    }
+
+    // Dictionary keys must be sorted.
+    std::sort(info_hashes.begin(), info_hashes.end());
+    info_hashes.erase(std::unique(info_hashes.begin(), info_hashes.end()), info_hashes.end());
+
+    std::string body;
+    utils::BencodeWriter writer(body);
+    writer.BeginDict().Key("files").BeginDict();
+    for (const auto& info_hash : info_hashes) {
+        auto swarm = SwarmStats(info_hash);
+        writer.Key(info_hash).BeginDict()
+            .Key("complete").Integer(swarm.seeders)
+            .Key("downloaded").Integer(swarm.completed)
+            .Key("incomplete").Integer(swarm.leechers)
+            .End();
+    }
+    writer.End().End();
+    return body;
+}
+
+void LocalTracker::ReadUdp() {
+    char buffer[kMaxDatagramSize];
+    while (true) {
+        sockaddr_storage from{};
+        socklen_t from_length = sizeof(from);
+        ssize_t received = recvfrom(
+            udp_fd,
+            buffer,
+            sizeof(buffer),
+            0,
+            reinterpret_cast<sockaddr*>(&from),
+            &from_length
+        );
+        if (received < 0) {
+            return;
+        }
+
+        if (
+            options.loss_rate > 0.0
+            && std::uniform_real_distribution<double>(0.0, 1.0)(random) < options.loss_rate
+        ) {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++stats.udp_dropped;
+            continue;
+        }
+
+        std::string response = UdpResponse(std::string_view(buffer, received), from);
+        if (response.empty()) {
+            continue;
+        }
+        Delay([this, response = std::move(response), from, from_length] {
+            sendto(udp_fd, response.data(), response.size(), 0, reinterpret_cast<const sockaddr*>(&from), from_length);
+        });
+    }
+}
+
+std::string LocalTracker::UdpResponse(std::string_view packet, const sockaddr_storage& from) {
+    if (packet.size() < 16) {
+        return "";
+    }
+    uint64_t connection_id = utils::BytesToInt64(packet.substr(0, 8));
+    int32_t action = utils::BytesToInt32(packet.substr(8, 4));
+    std::string_view transaction_id = packet.substr(12, 4);
+
+    int64_t epoch = Clock::now().time_since_epoch() / kConnectionIdLifetime;
+    if (action == kConnect) {
+        if (connection_id != kUdpProtocolId) {
+            return "";
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++stats.udp_connects;
+        }
+        return utils::Int32ToBytes(kConnect) + std::string(transaction_id)
+            + utils::Int64ToBytes(ConnectionId(from, epoch));
+    }
+
+    // Ids from the previous period stay valid, so one is good for at least
+    // kConnectionIdLifetime.
+    if (connection_id != ConnectionId(from, epoch) && connection_id != ConnectionId(from, epoch - 1)) {
+        return UdpError(transaction_id, "Connection ID mismatch");
+    }
+
+    Peer client = Peer::FromSockaddr(from);
+    if (action == kAnnounce) {
+        if (packet.size() < 98) {
+            return UdpError(transaction_id, "Malformed announce");
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++stats.udp_announces;
+        }
+
+        Announce announce;
+        announce.info_hash = std::string(packet.substr(16, kInfoHashSize));
+        announce.left = utils::BytesToInt64(packet.substr(64, 8));
+        announce.event = utils::BytesToInt32(packet.substr(80, 4));
+        int32_t num_want = utils::BytesToInt32(packet.substr(92, 4));
+        announce.num_want = num_want < 0
+            ? options.default_num_want
+            : std::min<size_t>(num_want, kMaxNumWant);
+        announce.peer = client;
+        announce.peer.port = static_cast<uint16_t>(
+            (static_cast<uint8_t>(packet[96]) << 8) | static_cast<uint8_t>(packet[97])
+        );
+
+        // Peers come in the format of the family the request arrived over.
+        AnnounceReply reply = HandleAnnounce(announce, client.family);
+        std::string response = utils::Int32ToBytes(kAnnounce) + std::string(transaction_id)
+            + utils::Int32ToBytes(options.interval)
+            + utils::Int32ToBytes(reply.leechers)
+            + utils::Int32ToBytes(reply.seeders);
+        for (const auto& peer : reply.peers) {
+            response += peer.ToCompact();
+        }
+        return response;
+    }
+
+    if (action == kScrape) {
+        size_t hash_count = (packet.size() - 16) / kInfoHashSize;
+        if (hash_count == 0 || hash_count > UdpTracker::kMaxScrapeHashes) {
+            return UdpError(transaction_id, "Malformed scrape");
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++stats.udp_scrapes;
+        }
+
+        std::string response = utils::Int32ToBytes(kScrape) + std::string(transaction_id);
+        for (size_t i = 0; i < hash_count; ++i) {
+            auto swarm = SwarmStats(std::string(packet.substr(16 + i * kInfoHashSize, kInfoHashSize)));
+            response += utils::Int32ToBytes(swarm.seeders);
+            response += utils::Int32ToBytes(swarm.completed);
+            response += utils::Int32ToBytes(swarm.leechers);
+        }
+        return response;
+    }
+
+    return UdpError(transaction_id, "Unknown action");
+}
+
+uint64_t LocalTracker::ConnectionId(const sockaddr_storage& from, int64_t epoch) const {
+    Peer client = Peer::FromSockaddr(from);
+    std::string key(reinterpret_cast<const char*>(client.address.data()), client.address.size());
+    key += utils::Int64ToBytes(connection_secret);
+    key += utils::Int64ToBytes(static_cast<uint64_t>(epoch));
+    key += utils::Int32ToBytes(client.port);
+    return utils::BytesToInt64(utils::CalculateSha1(key).substr(0, 8));
+}
+
+LocalTracker::AnnounceReply LocalTracker::HandleAnnounce(const Announce& announce, int family) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& swarm = swarms[announce.info_hash];
+
+    if (options.track_announcers) {
+        if (announce.event == 3) {
+            swarm.announcers.erase(announce.peer);
+        } else {
+            swarm.announcers[announce.peer] = announce.left == 0;
+        }
+        if (announce.event == 1) {
+            ++swarm.completed;
+        }
+    }
+
+    AnnounceReply reply;
+    auto offer = [&](const Peer& peer) {
+        bool matches = family == AF_UNSPEC || peer.family == family;
+        if (matches && reply.peers.size() < announce.num_want && !(peer == announce.peer)) {
+            reply.peers.push_back(peer);
+        }
+    };
+
+    for (const auto& peer : options.peers) {
+        offer(peer);
+    }
+    for (const auto& peer : swarm.configured) {
+        offer(peer);
+    }
+    reply.seeders = static_cast<uint32_t>(options.peers.size() + swarm.configured.size());
+    for (const auto& [peer, seeding] : swarm.announcers) {
+        offer(peer);
+        ++(seeding ? reply.seeders : reply.leechers);
+    }
+    return reply;
+}
+
+UdpTracker::ScrapeStats LocalTracker::SwarmStats(const std::string& info_hash) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    UdpTracker::ScrapeStats result;
+    result.seeders = static_cast<uint32_t>(options.peers.size());
+
+    auto swarm = swarms.find(info_hash);
+    if (swarm == swarms.end()) {
+        return result;
+    }
+    result.seeders += static_cast<uint32_t>(swarm->second.configured.size());
+    result.completed = swarm->second.completed;
+    for (const auto& [peer, seeding] : swarm->second.announcers) {
+        ++(seeding ? result.seeders : result.leechers);
+    }
+    return result;
+}
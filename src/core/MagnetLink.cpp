@@ -0,0 +1,130 @@
+#include "core/MagnetLink.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+
+#include "utils/byte_tools.hpp"
+
+namespace {
+
+constexpr std::string_view kScheme = "magnet:?";
+constexpr std::string_view kBtihPrefix = "urn:btih:";
+
+int HexValue(char ch) {
+    if (ch >= '0' && ch <= '9') {
+        return ch - '0';
+    }
+    if (ch >= 'a' && ch <= 'f') {
+        return ch - 'a' + 10;
+    }
+    if (ch >= 'A' && ch <= 'F') {
+        return ch - 'A' + 10;
+    }
+    return -1;
+}
+
+std::string DecodeHexHash(std::string_view hex) {
+    std::string result(hex.size() / 2, '\0');
+    for (size_t i = 0; i < result.size(); ++i) {
+        int high = HexValue(hex[2 * i]);
+        int low = HexValue(hex[2 * i + 1]);
+        if (high < 0 || low < 0) {
+            throw std::runtime_error("Invalid hex info-hash in magnet link");
+        }
+        result[i] = static_cast<char>(high << 4 | low);
+    }
+    return result;
+}
+
+// RFC 4648 base32, the older 32-character btih form.
+std::string DecodeBase32Hash(std::string_view base32) {
+    std::string result;
+    uint32_t buffer = 0;
+    int bits = 0;
+    for (char ch : base32) {
+        int value;
+        if (ch >= 'A' && ch <= 'Z') {
+            value = ch - 'A';
+        } else if (ch >= 'a' && ch <= 'z') {
+            value = ch - 'a';
+        } else if (ch >= '2' && ch <= '7') {
+            value = ch - '2' + 26;
+        } else {
+            throw std::runtime_error("Invalid base32 info-hash in magnet link");
+        }
+
+        buffer = (buffer << 5) | value;
+        bits += 5;
+        if (bits >= 8) {
+            bits -= 8;
+            result += static_cast<char>((buffer >> bits) & 0xFF);
+        }
+    }
+    return result;
+}
+
+std::string DecodeInfoHash(std::string_view topic) {
+    if (topic.size() == 40) {
+        return DecodeHexHash(topic);
+    }
+    if (topic.size() == 32) {
+        return DecodeBase32Hash(topic);
+    }
+    throw std::runtime_error("Unsupported info-hash length in magnet link");
+}
+
+} // namespace
+
+bool IsMagnetLink(const std::string& source) {
+    return source.starts_with(kScheme);
+}
+
+MagnetLink ParseMagnetLink(const std::string& uri) {
+    if (!IsMagnetLink(uri)) {
+        throw std::runtime_error("Not a magnet link: " + uri);
+    }
+
+    MagnetLink result;
+    std::string_view query = std::string_view(uri).substr(kScheme.size());
+
+    while (!query.empty()) {
+        auto separator = query.find('&');
+        auto parameter = query.substr(0, separator);
+        query = separator == std::string_view::npos
+            ? std::string_view()
+            : query.substr(separator + 1);
+
+        auto equals = parameter.find('=');
+        if (equals == std::string_view::npos) {
+            continue;
+        }
+        auto key = parameter.substr(0, equals);
+        auto value = utils::PercentDecode(parameter.substr(equals + 1));
+
+        if (key == "xt" && value.starts_with(kBtihPrefix)) {
+            result.info_hash = DecodeInfoHash(
+                std::string_view(value).substr(kBtihPrefix.size())
+            );
+        } else if (key == "dn") {
+            result.name = value;
+        } else if (key == "tr" || key.starts_with("tr.")) {
+            if (
+                std::find(result.trackers.begin(), result.trackers.end(), value)
+                == result.trackers.end()
+            ) {
+                result.trackers.push_back(value);
+            }
+        } else if (key == "xl") {
+            std::from_chars(value.data(), value.data() + value.size(), result.length);
+        }
+    }
+
+    if (result.info_hash.size() != 20) {
+        throw std::runtime_error("Magnet link has no BitTorrent info-hash");
+    }
+
+    return result;
+}
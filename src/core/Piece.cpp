@@ -1,10 +1,11 @@
 #include "core/Piece.hpp"
 
 #include <algorithm>
+#include <cstring>
 
-#include "utils/byte_tools.hpp"
+#include "utils/Sha1Hasher.hpp"
 
-Piece::Piece(size_t index, size_t length, const std::string& hash) :
+Piece::Piece(size_t index, size_t length, const utils::Sha1Digest& hash) :
     index(index),
     length(length),
     hash(hash),
@@ -28,11 +29,7 @@ bool Piece::HashMatches() const {
         return false;
     }
 
-    std::string piece_data = GetData();
-    std::string calculated_hash = utils::CalculateSha1(piece_data);
-    bool matches = (calculated_hash == hash);
-
-    return matches;
+    return GetDataHash() == hash;
 }
 
 Block* Piece::GetFirstMissingBlock() {
@@ -49,21 +46,45 @@ size_t Piece::GetIndex() const {
     return index;
 }
 
-void Piece::SaveBlock(size_t block_offset, std::string block_data) {
+bool Piece::SaveBlock(size_t block_offset, std::string block_data) {
     for (auto& block : blocks) {
         if (block.offset == block_offset) {
-            if (block.status != Block::Status::kPending) {
+            // CopyData and CopyDataAndHash rely on every block being full.
+            if (block_data.size() != block.length) {
                 throw std::runtime_error(
                     "Block at offset " +
                     std::to_string(block_offset) +
-                    " is not in pending state"
+                    " has " +
+                    std::to_string(block_data.size()) +
+                    " bytes, expected " +
+                    std::to_string(block.length)
                 );
             }
 
+            // Late duplicates are expected: a request may still be
+            // outstanding when its piece is released and handed out
+            // again. Keep the first copy and do not count the bytes twice.
+            if (block.status == Block::Status::kRetrieved) {
+                return true;
+            }
+
             block.data = std::move(block_data);
+            if (HasMerkleRoot()) {
+                size_t leaf_index = block.offset / Block::kSize;
+                utils::Sha256Digest leaf{};
+                if (!BlockMatchesLeaf(block, leaf)) {
+                    block.data.clear();
+                    block.status = Block::Status::kMissing;
+                    return false;
+                }
+                if (leaf_index < block_hashes.size()) {
+                    block_hashes[leaf_index] = leaf;
+                }
+            }
+
             block.status = Block::Status::kRetrieved;
             bytes_downloaded += block.data.size();
-            return;
+            return true;
         }
     }
 
@@ -95,14 +116,143 @@ std::string Piece::GetData() const {
     return result;
 }
 
-std::string Piece::GetDataHash() const {
-    return utils::CalculateSha1(GetData());
+utils::Sha1Digest Piece::GetDataHash() const {
+    utils::Sha1Hasher hasher;
+    std::string zeros;
+
+    for (const auto& block : blocks) {
+        if (block.status == Block::Status::kRetrieved) {
+            hasher.Update(block.data);
+        } else {
+            zeros.assign(block.length, '\0');
+            hasher.Update(zeros);
+        }
+    }
+
+    return hasher.Finish();
 }
 
-std::string Piece::GetHash() const {
+utils::Sha1Digest Piece::CopyDataAndHash(char* destination) const {
+    utils::Sha1Hasher hasher;
+
+    for (const auto& block : blocks) {
+        char* block_destination = destination + block.offset;
+        if (block.status == Block::Status::kRetrieved) {
+            std::memcpy(block_destination, block.data.data(), block.length);
+        } else {
+            std::memset(block_destination, 0, block.length);
+        }
+        hasher.Update(std::string_view(block_destination, block.length));
+    }
+
+    return hasher.Finish();
+}
+
+const utils::Sha1Digest& Piece::GetHash() const {
     return hash;
 }
 
+void Piece::CopyData(char* destination) const {
+    for (const auto& block : blocks) {
+        char* block_destination = destination + block.offset;
+        if (block.status == Block::Status::kRetrieved) {
+            std::memcpy(block_destination, block.data.data(), block.length);
+        } else {
+            std::memset(block_destination, 0, block.length);
+        }
+    }
+}
+
+void Piece::SetMerkleRoot(
+    const utils::Sha256Digest& root,
+    size_t leaf_count,
+    size_t data_length
+) {
+    merkle_root = root;
+    merkle_leaf_count = leaf_count;
+    merkle_data_length = data_length;
+    block_hashes.assign(DataLeafCount(), utils::Sha256Digest{});
+    expected_block_hashes.clear();
+
+    // A single-leaf tree is its own leaf hash.
+    if (leaf_count == 1) {
+        expected_block_hashes.push_back(root);
+    }
+}
+
+bool Piece::HasMerkleRoot() const {
+    return merkle_leaf_count > 0;
+}
+
+bool Piece::HasBlockHashes() const {
+    return !expected_block_hashes.empty();
+}
+
+size_t Piece::DataLeafCount() const {
+    return (merkle_data_length + Block::kSize - 1) / Block::kSize;
+}
+
+// Hashes the part of the block covered by the merkle tree. Bytes past the
+// file end belong to a v1 pad file and have to be zero.
+bool Piece::BlockMatchesLeaf(const Block& block, utils::Sha256Digest& leaf) const {
+    if (block.data.size() != block.length) {
+        return false;
+    }
+
+    size_t covered = block.offset < merkle_data_length
+        ? std::min(block.length, merkle_data_length - block.offset)
+        : 0;
+    bool padding_is_zero = std::all_of(
+        block.data.begin() + covered,
+        block.data.end(),
+        [](char ch) { return ch == 0; }
+    );
+    if (!padding_is_zero) {
+        return false;
+    }
+    if (covered == 0) {
+        return true;
+    }
+
+    leaf = utils::Sha256(std::string_view(block.data).substr(0, covered));
+    size_t leaf_index = block.offset / Block::kSize;
+    return !HasBlockHashes() || expected_block_hashes[leaf_index] == leaf;
+}
+
+bool Piece::MerkleRootMatches() const {
+    if (!HasMerkleRoot() || !AllBlocksRetrieved()) {
+        return false;
+    }
+    return utils::MerkleRoot(block_hashes, merkle_leaf_count) == merkle_root;
+}
+
+bool Piece::SetBlockHashes(std::vector<utils::Sha256Digest> leaves) {
+    if (
+        !HasMerkleRoot()
+        || leaves.size() != merkle_leaf_count
+        || utils::MerkleRoot(leaves, merkle_leaf_count) != merkle_root
+    ) {
+        return false;
+    }
+
+    leaves.resize(DataLeafCount());
+    expected_block_hashes = std::move(leaves);
+
+    for (auto& block : blocks) {
+        size_t leaf_index = block.offset / Block::kSize;
+        if (
+            block.status == Block::Status::kRetrieved
+            && leaf_index < block_hashes.size()
+            && block_hashes[leaf_index] != expected_block_hashes[leaf_index]
+        ) {
+            bytes_downloaded -= block.data.size();
+            block.data.clear();
+            block.status = Block::Status::kMissing;
+        }
+    }
+    return true;
+}
+
 void Piece::Reset() {
     bytes_downloaded = 0;
     for (auto& block : blocks) {
@@ -111,6 +261,14 @@ void Piece::Reset() {
     }
 }
 
+void Piece::ResetPendingBlocks() {
+    for (auto& block : blocks) {
+        if (block.status == Block::Status::kPending) {
+            block.status = Block::Status::kMissing;
+        }
+    }
+}
+
 bool Piece::IsDownloading() const {
     auto is_downloading = [](const Block& block) {
         return block.status == Block::Status::kPending;
@@ -0,0 +1,57 @@
+#include "core/PieceCache.hpp"
+
+PieceCache::PieceCache(size_t capacity_bytes) :
+    capacity_bytes(capacity_bytes),
+    size_bytes(0)
+{}
+
+PieceCache::PieceData PieceCache::Get(size_t piece_index) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = entries.find(piece_index);
+    if (it == entries.end()) {
+        ++misses;
+        return nullptr;
+    }
+
+    ++hits;
+    lru.splice(lru.begin(), lru, it->second);
+    return it->second->second;
+}
+
+void PieceCache::Put(size_t piece_index, utils::AlignedBuffer data) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (data.Size() > capacity_bytes) {
+        return;
+    }
+
+    auto it = entries.find(piece_index);
+    if (it != entries.end()) {
+        size_bytes -= it->second->second->Size();
+        lru.erase(it->second);
+        entries.erase(it);
+    }
+
+    size_bytes += data.Size();
+    lru.emplace_front(
+        piece_index,
+        std::make_shared<const utils::AlignedBuffer>(std::move(data))
+    );
+    entries[piece_index] = lru.begin();
+
+    EvictToCapacity();
+}
+
+PieceCache::Stats PieceCache::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return { hits.load(), misses.load(), size_bytes, capacity_bytes };
+}
+
+void PieceCache::EvictToCapacity() {
+    while (size_bytes > capacity_bytes && !lru.empty()) {
+        size_bytes -= lru.back().second->Size();
+        entries.erase(lru.back().first);
+        lru.pop_back();
+    }
+}
@@ -0,0 +1,60 @@
+#include "core/PieceHashes.hpp"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+static_assert(sizeof(PieceHashes::Digest) == 20, "Digests must be packed");
+
+PieceHashes::PieceHashes(std::string_view packed) {
+    if (packed.size() % kHashSize != 0) {
+        throw std::runtime_error(
+            "Piece hashes length " +
+            std::to_string(packed.size()) +
+            " is not a multiple of " +
+            std::to_string(kHashSize)
+        );
+    }
+
+    auto table = std::make_shared<std::vector<Digest>>(packed.size() / kHashSize);
+    if (!packed.empty()) {
+        std::memcpy(table->data(), packed.data(), packed.size());
+    }
+    digests = *table;
+    owner = std::move(table);
+}
+
+PieceHashes::PieceHashes(
+    std::shared_ptr<const void> owner,
+    std::span<const Digest> digests
+) :
+    owner(std::move(owner)),
+    digests(digests)
+{}
+
+size_t PieceHashes::Size() const {
+    return digests.size();
+}
+
+bool PieceHashes::Empty() const {
+    return Size() == 0;
+}
+
+const PieceHashes::Digest& PieceHashes::operator[](size_t index) const {
+    return digests[index];
+}
+
+bool PieceHashes::Matches(size_t index, const Digest& digest) const {
+    return index < Size() && digests[index] == digest;
+}
+
+std::span<const PieceHashes::Digest> PieceHashes::All() const {
+    return digests;
+}
+
+std::string_view PieceHashes::Packed() const {
+    return {
+        reinterpret_cast<const char*>(digests.data()),
+        digests.size() * kHashSize
+    };
+}
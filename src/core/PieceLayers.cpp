@@ -0,0 +1,40 @@
+#include "core/PieceLayers.hpp"
+
+#include <type_traits>
+
+static_assert(std::is_trivially_copyable_v<PieceLayers::Entry>);
+static_assert(sizeof(PieceLayers::Entry) == 48, "Entries must be packed");
+
+PieceLayers::PieceLayers(std::vector<Entry> entries) {
+    auto table = std::make_shared<const std::vector<Entry>>(std::move(entries));
+    this->entries = *table;
+    owner = std::move(table);
+}
+
+PieceLayers::PieceLayers(
+    std::shared_ptr<const void> owner,
+    std::span<const Entry> entries
+) :
+    owner(std::move(owner)),
+    entries(entries)
+{}
+
+size_t PieceLayers::Size() const {
+    return entries.size();
+}
+
+bool PieceLayers::Empty() const {
+    return Size() == 0;
+}
+
+bool PieceLayers::HasRoot(size_t index) const {
+    return index < Size() && entries[index].leaf_count > 0;
+}
+
+const PieceLayers::Entry& PieceLayers::operator[](size_t index) const {
+    return entries[index];
+}
+
+std::span<const PieceLayers::Entry> PieceLayers::All() const {
+    return entries;
+}
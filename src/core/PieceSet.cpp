@@ -0,0 +1,99 @@
+#include "core/PieceSet.hpp"
+
+#include <algorithm>
+#include <bit>
+
+namespace {
+    constexpr size_t kWordBits = 64;
+}
+
+PieceSet::PieceSet(size_t piece_count) :
+    words((piece_count + kWordBits - 1) / kWordBits, 0),
+    piece_count(piece_count)
+{}
+
+PieceSet PieceSet::FromBitfield(std::string_view bitfield, size_t piece_count) {
+    PieceSet set(piece_count);
+    size_t bits = std::min(piece_count, bitfield.size() * 8);
+    for (size_t index = 0; index < bits; ++index) {
+        auto byte = static_cast<uint8_t>(bitfield[index >> 3]);
+        if ((byte >> (7 - (index & 7))) & 1) {
+            set.Insert(index);
+        }
+    }
+    return set;
+}
+
+void PieceSet::Insert(size_t index) {
+    if (index >= piece_count) {
+        return;
+    }
+
+    auto bit = uint64_t{1} << (index % kWordBits);
+    auto& word = words[index / kWordBits];
+    if (!(word & bit)) {
+        word |= bit;
+        ++size;
+    }
+}
+
+void PieceSet::Erase(size_t index) {
+    if (index >= piece_count) {
+        return;
+    }
+
+    auto bit = uint64_t{1} << (index % kWordBits);
+    auto& word = words[index / kWordBits];
+    if (word & bit) {
+        word &= ~bit;
+        --size;
+    }
+}
+
+bool PieceSet::Contains(size_t index) const {
+    if (index >= piece_count) {
+        return false;
+    }
+    return (words[index / kWordBits] >> (index % kWordBits)) & 1;
+}
+
+bool PieceSet::Empty() const {
+    return size == 0;
+}
+
+size_t PieceSet::Size() const {
+    return size;
+}
+
+void PieceSet::Clear() {
+    std::fill(words.begin(), words.end(), 0);
+    size = 0;
+}
+
+size_t PieceSet::First() const {
+    if (size == 0) {
+        return kNone;
+    }
+
+    for (size_t i = 0; i < words.size(); ++i) {
+        if (words[i]) {
+            return i * kWordBits + std::countr_zero(words[i]);
+        }
+    }
+    return kNone;
+}
+
+size_t PieceSet::FirstCommon(const PieceSet& other) const {
+    if (size == 0 || other.size == 0) {
+        return kNone;
+    }
+
+    size_t count = std::min(words.size(), other.words.size());
+    for (size_t i = 0; i < count; ++i) {
+        auto common = words[i] & other.words[i];
+        if (common) {
+            return i * kWordBits + std::countr_zero(common);
+        }
+    }
+    return kNone;
+}
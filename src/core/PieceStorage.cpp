@@ -5,92 +5,415 @@
 
 PieceStorage::PieceStorage(
     const TorrentFile& torrent_file,
-    const std::filesystem::path& output_directory
+    const std::filesystem::path& output_directory,
+    const StorageOptions& options
 ) :
+      queued_pieces(torrent_file.PieceCount()),
+      file_priorities(torrent_file.files.size(), PiecePriority::kNormal),
+      piece_priorities(torrent_file.PieceCount(), PiecePriority::kNormal),
+      read_cache(options.read_cache_bytes),
+      cache_written_pieces(options.cache_written_pieces),
       output_directory(output_directory),
       default_piece_length(torrent_file.piece_length),
-      total_piece_count(torrent_file.piece_hashes.size()),
+      total_piece_count(torrent_file.PieceCount()),
       torrent_file(torrent_file)
 {
+    for (size_t i = 0; i < kQueuedPriorityLevels; ++i) {
+        partial_pieces[i] = PieceSet(total_piece_count);
+        untouched_pieces[i] = PieceSet(total_piece_count);
+    }
     for (size_t i = 0; i < total_piece_count; ++i) {
-        size_t len;
-        if (i + 1 == total_piece_count) {
-            len = torrent_file.length - i * torrent_file.piece_length;
-        } else {
-            len = torrent_file.piece_length;
-        }
-
-        remaining_pieces_queue.push(
-            std::make_shared<Piece>(i, len, torrent_file.piece_hashes[i])
-        );
+        QueuePiece(MakePiece(i));
     }
 
-    InitializeOutputFile();
+    InitializeOutputFile(options.direct_io);
 }
 
-void PieceStorage::InitializeOutputFile() {
+void PieceStorage::InitializeOutputFile(bool direct_io) {
     std::filesystem::create_directories(output_directory);
     auto filename = (output_directory / torrent_file.name).string();
 
-    file.open(filename, std::ios::binary | std::ios::out | std::ios::trunc);
+    if (direct_io && !DirectFile::IsAligned(default_piece_length)) {
+        direct_io_fallback_reason =
+            "piece length " +
+            std::to_string(default_piece_length) +
+            " is not aligned for O_DIRECT";
+    } else if (direct_io) {
+        try {
+            direct_file = std::make_unique<DirectFile>(
+                filename,
+                torrent_file.length
+            );
+            return;
+        } catch (const std::runtime_error& error) {
+            // e.g. tmpfs rejects O_DIRECT, use buffered I/O instead
+            direct_io_fallback_reason = error.what();
+        }
+    }
+
+    file.open(
+        filename,
+        std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc
+    );
     if (!file.is_open()) {
         throw std::runtime_error("Failed to open output file");
     }
 
+    // Extending the file by seeking leaves a sparse file, so ranges of
+    // skipped pieces are never written and never take up disk space.
     file.seekp(torrent_file.length - 1);
     file.write("", 1);
 }
 
-PiecePtr PieceStorage::GetNextPieceToDownload() {
-    std::lock_guard<std::mutex> lock(queue_mutex);
-    if (remaining_pieces_queue.empty()) {
-        return nullptr;
+size_t PieceStorage::PieceLength(size_t piece_index) const {
+    // Pure v2 pieces end with their file; the gap up to the next piece
+    // boundary is never transferred.
+    if (
+        torrent_file.piece_hashes.Empty()
+        && torrent_file.piece_layers.HasRoot(piece_index)
+    ) {
+        return torrent_file.piece_layers[piece_index].data_length;
     }
+    if (piece_index + 1 == total_piece_count) {
+        return torrent_file.length - piece_index * torrent_file.piece_length;
+    }
+    return torrent_file.piece_length;
+}
 
-    auto piece = remaining_pieces_queue.front();
-    remaining_pieces_queue.pop();
+PiecePtr PieceStorage::MakePiece(size_t piece_index) const {
+    auto piece = std::make_shared<Piece>(
+        piece_index,
+        PieceLength(piece_index),
+        torrent_file.piece_hashes.Empty()
+            ? utils::Sha1Digest{}
+            : torrent_file.piece_hashes[piece_index]
+    );
+
+    if (torrent_file.piece_layers.HasRoot(piece_index)) {
+        const auto& layer = torrent_file.piece_layers[piece_index];
+        piece->SetMerkleRoot(layer.root, layer.leaf_count, layer.data_length);
+    }
     return piece;
 }
 
+size_t PieceStorage::LevelOf(PiecePriority priority) {
+    switch (priority) {
+
+    case PiecePriority::kHigh:
+        return 0;
+    case PiecePriority::kNormal:
+        return 1;
+    case PiecePriority::kLow:
+        return 2;
+    default:
+        throw std::logic_error("Skipped pieces have no queue");
+
+    }
+}
+
+void PieceStorage::QueuePiece(PiecePtr piece) {
+    auto index = piece->GetIndex();
+    auto level = LevelOf(piece_priorities[index]);
+    if (piece->GetBytesDownloaded() > 0) {
+        partial_pieces[level].Insert(index);
+    } else {
+        untouched_pieces[level].Insert(index);
+    }
+    queued_pieces[index] = std::move(piece);
+}
+
+void PieceStorage::ReindexQueue() {
+    for (size_t level = 0; level < kQueuedPriorityLevels; ++level) {
+        partial_pieces[level].Clear();
+        untouched_pieces[level].Clear();
+    }
+
+    for (size_t i = 0; i < total_piece_count; ++i) {
+        if (!queued_pieces[i]) {
+            continue;
+        }
+
+        if (piece_priorities[i] == PiecePriority::kSkip) {
+            queued_pieces[i].reset();
+        } else {
+            QueuePiece(std::move(queued_pieces[i]));
+        }
+    }
+}
+
+PiecePtr PieceStorage::TakeFirst(const PieceSet* available) {
+    for (size_t level = 0; level < kQueuedPriorityLevels; ++level) {
+        for (auto* set : { &partial_pieces[level], &untouched_pieces[level] }) {
+            auto index = available ? set->FirstCommon(*available) : set->First();
+            if (index == PieceSet::kNone) {
+                continue;
+            }
+
+            set->Erase(index);
+            auto piece = std::move(queued_pieces[index]);
+            in_flight[index] = piece;
+            return piece;
+        }
+    }
+    return nullptr;
+}
+
+PiecePtr PieceStorage::GetNextPieceToDownload() {
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    return TakeFirst(nullptr);
+}
+
+PiecePtr PieceStorage::GetNextPieceToDownload(const PieceSet& available) {
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    return TakeFirst(&available);
+}
+
 void PieceStorage::Enqueue(const PiecePtr& piece) {
     if (!piece) {
         return;
     }
 
-    if (IsPieceAlreadySaved(piece->GetIndex())) {
+    if (!ReleaseInFlight(piece) || IsPieceAlreadySaved(piece->GetIndex())) {
         return;
     }
 
-    piece->Reset();
+    piece->ResetPendingBlocks();
     std::lock_guard<std::mutex> lock(queue_mutex);
-    remaining_pieces_queue.push(piece);
+    auto priority = piece_priorities[piece->GetIndex()];
+    if (priority == PiecePriority::kSkip) {
+        return;
+    }
+
+    QueuePiece(piece);
 }
 
 void PieceStorage::PieceProcessed(const PiecePtr& piece) {
-    if (!piece || !piece->HashMatches()) {
+    if (!piece) {
+        return;
+    }
+
+    downloaded_bytes += piece->GetLength();
+    if (IsPieceAlreadySaved(piece->GetIndex())) {
+        ReleaseInFlight(piece);
+        return;
+    }
+
+    utils::AlignedBuffer data(piece->GetLength());
+    if (piece->HasMerkleRoot()) {
+        // Blocks were hashed on arrival, only the tree above them is left.
+        if (!piece->MerkleRootMatches()) {
+            piece->Reset();
+            return Enqueue(piece);
+        }
+        piece->CopyData(data.Data());
+    } else if (piece->CopyDataAndHash(data.Data()) != piece->GetHash()) {
+        // Single pass over the blocks: each one is copied into the write
+        // buffer and hashed while it is still hot in cache.
+        piece->Reset();
         return Enqueue(piece);
     }
 
-    SavePieceToDisk(piece);
+    // Released only once saved, so a priority change in between does not
+    // queue the piece again.
+    SavePieceToDisk(piece->GetIndex(), std::move(data));
+    ReleaseInFlight(piece);
 }
 
-void PieceStorage::SavePieceToDisk(const PiecePtr& piece) {
+bool PieceStorage::IsInFlight(const PiecePtr& piece) const {
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    auto it = in_flight.find(piece->GetIndex());
+    return it != in_flight.end() && it->second == piece;
+}
+
+bool PieceStorage::ReleaseInFlight(const PiecePtr& piece) {
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    auto it = in_flight.find(piece->GetIndex());
+    if (it == in_flight.end() || it->second != piece) {
+        return false;
+    }
+    in_flight.erase(it);
+    return true;
+}
+
+void PieceStorage::SavePieceToDisk(
+    size_t piece_index,
+    utils::AlignedBuffer data
+) {
     std::lock_guard<std::mutex> lock(file_mutex);
 
-    if (saved_pieces.contains(piece->GetIndex())) {
+    if (saved_pieces.contains(piece_index)) {
         return;
     }
 
-    file.seekp(piece->GetIndex() * default_piece_length);
-    const auto& data = piece->GetData();
-    file.write(data.data(), data.size());
+    if (direct_file) {
+        direct_file->Write(piece_index * default_piece_length, data);
+    } else {
+        file.seekp(piece_index * default_piece_length);
+        file.write(data.Data(), data.Size());
+    }
+
+    saved_pieces.insert(piece_index);
+    if (cache_written_pieces) {
+        read_cache.Put(piece_index, std::move(data));
+    }
+}
+
+std::string PieceStorage::ReadBlock(
+    size_t piece_index,
+    size_t offset,
+    size_t length
+) {
+    if (!IsPieceAlreadySaved(piece_index)) {
+        throw std::runtime_error(
+            "Piece " + std::to_string(piece_index) + " is not available"
+        );
+    }
+
+    if (offset + length > PieceLength(piece_index)) {
+        throw std::out_of_range(
+            "Block " +
+            std::to_string(offset) +
+            "+" +
+            std::to_string(length) +
+            " is outside of piece " +
+            std::to_string(piece_index)
+        );
+    }
+
+    auto data = read_cache.Get(piece_index);
+    if (data) {
+        return std::string(data->View().substr(offset, length));
+    }
+
+    auto piece_data = ReadPieceFromDisk(piece_index);
+    std::string block(piece_data.View().substr(offset, length));
+    read_cache.Put(piece_index, std::move(piece_data));
+    return block;
+}
+
+std::string PieceStorage::SavedPiecesBitfield() const {
+    std::lock_guard<std::mutex> lock(file_mutex);
+    std::string bitfield((total_piece_count + 7) / 8, '\0');
+    for (auto index : saved_pieces) {
+        bitfield[index >> 3] |= static_cast<char>(0x80 >> (index & 7));
+    }
+    return bitfield;
+}
+
+utils::AlignedBuffer PieceStorage::ReadPieceFromDisk(size_t piece_index) {
+    std::lock_guard<std::mutex> lock(file_mutex);
+
+    if (direct_file) {
+        return direct_file->Read(
+            piece_index * default_piece_length,
+            PieceLength(piece_index)
+        );
+    }
+
+    utils::AlignedBuffer data(PieceLength(piece_index));
+    file.seekg(piece_index * default_piece_length);
+    file.read(data.Data(), data.Size());
+    if (!file) {
+        file.clear();
+        throw std::runtime_error(
+            "Failed to read piece " + std::to_string(piece_index)
+        );
+    }
+    return data;
+}
+
+PieceCache::Stats PieceStorage::GetReadCacheStats() const {
+    return read_cache.GetStats();
+}
 
-    saved_pieces.insert(piece->GetIndex());
+bool PieceStorage::IsDirectIo() const {
+    return direct_file != nullptr;
+}
+
+const std::string& PieceStorage::DirectIoFallbackReason() const {
+    return direct_io_fallback_reason;
+}
+
+void PieceStorage::SetFilePriority(size_t file_index, PiecePriority priority) {
+    std::scoped_lock lock(queue_mutex, file_mutex);
+    if (file_index >= file_priorities.size()) {
+        throw std::out_of_range(
+            "File index " + std::to_string(file_index) + " out of range"
+        );
+    }
+
+    file_priorities[file_index] = priority;
+    auto previous = piece_priorities;
+    RecomputePiecePriorities();
+    ApplyPriorityChange(previous);
+}
+
+void PieceStorage::SetPiecePriority(size_t piece_index, PiecePriority priority) {
+    std::scoped_lock lock(queue_mutex, file_mutex);
+    if (piece_index >= total_piece_count) {
+        throw std::out_of_range(
+            "Piece index " + std::to_string(piece_index) + " out of range"
+        );
+    }
+
+    auto previous = piece_priorities;
+    piece_priorities[piece_index] = priority;
+    ApplyPriorityChange(previous);
+}
+
+PiecePriority PieceStorage::GetPiecePriority(size_t piece_index) const {
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    return piece_priorities.at(piece_index);
+}
+
+void PieceStorage::RecomputePiecePriorities() {
+    std::fill(
+        piece_priorities.begin(),
+        piece_priorities.end(),
+        PiecePriority::kSkip
+    );
+
+    for (size_t i = 0; i < torrent_file.files.size(); ++i) {
+        const auto& entry = torrent_file.files[i];
+        if (entry.length == 0 || default_piece_length == 0) {
+            continue;
+        }
+
+        size_t first = entry.offset / default_piece_length;
+        size_t last = (entry.offset + entry.length - 1) / default_piece_length;
+        for (size_t j = first; j <= last && j < total_piece_count; ++j) {
+            piece_priorities[j] = std::max(piece_priorities[j], file_priorities[i]);
+        }
+    }
+}
+
+void PieceStorage::ApplyPriorityChange(
+    const std::vector<PiecePriority>& previous
+) {
+    for (size_t i = 0; i < total_piece_count; ++i) {
+        if (piece_priorities[i] == PiecePriority::kSkip) {
+            // The connection holding it drops it, see IsInFlight.
+            in_flight.erase(i);
+        } else if (
+            previous[i] == PiecePriority::kSkip
+            && !queued_pieces[i]
+            && !saved_pieces.contains(i)
+            && !in_flight.contains(i)
+        ) {
+            queued_pieces[i] = MakePiece(i);
+        }
+    }
+    ReindexQueue();
 }
 
 bool PieceStorage::QueueIsEmpty() const {
     std::lock_guard<std::mutex> lock(queue_mutex);
-    return remaining_pieces_queue.empty();
+    for (size_t level = 0; level < kQueuedPriorityLevels; ++level) {
+        if (!partial_pieces[level].Empty() || !untouched_pieces[level].Empty()) {
+            return false;
+        }
+    }
+    return true;
 }
 
 bool PieceStorage::IsPieceAlreadySaved(size_t index) const {
@@ -99,8 +422,16 @@ bool PieceStorage::IsPieceAlreadySaved(size_t index) const {
 }
 
 bool PieceStorage::IsDownloadComplete() const {
-    std::lock_guard<std::mutex> lock(file_mutex);
-    return saved_pieces.size() == total_piece_count;
+    std::scoped_lock lock(queue_mutex, file_mutex);
+    for (size_t i = 0; i < total_piece_count; ++i) {
+        if (
+            piece_priorities[i] != PiecePriority::kSkip
+            && !saved_pieces.contains(i)
+        ) {
+            return false;
+        }
+    }
+    return true;
 }
 
 bool PieceStorage::HasActiveWork() const {
@@ -111,18 +442,47 @@ size_t PieceStorage::TotalPiecesCount() const {
     return total_piece_count;
 }
 
+size_t PieceStorage::WantedPiecesCount() const {
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    return total_piece_count - std::count(
+        piece_priorities.begin(),
+        piece_priorities.end(),
+        PiecePriority::kSkip
+    );
+}
+
 size_t PieceStorage::PiecesSavedToDiscCount() const {
     std::lock_guard<std::mutex> lock(file_mutex);
     return saved_pieces.size();
 }
 
+uint64_t PieceStorage::DownloadedBytes() const {
+    return downloaded_bytes;
+}
+
+uint64_t PieceStorage::BytesLeft() const {
+    std::scoped_lock lock(queue_mutex, file_mutex);
+    uint64_t left = 0;
+    for (size_t index = 0; index < total_piece_count; ++index) {
+        if (
+            piece_priorities[index] != PiecePriority::kSkip
+            && !saved_pieces.contains(index)
+        ) {
+            left += PieceLength(index);
+        }
+    }
+    return left;
+}
+
 std::vector<size_t> PieceStorage::GetMissingPieces() const {
-    std::lock_guard<std::mutex> lock(file_mutex);
+    std::scoped_lock lock(queue_mutex, file_mutex);
     std::vector<size_t> missing;
-    missing.reserve(total_piece_count - saved_pieces.size());
 
     for (size_t i = 0; i < total_piece_count; ++i) {
-        if (!saved_pieces.contains(i)) {
+        if (
+            piece_priorities[i] != PiecePriority::kSkip
+            && !saved_pieces.contains(i)
+        ) {
             missing.push_back(i);
         }
     }
@@ -130,35 +490,32 @@ std::vector<size_t> PieceStorage::GetMissingPieces() const {
 }
 
 void PieceStorage::ForceRequeueMissingPieces() {
-    std::lock_guard<std::mutex> qlock(queue_mutex);
-    std::lock_guard<std::mutex> flock(file_mutex);
-
-    std::queue<PiecePtr> empty;
-    std::swap(remaining_pieces_queue, empty);
+    std::scoped_lock lock(queue_mutex, file_mutex);
 
+    // Pieces still in the queue keep their retrieved blocks, the ones
+    // held by connections are made anew and dropped by their holders.
+    in_flight.clear();
     for (size_t i = 0; i < total_piece_count; ++i) {
         if (saved_pieces.contains(i)) {
-            continue;
+            queued_pieces[i].reset();
+        } else if (
+            !queued_pieces[i]
+            && piece_priorities[i] != PiecePriority::kSkip
+        ) {
+            queued_pieces[i] = MakePiece(i);
         }
-
-        size_t len;
-        if (i + 1 == total_piece_count) {
-            len = torrent_file.length - i * torrent_file.piece_length;
-        } else {
-            len = torrent_file.piece_length;
-        }
-
-        remaining_pieces_queue.push(
-            std::make_shared<Piece>(i, len, torrent_file.piece_hashes[i])
-        );
     }
+    ReindexQueue();
 }
 
 void PieceStorage::CloseOutputFile() {
     std::lock_guard<std::mutex> lock(file_mutex);
+    if (direct_file) {
+        direct_file->Close();
+    }
+
     if (file.is_open()) {
         file.flush();
         file.close();
     }
 }
-
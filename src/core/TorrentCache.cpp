@@ -0,0 +1,361 @@
+#include "core/TorrentCache.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <type_traits>
+
+#include "utils/InputBuffer.hpp"
+
+namespace {
+
+constexpr char kMagic[8] = {'T', 'C', 'M', 'E', 'T', 'A', '\0', '\0'};
+constexpr uint32_t kFormatVersion = 2;
+
+struct CacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t meta_version;
+    // Covers everything after the header.
+    uint64_t checksum;
+    uint64_t source_size;
+    uint64_t source_checksum;
+    char info_hash[20];
+    uint32_t announce_count;
+    uint64_t piece_length;
+    uint64_t length;
+    uint64_t string_count;
+    uint64_t strings_offset;
+    uint64_t string_data_offset;
+    uint64_t string_data_size;
+    uint64_t file_count;
+    uint64_t files_offset;
+    uint64_t hash_count;
+    uint64_t hashes_offset;
+    uint64_t layer_count;
+    uint64_t layers_offset;
+};
+
+struct CacheString {
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct CacheFile {
+    uint64_t length;
+    uint64_t offset;
+    uint32_t path;
+    uint32_t pieces_root;
+};
+
+// Fixed string table slots, followed by the announce list and then the
+// path and pieces root of every file.
+enum StringSlot : uint32_t {
+    kAnnounce = 0,
+    kComment,
+    kName,
+    kFirstAnnounce,
+};
+
+static_assert(std::is_trivially_copyable_v<CacheHeader>);
+static_assert(sizeof(CacheHeader) % 8 == 0);
+static_assert(sizeof(CacheFile) % 8 == 0);
+
+// Word-at-a-time hash over four independent lanes, fast enough that
+// validating a cache costs a small fraction of reparsing the torrent.
+uint64_t Checksum(std::string_view data) {
+    constexpr uint64_t kMultiplier = 0xff51afd7ed558ccdULL;
+    uint64_t lanes[4] = {
+        0x9e3779b97f4a7c15ULL ^ data.size(),
+        0xc2b2ae3d27d4eb4fULL,
+        0x165667b19e3779f9ULL,
+        0x27d4eb2f165667c5ULL,
+    };
+
+    size_t i = 0;
+    for (; i + 32 <= data.size(); i += 32) {
+        for (int lane = 0; lane < 4; ++lane) {
+            uint64_t word;
+            std::memcpy(&word, data.data() + i + 8 * lane, sizeof(word));
+            lanes[lane] = (lanes[lane] ^ word) * kMultiplier;
+            lanes[lane] ^= lanes[lane] >> 32;
+        }
+    }
+
+    uint64_t hash = lanes[0];
+    for (int lane = 1; lane < 4; ++lane) {
+        hash = (hash ^ lanes[lane]) * kMultiplier;
+    }
+    for (; i < data.size(); ++i) {
+        hash = (hash ^ static_cast<unsigned char>(data[i])) * 0xc4ceb9fe1a85ec53ULL;
+    }
+    return hash ^ (hash >> 29);
+}
+
+struct SourceStamp {
+    uint64_t size;
+    uint64_t checksum;
+};
+
+SourceStamp StampOf(const std::filesystem::path& torrent_path) {
+    auto source = utils::InputBuffer::FromFile(torrent_path.string());
+    return {source.View().size(), Checksum(source.View())};
+}
+
+std::filesystem::path CachePathOf(
+    const SourceStamp& stamp,
+    const std::filesystem::path& cache_directory
+) {
+    std::ostringstream name;
+    name << std::hex << std::setfill('0') << std::setw(16) << stamp.checksum << ".meta";
+    return cache_directory / name.str();
+}
+
+void AlignTo8(std::string& out) {
+    out.resize((out.size() + 7) & ~size_t(7), '\0');
+}
+
+template <typename T>
+uint64_t AppendArray(std::string& out, const T* data, size_t count) {
+    AlignTo8(out);
+    uint64_t offset = out.size();
+    out.append(reinterpret_cast<const char*>(data), count * sizeof(T));
+    return offset;
+}
+
+template <typename T>
+const T* ArrayAt(std::string_view data, uint64_t offset, uint64_t count) {
+    if (
+        offset % alignof(T) != 0
+        || offset > data.size()
+        || count > (data.size() - offset) / sizeof(T)
+    ) {
+        throw std::runtime_error("Metadata cache table out of bounds");
+    }
+    return reinterpret_cast<const T*>(data.data() + offset);
+}
+
+std::optional<TorrentFile> MapCache(
+    std::shared_ptr<const utils::InputBuffer> buffer,
+    const SourceStamp& stamp,
+    const std::string& expected_info_hash
+) {
+    std::string_view data = buffer->View();
+    if (data.size() < sizeof(CacheHeader)) {
+        return std::nullopt;
+    }
+
+    CacheHeader header;
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (
+        std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0
+        || header.version != kFormatVersion
+        || header.source_size != stamp.size
+        || header.source_checksum != stamp.checksum
+        || Checksum(data.substr(sizeof(CacheHeader))) != header.checksum
+    ) {
+        return std::nullopt;
+    }
+
+    TorrentFile result;
+    result.info_hash.assign(header.info_hash, sizeof(header.info_hash));
+    if (!expected_info_hash.empty() && result.info_hash != expected_info_hash) {
+        return std::nullopt;
+    }
+
+    auto strings = ArrayAt<CacheString>(data, header.strings_offset, header.string_count);
+    auto string_data = data.substr(
+        std::min<uint64_t>(header.string_data_offset, data.size()),
+        header.string_data_size
+    );
+    auto string_at = [&](uint64_t index) {
+        if (index >= header.string_count || strings[index].offset > string_data.size()) {
+            throw std::runtime_error("Metadata cache string out of bounds");
+        }
+        return std::string(string_data.substr(strings[index].offset, strings[index].size));
+    };
+
+    result.announce = string_at(kAnnounce);
+    result.comment = string_at(kComment);
+    result.name = string_at(kName);
+    for (uint32_t i = 0; i < header.announce_count; ++i) {
+        result.announce_list.push_back(string_at(kFirstAnnounce + i));
+    }
+
+    auto files = ArrayAt<CacheFile>(data, header.files_offset, header.file_count);
+    result.files.reserve(header.file_count);
+    for (uint64_t i = 0; i < header.file_count; ++i) {
+        result.files.push_back(TorrentFile::File{
+            string_at(files[i].path),
+            files[i].length,
+            files[i].offset,
+            string_at(files[i].pieces_root)
+        });
+    }
+
+    result.piece_length = header.piece_length;
+    result.length = header.length;
+    result.meta_version = header.meta_version;
+
+    auto hashes = ArrayAt<PieceHashes::Digest>(data, header.hashes_offset, header.hash_count);
+    auto layers = ArrayAt<PieceLayers::Entry>(data, header.layers_offset, header.layer_count);
+    result.piece_hashes = PieceHashes(buffer, {hashes, header.hash_count});
+    result.piece_layers = PieceLayers(buffer, {layers, header.layer_count});
+
+    return result;
+}
+
+} // namespace
+
+std::filesystem::path TorrentCacheDirectory() {
+    // Relative values are invalid per the XDG base directory spec.
+    const char* cache_home = std::getenv("XDG_CACHE_HOME");
+    if (cache_home && std::filesystem::path(cache_home).is_absolute()) {
+        return std::filesystem::path(cache_home) / "torrent-client";
+    }
+    const char* home = std::getenv("HOME");
+    if (home && *home) {
+        return std::filesystem::path(home) / ".cache" / "torrent-client";
+    }
+    return {};
+}
+
+std::filesystem::path TorrentCachePath(
+    const std::filesystem::path& torrent_path,
+    const std::filesystem::path& cache_directory
+) {
+    return CachePathOf(StampOf(torrent_path), cache_directory);
+}
+
+std::optional<TorrentFile> LoadTorrentCache(
+    const std::filesystem::path& torrent_path,
+    const std::string& expected_info_hash,
+    const std::filesystem::path& cache_directory
+) {
+    if (cache_directory.empty()) {
+        return std::nullopt;
+    }
+
+    try {
+        auto stamp = StampOf(torrent_path);
+        auto cache_path = CachePathOf(stamp, cache_directory);
+        std::error_code error;
+        if (!std::filesystem::exists(cache_path, error)) {
+            return std::nullopt;
+        }
+
+        auto buffer = std::make_shared<const utils::InputBuffer>(
+            utils::InputBuffer::FromFile(cache_path.string())
+        );
+        return MapCache(std::move(buffer), stamp, expected_info_hash);
+    } catch (const std::exception&) {
+        return std::nullopt;
+    }
+}
+
+void SaveTorrentCache(
+    const TorrentFile& torrent_file,
+    const std::filesystem::path& torrent_path,
+    const std::filesystem::path& cache_directory
+) {
+    if (cache_directory.empty()) {
+        throw std::runtime_error("No cache directory, neither XDG_CACHE_HOME nor HOME is set");
+    }
+
+    std::vector<std::string_view> string_values = {
+        torrent_file.announce,
+        torrent_file.comment,
+        torrent_file.name,
+    };
+    string_values.insert(
+        string_values.end(),
+        torrent_file.announce_list.begin(),
+        torrent_file.announce_list.end()
+    );
+
+    std::vector<CacheFile> files;
+    for (const auto& file : torrent_file.files) {
+        files.push_back(CacheFile{
+            file.length,
+            file.offset,
+            static_cast<uint32_t>(string_values.size()),
+            static_cast<uint32_t>(string_values.size() + 1)
+        });
+        string_values.push_back(file.path);
+        string_values.push_back(file.pieces_root);
+    }
+
+    std::vector<CacheString> strings;
+    std::string string_data;
+    for (auto value : string_values) {
+        strings.push_back(CacheString{string_data.size(), value.size()});
+        string_data.append(value);
+    }
+
+    CacheHeader header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kFormatVersion;
+    header.meta_version = torrent_file.meta_version;
+    std::memcpy(
+        header.info_hash,
+        torrent_file.info_hash.data(),
+        std::min(torrent_file.info_hash.size(), sizeof(header.info_hash))
+    );
+    header.announce_count = torrent_file.announce_list.size();
+    header.piece_length = torrent_file.piece_length;
+    header.length = torrent_file.length;
+
+    std::string out(sizeof(CacheHeader), '\0');
+    header.string_count = strings.size();
+    header.strings_offset = AppendArray(out, strings.data(), strings.size());
+    header.string_data_offset = AppendArray(out, string_data.data(), string_data.size());
+    header.string_data_size = string_data.size();
+    header.file_count = files.size();
+    header.files_offset = AppendArray(out, files.data(), files.size());
+
+    auto hashes = torrent_file.piece_hashes.All();
+    header.hash_count = hashes.size();
+    header.hashes_offset = AppendArray(out, hashes.data(), hashes.size());
+
+    auto layers = torrent_file.piece_layers.All();
+    header.layer_count = layers.size();
+    header.layers_offset = AppendArray(out, layers.data(), layers.size());
+    AlignTo8(out);
+
+    auto stamp = StampOf(torrent_path);
+    header.source_size = stamp.size;
+    header.source_checksum = stamp.checksum;
+    header.checksum = Checksum(std::string_view(out).substr(sizeof(CacheHeader)));
+    std::memcpy(out.data(), &header, sizeof(header));
+
+    // Written under a temporary name so readers never map a partial file.
+    std::filesystem::create_directories(cache_directory);
+    auto cache_path = CachePathOf(stamp, cache_directory);
+    auto temporary_path = cache_path;
+    temporary_path += ".tmp";
+    {
+        std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+        if (!file.write(out.data(), out.size())) {
+            throw std::runtime_error("Cannot write " + temporary_path.string());
+        }
+    }
+    std::filesystem::rename(temporary_path, cache_path);
+}
+
+TorrentFile LoadTorrentFileCached(const std::string& filename) {
+    if (auto cached = LoadTorrentCache(filename)) {
+        return std::move(*cached);
+    }
+
+    TorrentFile result = LoadTorrentFile(filename);
+    try {
+        SaveTorrentCache(result, filename);
+    } catch (const std::exception&) {
+        // e.g. an unwritable cache directory; the cache is only an optimization
+    }
+    return result;
+}
@@ -2,10 +2,16 @@
 
 #include <algorithm>
 #include <chrono>
+#include <fstream>
+#include <optional>
 #include <random>
 #include <thread>
 
+#include "core/TorrentCache.hpp"
+#include "net/MetadataFetcher.hpp"
 #include "net/PeerConnection.hpp"
+#include "utils/BencodeWriter.hpp"
+#include "utils/byte_tools.hpp"
 
 
 TorrentClient::TorrentClient(const std::string& peer_id) :
@@ -18,6 +24,7 @@ TorrentClient::TorrentClient(const std::string& peer_id) :
 
 TorrentClient::~TorrentClient() {
     RequestStop();
+    StopAnnounce();
 }
 
 std::string TorrentClient::GenerateRandomSuffix(size_t length) {
@@ -38,9 +45,12 @@ void TorrentClient::RequestStop() {
     is_terminated = true;
     is_paused = false;
 
-    for (auto& peer_connection_ptr : peer_connections) {
-        if (peer_connection_ptr) {
-            peer_connection_ptr->Terminate();
+    {
+        std::lock_guard<std::mutex> lock(connections_mutex);
+        for (auto& peer_connection_ptr : peer_connections) {
+            if (peer_connection_ptr) {
+                peer_connection_ptr->Terminate();
+            }
         }
     }
 
@@ -59,80 +69,26 @@ bool TorrentClient::IsStopRequested() const {
 
 bool TorrentClient::RunDownloadMultithread(
     PieceStorage& pieces,
-    const TorrentFile& torrent_file,
-    const HttpTracker& tracker
+    const TorrentFile& torrent_file
 ) {
     using namespace std::chrono_literals;
     UpdateTaskStatus(TorrentStatus::kDownloading);
-    UpdateTaskFromTracker(tracker);
-    
-    AddLogMessage(
-        "Starting download with " +
-        std::to_string(tracker.GetPeers().size()) +
-        " peers"
-    );
 
-    peer_connections.clear();
+    {
+        std::lock_guard<std::mutex> lock(connections_mutex);
+        peer_connections.clear();
+    }
 
     std::vector<std::thread> peer_threads;
-    for (const Peer& peer : tracker.GetPeers()) {
-        if (stop_requested) {
-            break;
-        }
-        try {
-            auto connection = std::make_shared<PeerConnection>(
-                peer,
-                torrent_file,
-                peer_id,
-                pieces
-            );
-
-            peer_connections.emplace_back(connection);
-        } catch (const std::exception& error) {
-            std::string error_msg =
-                "Failed to connect to " +
-                peer.ip +
-                ":" +
-                std::to_string(peer.port) +
-                " - " +
-                error.what();
-            AddLogMessage(error_msg);
-        }
-    }
+    ConnectPendingPeers(pieces, torrent_file, peer_threads);
 
     if (stop_requested) {
         UpdateTaskStatus(TorrentStatus::kStopped);
-        return false;
-    }
-
-    if (peer_connections.empty()) {
-        AddLogMessage("No valid peer connections established");
-        UpdateTaskStatus(TorrentStatus::kError);
-        return true;
-    }
-
-    peer_threads.reserve(peer_connections.size());
-    for (auto& peer_connection_ptr : peer_connections) {
-        if (stop_requested) {
-            break;
-        }
-        peer_threads.emplace_back([peer_connection_ptr]() {
-            while (!peer_connection_ptr->IsTerminated()) {
-                try {
-                    peer_connection_ptr->Run();
-                } catch (const std::exception& error) {
-                    if (!peer_connection_ptr->IsTerminated()) {
-                        std::this_thread::sleep_for(5s);
-                    }
-                }
+        {
+            std::lock_guard<std::mutex> lock(connections_mutex);
+            for (auto& peer_connection_ptr : peer_connections) {
+                peer_connection_ptr->Terminate();
             }
-        });
-    }
-
-    if (stop_requested) {
-        UpdateTaskStatus(TorrentStatus::kStopped);
-        for (auto& peer_connection_ptr : peer_connections) {
-            peer_connection_ptr->Terminate();
         }
         for (auto& thread : peer_threads) {
             if (thread.joinable()) {
@@ -142,17 +98,17 @@ bool TorrentClient::RunDownloadMultithread(
         return false;
     }
 
-    AddLogMessage(
-        "Started " +
-        std::to_string(peer_threads.size()) +
-        " peer threads"
-    );
+    if (peer_threads.empty()) {
+        AddLogMessage("No valid peer connections established");
+        UpdateTaskStatus(TorrentStatus::kError);
+        return true;
+    }
 
-    const size_t target_pieces = pieces.TotalPiecesCount();
+    const size_t target_pieces = pieces.WantedPiecesCount();
 
     {
         std::lock_guard<std::mutex> lock(task_mutex);
-        current_task.total_pieces_count = target_pieces;
+        current_task.total_pieces_count = pieces.TotalPiecesCount();
         current_task.total_size = torrent_file.length;
     }
 
@@ -179,6 +135,17 @@ bool TorrentClient::RunDownloadMultithread(
             continue;
         }
 
+        ConnectPendingPeers(pieces, torrent_file, peer_threads);
+        if (pieces.PiecesSavedToDiscCount() > 0) {
+            MarkStartupStage(StartupStage::kFirstPiece);
+        }
+
+        // DownloadFromTracker asks the trackers again and retries.
+        if (AllConnectionsEnded()) {
+            AddLogMessage("All peer connections ended");
+            break;
+        }
+
         size_t missing_count = pieces.GetMissingPieces().size();
 
         if (!endgame_mode && missing_count <= kPiecesLeftToEnterEndgame) {
@@ -203,11 +170,8 @@ bool TorrentClient::RunDownloadMultithread(
             }
         }
 
-        if (!pieces.HasActiveWork()) {
-            std::this_thread::sleep_for(100ms);
-        } else {
-            std::this_thread::sleep_for(50ms);
-        }
+        // Peers that arrive meanwhile are connected right away.
+        WaitForNewPeers(pieces.HasActiveWork() ? 50ms : 100ms);
     }
 
     UpdateTaskFromPieceStorage(pieces);
@@ -223,10 +187,16 @@ bool TorrentClient::RunDownloadMultithread(
         AddLogMessage("Download incomplete - missing pieces");
     }
 
-    is_terminated = true;
+    // An incomplete download is retried by DownloadFromTracker.
+    if (stop_requested || pieces.IsDownloadComplete()) {
+        is_terminated = true;
+    }
     timer.Stop();
-    for (auto& peer_connection_ptr : peer_connections) {
-        peer_connection_ptr->Terminate();
+    {
+        std::lock_guard<std::mutex> lock(connections_mutex);
+        for (auto& peer_connection_ptr : peer_connections) {
+            peer_connection_ptr->Terminate();
+        }
     }
 
     for (auto& thread : peer_threads) {
@@ -238,31 +208,85 @@ bool TorrentClient::RunDownloadMultithread(
     return !pieces.IsDownloadComplete() && !stop_requested;
 }
 
+void TorrentClient::ConnectPendingPeers(
+    PieceStorage& pieces,
+    const TorrentFile& torrent_file,
+    std::vector<std::thread>& peer_threads
+) {
+    using namespace std::chrono_literals;
+    std::vector<Peer> peers;
+    {
+        std::lock_guard<std::mutex> lock(swarm_mutex);
+        peers.swap(pending_peers);
+    }
+    if (peers.empty()) {
+        return;
+    }
+
+    size_t started = 0;
+    MarkStartupStage(StartupStage::kFirstConnectAttempt, peers.front().ToString());
+    for (const Peer& peer : peers) {
+        if (stop_requested) {
+            break;
+        }
+
+        std::shared_ptr<PeerConnection> connection;
+        try {
+            connection = std::make_shared<PeerConnection>(
+                peer,
+                torrent_file,
+                peer_id,
+                pieces
+            );
+        } catch (const std::exception& error) {
+            std::string error_msg =
+                "Failed to connect to " +
+                peer.ToString() +
+                " - " +
+                error.what();
+            AddLogMessage(error_msg);
+            continue;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(connections_mutex);
+            peer_connections.emplace_back(connection);
+        }
+        peer_threads.emplace_back([this, connection, peer]() {
+            while (!connection->IsTerminated()) {
+                try {
+                    connection->Run();
+                } catch (const std::exception& error) {
+                    if (!connection->IsTerminated()) {
+                        std::this_thread::sleep_for(5s);
+                    }
+                }
+            }
+            ForgetPeer(peer);
+        });
+        ++started;
+    }
+
+    AddLogMessage(
+        "Started " +
+        std::to_string(started) +
+        " peer threads"
+    );
+}
+
 void TorrentClient::DownloadFromTracker(
     const TorrentFile& torrent_file,
     PieceStorage& pieces
 ) {
     using namespace std::chrono_literals;
     UpdateTaskStatus(TorrentStatus::kConnected);
-    AddLogMessage("Connecting to trackers...");
-
-    std::vector<std::string> trackers = {
-        torrent_file.announce,
-        "udp://tracker.opentrackr.org:1337/announce",
-        "udp://open.stealth.si:80/announce",
-        "udp://exodus.desync.com:6969/announce",
-        "udp://tracker.torrent.eu.org:451/announce"
-    };
-
-    std::sort(trackers.begin(), trackers.end());
-    trackers.erase(std::unique(trackers.begin(), trackers.end()), trackers.end());
-
-    AddLogMessage("Using " + std::to_string(trackers.size()) + " trackers");
 
     int retry_count = 0;
     const int max_retries = 10;
     auto last_tracker_update = std::chrono::steady_clock::now();
 
+    // Downloading starts with the first tracker to answer; later answers
+    // and re-announces add their peers to the running session.
     while (!stop_requested && !is_terminated && !pieces.IsDownloadComplete()) {
         if (stop_requested) {
             break;
@@ -278,58 +302,11 @@ void TorrentClient::DownloadFromTracker(
             continue;
         }
 
-        std::vector<Peer> all_peers;
-        for (
-            size_t i = 0;
-            i < trackers.size() && !stop_requested && !is_terminated;
-            ++i
-        ) {
-            try {
-                HttpTracker tracker(trackers[i]);
-                AddLogMessage("Requesting peers from " + trackers[i] + "...");
-
-                tracker.UpdatePeers(torrent_file, peer_id, 12345);
-                const auto& peers = tracker.GetPeers();
-                all_peers.insert(all_peers.end(), peers.begin(), peers.end());
-
-                AddLogMessage(
-                    "Got " +
-                    std::to_string(peers.size()) +
-                    " peers from " + trackers[i]
-                );
-            } catch (const std::exception& error) {
-                AddLogMessage("Tracker " + trackers[i] + " error: " + error.what());
-            }
-        }
-
-        if (stop_requested) {
-            break;
-        }
-
-        if (!all_peers.empty()) {
-            auto cmp = [](const Peer& a, const Peer& b) {
-                return a.ip < b.ip || (a.ip == b.ip && a.port < b.port);
-            };
-            std::sort(all_peers.begin(), all_peers.end(), cmp);
-            
-            auto equal = [](const Peer& a, const Peer& b) {
-                return a.ip == b.ip && a.port == b.port;
-            };
-            auto last = std::unique(all_peers.begin(), all_peers.end(), equal);
-            all_peers.erase(last, all_peers.end());
-        }
-
-        {
-            std::lock_guard<std::mutex> lock(task_mutex);
-            current_task.total_peers_count = all_peers.size();
-        }
-
-        AddLogMessage("Total unique peers: " + std::to_string(all_peers.size()));
-
-        if (all_peers.empty()) {
+        if (!WaitForPeers()) {
             if (stop_requested) {
                 break;
             }
+            scheduler.RequestPeers();
             AddLogMessage("No peers found, waiting 5 seconds...");
             for (int i = 0; i < 50 && !stop_requested; ++i) {
                 std::this_thread::sleep_for(100ms);
@@ -340,19 +317,16 @@ void TorrentClient::DownloadFromTracker(
         if (pieces.QueueIsEmpty() && !pieces.IsDownloadComplete()) {
             AddLogMessage("Queue empty, requeuing missing pieces");
             pieces.ForceRequeueMissingPieces();
-            ++retry_count;
         }
 
-        HttpTracker combined_tracker(trackers[0]);
-        combined_tracker.SetPeers(all_peers);
-
-        RunDownloadMultithread(pieces, torrent_file, combined_tracker);
+        RunDownloadMultithread(pieces, torrent_file);
 
         if (stop_requested) {
             break;
         }
 
         if (!pieces.IsDownloadComplete()) {
+            ++retry_count;
             if (retry_count >= max_retries) {
                 AddLogMessage("Max retries reached, stopping download");
                 break;
@@ -374,6 +348,10 @@ void TorrentClient::DownloadFromTracker(
         }
     }
 
+    if (pieces.IsDownloadComplete()) {
+        scheduler.Completed();
+    }
+    StopAnnounce();
     UpdateTaskFromPieceStorage(pieces);
 
     if (stop_requested) {
@@ -386,9 +364,339 @@ void TorrentClient::DownloadFromTracker(
     }
 }
 
+std::vector<std::string> TorrentClient::TrackerUrls(
+    const std::vector<std::string>& announce_urls
+) {
+    std::vector<std::string> trackers;
+    if (default_trackers_enabled) {
+        trackers.assign(kDefaultTrackers.begin(), kDefaultTrackers.end());
+    }
+    for (const auto& url : announce_urls) {
+        if (!url.empty()) {
+            trackers.push_back(url);
+        }
+    }
+
+    std::sort(trackers.begin(), trackers.end());
+    trackers.erase(std::unique(trackers.begin(), trackers.end()), trackers.end());
+    return tracker_ranking.Rank(trackers);
+}
+
+void TorrentClient::Announce(
+    const TorrentFile& torrent_file,
+    const std::vector<std::string>& trackers,
+    const std::atomic<bool>& stop,
+    const std::function<void(const std::vector<Peer>&)>& on_peers
+) {
+    AnnounceParams params;
+    params.info_hash = torrent_file.info_hash;
+    params.peer_id = peer_id;
+    params.port = kListenPort;
+    params.left = torrent_file.length;
+
+    AddLogMessage("Requesting peers from " + std::to_string(trackers.size()) + " trackers...");
+    announcer.AnnounceAll(trackers, params, stop, [&](const AnnounceResult& result) {
+        tracker_ranking.RecordAnnounce(result);
+        if (!result.error.empty()) {
+            AddLogMessage("Tracker " + result.url + " error: " + result.error);
+            return;
+        }
+
+        MarkStartupStage(StartupStage::kFirstTrackerAnswer, result.url);
+        AddLogMessage(
+            "Got " +
+            std::to_string(result.peers.size()) +
+            " peers from " + result.url
+        );
+        on_peers(result.peers);
+    });
+}
+
+void TorrentClient::StartAnnounce(
+    const TorrentFile& torrent_file,
+    const std::vector<std::string>& trackers
+) {
+    {
+        std::lock_guard<std::mutex> lock(swarm_mutex);
+        pending_peers.clear();
+        known_peers.clear();
+    }
+
+    AnnounceParams params;
+    params.info_hash = torrent_file.info_hash;
+    params.peer_id = peer_id;
+    params.port = kListenPort;
+
+    AddLogMessage("Requesting peers from " + std::to_string(trackers.size()) + " trackers...");
+    scheduler.Start(
+        trackers,
+        params,
+        [this, &torrent_file] {
+            // Nothing is uploaded yet, the client does not serve requests.
+            const PieceStorage* pieces = announced_storage;
+            if (!pieces) {
+                return TransferStats{ 0, 0, torrent_file.length };
+            }
+            return TransferStats{ 0, pieces->DownloadedBytes(), pieces->BytesLeft() };
+        },
+        [this](const AnnounceResult& result) {
+            if (!result.error.empty()) {
+                AddLogMessage("Tracker " + result.url + " error: " + result.error);
+                return;
+            }
+
+            MarkStartupStage(StartupStage::kFirstTrackerAnswer, result.url);
+            AddLogMessage(
+                "Got " +
+                std::to_string(result.peers.size()) +
+                " peers from " + result.url
+            );
+            AddDiscoveredPeers(result.peers);
+        }
+    );
+}
+
+void TorrentClient::StopAnnounce() {
+    scheduler.Stop();
+}
+
+void TorrentClient::WaitForNewPeers(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(swarm_mutex);
+    swarm_changed.wait_for(lock, timeout, [this] {
+        return !pending_peers.empty() || stop_requested;
+    });
+}
+
+bool TorrentClient::WaitForPeers() {
+    using namespace std::chrono_literals;
+    std::unique_lock<std::mutex> lock(swarm_mutex);
+    while (pending_peers.empty() && scheduler.IsAnnouncing() && !stop_requested) {
+        swarm_changed.wait_for(lock, 100ms);
+    }
+    return !pending_peers.empty();
+}
+
+void TorrentClient::AddDiscoveredPeers(const std::vector<Peer>& peers) {
+    size_t known_count;
+    bool added = false;
+    {
+        std::lock_guard<std::mutex> lock(swarm_mutex);
+        for (const auto& peer : peers) {
+            if (known_peers.insert(peer).second) {
+                pending_peers.push_back(peer);
+                added = true;
+            }
+        }
+        known_count = known_peers.size();
+    }
+    if (!added) {
+        return;
+    }
+    MarkStartupStage(StartupStage::kFirstPeer);
+    swarm_changed.notify_all();
+
+    std::lock_guard<std::mutex> lock(task_mutex);
+    current_task.total_peers_count = known_count;
+}
+
+// A peer whose connection ended is forgotten, so a later tracker answer
+// that lists it again connects it anew.
+void TorrentClient::ForgetPeer(const Peer& peer) {
+    std::lock_guard<std::mutex> lock(swarm_mutex);
+    known_peers.erase(peer);
+}
+
+bool TorrentClient::AllConnectionsEnded() const {
+    std::lock_guard<std::mutex> lock(connections_mutex);
+    return std::all_of(
+        peer_connections.begin(),
+        peer_connections.end(),
+        [](const auto& connection) { return connection->IsTerminated(); }
+    );
+}
+
+void TorrentClient::DownloadMagnet(
+    const std::string& magnet_uri,
+    const std::filesystem::path& output_directory
+) {
+    is_terminated = false;
+    is_paused = false;
+    stop_requested = false;
+    BeginStartup();
+
+    MagnetLink magnet = ParseMagnetLink(magnet_uri);
+    auto torrent_file_path =
+        output_directory / (utils::BytesToHex(magnet.info_hash) + ".torrent");
+
+    {
+        std::lock_guard<std::mutex> lock(task_mutex);
+        current_task.filename = magnet.name;
+        current_task.total_size = magnet.length;
+        current_task.info_hash = magnet.info_hash;
+        current_task.announce_url = magnet.trackers.empty() ? "" : magnet.trackers.front();
+        current_task.output_file_path = output_directory.string();
+    }
+
+    if (!IsCachedMetadataValid(torrent_file_path, magnet.info_hash)) {
+        FetchMetadata(magnet, torrent_file_path);
+    } else {
+        AddLogMessage("Using cached metadata: " + torrent_file_path.string());
+    }
+
+    if (stop_requested) {
+        UpdateTaskStatus(TorrentStatus::kStopped);
+        return;
+    }
+
+    DownloadTorrentFile(torrent_file_path, output_directory);
+}
+
+bool TorrentClient::IsCachedMetadataValid(
+    const std::filesystem::path& torrent_file_path,
+    const std::string& info_hash
+) {
+    if (!std::filesystem::exists(torrent_file_path)) {
+        return false;
+    }
+
+    if (metadata_cache_enabled && LoadTorrentCache(torrent_file_path, info_hash)) {
+        return true;
+    }
+
+    try {
+        return LoadTorrentFile(torrent_file_path).info_hash == info_hash;
+    } catch (const std::exception& error) {
+        AddLogMessage("Ignoring cached metadata: " + std::string(error.what()));
+        return false;
+    }
+}
+
+void TorrentClient::FetchMetadata(
+    const MagnetLink& magnet,
+    const std::filesystem::path& torrent_file_path
+) {
+    using namespace std::chrono_literals;
+    UpdateTaskStatus(TorrentStatus::kFetchingMetadata);
+    AddLogMessage("Fetching metadata for " + utils::BytesToHex(magnet.info_hash));
+    fetching_metadata = true;
+
+    // Announce stand-in until the metadata is known. A non-zero "left"
+    // keeps trackers treating us as a leecher and returning seeders.
+    TorrentFile announce_target;
+    announce_target.info_hash = magnet.info_hash;
+    announce_target.length = magnet.length > 0 ? magnet.length : 1;
+    announce_target.piece_length = 0;
+
+    auto trackers = TrackerUrls(magnet.trackers);
+    std::string info;
+
+    for (int attempt = 1; attempt <= kMaxMetadataAttempts && !stop_requested; ++attempt) {
+        // Each tracker's new peers go to the fetcher as soon as it answers,
+        // so slow or dead trackers never delay the first connections.
+        MetadataFetcher fetcher(magnet.info_hash, peer_id);
+        std::atomic<bool> round_over{false};
+        size_t found_peers = 0;
+        std::thread announce_thread([&] {
+            std::unordered_set<Peer, PeerHash> seen;
+            Announce(announce_target, trackers, round_over, [&](const std::vector<Peer>& peers) {
+                std::vector<Peer> fresh;
+                for (const auto& peer : peers) {
+                    if (seen.insert(peer).second) {
+                        fresh.push_back(peer);
+                    }
+                }
+                if (fresh.empty()) {
+                    return;
+                }
+
+                MarkStartupStage(StartupStage::kFirstPeer, fresh.front().ToString());
+                found_peers += fresh.size();
+                {
+                    std::lock_guard<std::mutex> lock(task_mutex);
+                    current_task.total_peers_count = found_peers;
+                }
+                fetcher.AddPeers(fresh);
+            });
+            fetcher.EndOfPeers();
+        });
+
+        try {
+            info = fetcher.Fetch(stop_requested, kMetadataTimeout);
+        } catch (const std::exception& error) {
+            AddLogMessage(
+                "Metadata attempt " +
+                std::to_string(attempt) +
+                "/" +
+                std::to_string(kMaxMetadataAttempts) +
+                " failed: " +
+                error.what()
+            );
+        }
+        round_over = true;
+        announce_thread.join();
+
+        if (!info.empty()) {
+            break;
+        }
+        AddLogMessage("Total unique peers: " + std::to_string(found_peers));
+        if (found_peers == 0) {
+            for (int i = 0; i < 50 && !stop_requested; ++i) {
+                std::this_thread::sleep_for(100ms);
+            }
+        }
+    }
+
+    if (stop_requested) {
+        return;
+    }
+    if (info.empty()) {
+        UpdateTaskStatus(TorrentStatus::kError);
+        throw std::runtime_error("Could not fetch metadata for magnet link");
+    }
+
+    MarkStartupStage(StartupStage::kMetadataReceived);
+    // The download announces and finds peers anew; its stages are logged
+    // too instead of being hidden behind the fetch's.
+    fetching_metadata = false;
+    startup_stages &= 1u << static_cast<uint32_t>(StartupStage::kMetadataReceived);
+    AddLogMessage(
+        "Metadata received (" +
+        std::to_string(info.size()) +
+        " bytes), saved to " +
+        torrent_file_path.string()
+    );
+
+    std::string encoded;
+    utils::BencodeWriter writer(encoded);
+    writer.BeginDict();
+    if (!magnet.trackers.empty()) {
+        writer.Key("announce").String(magnet.trackers.front());
+        writer.Key("announce-list").BeginList();
+        for (const auto& tracker : magnet.trackers) {
+            writer.BeginList().String(tracker).End();
+        }
+        writer.End();
+    }
+    writer.Key("info").Raw(info);
+    writer.End();
+
+    std::ofstream file(torrent_file_path, std::ios::binary | std::ios::trunc);
+    if (!file.write(encoded.data(), encoded.size())) {
+        throw std::runtime_error("Cannot write " + torrent_file_path.string());
+    }
+}
+
 void TorrentClient::DownloadTorrent(
     const std::filesystem::path& torrent_file_path,
     const std::filesystem::path& output_directory
+) {
+    BeginStartup();
+    DownloadTorrentFile(torrent_file_path, output_directory);
+}
+
+void TorrentClient::DownloadTorrentFile(
+    const std::filesystem::path& torrent_file_path,
+    const std::filesystem::path& output_directory
 ) {
     is_terminated = false;
     is_paused = false;
@@ -397,7 +705,9 @@ void TorrentClient::DownloadTorrent(
     UpdateTaskStatus(TorrentStatus::kLoading);
     AddLogMessage("Loading torrent file: " + torrent_file_path.string());
 
-    TorrentFile torrent_file = LoadTorrentFile(torrent_file_path);
+    TorrentFile torrent_file = metadata_cache_enabled
+        ? LoadTorrentFileCached(torrent_file_path)
+        : LoadTorrentFile(torrent_file_path);
 
     {
         std::lock_guard<std::mutex> lock(task_mutex);
@@ -406,7 +716,7 @@ void TorrentClient::DownloadTorrent(
         current_task.info_hash = torrent_file.info_hash;
         current_task.announce_url = torrent_file.announce;
         current_task.output_file_path = output_directory.string();
-        current_task.total_pieces_count = torrent_file.piece_hashes.size();
+        current_task.total_pieces_count = torrent_file.PieceCount();
         current_task.start_time = std::chrono::system_clock::now();
         current_task.last_update = std::chrono::system_clock::now();
     }
@@ -417,20 +727,47 @@ void TorrentClient::DownloadTorrent(
         " (" +
         std::to_string(torrent_file.length) +
         " bytes, " +
-        std::to_string(torrent_file.piece_hashes.size()) +
+        std::to_string(torrent_file.PieceCount()) +
         " pieces)"
     );
+    MarkStartupStage(StartupStage::kTorrentLoaded);
+
+    // The trackers' first round runs while the output file is set up.
+    std::vector<std::string> announce_urls = torrent_file.announce_list;
+    announce_urls.push_back(torrent_file.announce);
+    auto trackers = TrackerUrls(announce_urls);
+    MarkStartupStage(StartupStage::kAnnounceStarted);
+    StartAnnounce(torrent_file, trackers);
 
-    PieceStorage pieces(torrent_file, output_directory);
+    std::optional<PieceStorage> storage;
+    try {
+        storage.emplace(torrent_file, output_directory, storage_options);
+    } catch (...) {
+        StopAnnounce();
+        throw;
+    }
+    PieceStorage& pieces = *storage;
+    if (!pieces.DirectIoFallbackReason().empty()) {
+        AddLogMessage(
+            "Using buffered I/O, O_DIRECT is unavailable: " +
+            pieces.DirectIoFallbackReason()
+        );
+    }
+    announced_storage = &pieces;
+    MarkStartupStage(StartupStage::kStorageReady);
 
     auto start_time = std::chrono::steady_clock::now();
 
     try {
+        ApplyPriorities(&pieces);
         DownloadFromTracker(torrent_file, pieces);
     } catch (const std::exception& error) {
         UpdateTaskStatus(TorrentStatus::kError);
         AddLogMessage("Download error: " + std::string(error.what()));
     }
+    ApplyPriorities(nullptr);
+    StopAnnounce();
+    announced_storage = nullptr;
 
     auto end_time = std::chrono::steady_clock::now();
 
@@ -445,6 +782,83 @@ void TorrentClient::DownloadTorrent(
         std::to_string(duration.count()) +
         " seconds"
     );
+
+    auto cache = pieces.GetReadCacheStats();
+    AddLogMessage(
+        "Read cache: " +
+        std::to_string(cache.hits) + " hits, " +
+        std::to_string(cache.misses) + " misses, " +
+        std::to_string(cache.size_bytes >> 20) + " of " +
+        std::to_string(cache.capacity_bytes >> 20) + " MiB used"
+    );
+}
+
+void TorrentClient::SetFilePriority(size_t file_index, PiecePriority priority) {
+    std::lock_guard<std::mutex> lock(priority_mutex);
+    if (prioritized_storage) {
+        prioritized_storage->SetFilePriority(file_index, priority);
+    }
+    file_priorities[file_index] = priority;
+}
+
+void TorrentClient::SetPiecePriority(size_t piece_index, PiecePriority priority) {
+    std::lock_guard<std::mutex> lock(priority_mutex);
+    if (prioritized_storage) {
+        prioritized_storage->SetPiecePriority(piece_index, priority);
+    }
+    piece_priorities[piece_index] = priority;
+}
+
+// Null detaches the storage once its download is over.
+void TorrentClient::ApplyPriorities(PieceStorage* pieces) {
+    std::lock_guard<std::mutex> lock(priority_mutex);
+    prioritized_storage = pieces;
+    if (!pieces) {
+        return;
+    }
+
+    for (const auto& [file_index, priority] : file_priorities) {
+        pieces->SetFilePriority(file_index, priority);
+    }
+
+    for (const auto& [piece_index, priority] : piece_priorities) {
+        pieces->SetPiecePriority(piece_index, priority);
+    }
+}
+
+void TorrentClient::BeginStartup() {
+    startup_begin = Clock::now();
+    startup_stages = 0;
+    fetching_metadata = false;
+}
+
+void TorrentClient::MarkStartupStage(StartupStage stage, const std::string& detail) {
+    uint32_t bit = 1u << static_cast<uint32_t>(stage);
+    if (startup_stages.fetch_or(bit) & bit) {
+        return;
+    }
+
+    static constexpr std::array<std::string_view, 8> kStageNames = {
+        "torrent loaded",
+        "announce started",
+        "storage ready",
+        "first tracker answer",
+        "first peer",
+        "first connection attempt",
+        "metadata received",
+        "first piece verified",
+    };
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - startup_begin);
+    std::string message = "Startup +" + std::to_string(elapsed.count()) + " ms: ";
+    if (fetching_metadata) {
+        message += "metadata fetch, ";
+    }
+    message += kStageNames[static_cast<size_t>(stage)];
+    if (!detail.empty()) {
+        message += " (" + detail + ")";
+    }
+    AddLogMessage(message);
 }
 
 void TorrentClient::AddLogMessage(const std::string& message) {
@@ -512,21 +926,18 @@ void TorrentClient::UpdateTaskFromPieceStorage(
     current_task.UpdateFromPieceStorage(storage, new_piece_length);
 
     std::unordered_set<std::string> unique_active_peers;
-    for (const auto& peer_connection_ptr : peer_connections) {
-        if (!peer_connection_ptr->IsTerminated()) {
-            unique_active_peers.insert(peer_connection_ptr->GetPeerId());
+    {
+        std::lock_guard<std::mutex> connections_lock(connections_mutex);
+        for (const auto& peer_connection_ptr : peer_connections) {
+            if (!peer_connection_ptr->IsTerminated()) {
+                unique_active_peers.insert(peer_connection_ptr->GetPeerId());
+            }
         }
     }
     current_task.SetConnectedPeers(unique_active_peers.size());
     current_task.last_update = std::chrono::system_clock::now();
 }
 
-void TorrentClient::UpdateTaskFromTracker(const HttpTracker& tracker) {
-    std::lock_guard<std::mutex> lock(task_mutex);
-    current_task.total_peers_count = tracker.GetPeers().size();
-    current_task.last_update = std::chrono::system_clock::now();
-}
-
 void TorrentClient::PauseDownload() {
     is_paused = true;
     UpdateTaskStatus(TorrentStatus::kPaused);
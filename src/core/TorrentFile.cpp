@@ -1,51 +1,239 @@
 #include "core/TorrentFile.hpp"
 
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <string_view>
 #include <vector>
 
-#include <openssl/sha.h>
+#include "utils/BencodeDocument.hpp"
+#include "utils/Sha256.hpp"
+#include "utils/byte_tools.hpp"
 
-#include "utils/BencodeParser.hpp"
+namespace {
 
-TorrentFile LoadTorrentFile(const std::string& filename) {
-    TorrentFile result;
+constexpr size_t kMerkleBlockSize = 16 * 1024;
 
-    utils::BencodeParser bencode_parser;
-    auto res = bencode_parser.ParseFromFile(filename);
+std::string JoinPath(const utils::BencodeDocument::Value& path) {
+    std::string result;
+    for (size_t i = 0; i < path.Size(); ++i) {
+        if (i > 0) {
+            result += '/';
+        }
+        result += path[i].AsString();
+    }
+    return result;
+}
 
-    for (size_t i = 0; i < res.size(); ++i) {
-        if (res[i] == "announce") {
-            ++i;
-            result.announce = res[i];
-            continue;
+// Files of a v2 "file tree" in tree order; a file is a dictionary whose
+// only key is the empty string.
+void CollectFileTree(
+    const utils::BencodeDocument::Value& tree,
+    const std::string& prefix,
+    std::vector<TorrentFile::File>& files
+) {
+    for (size_t i = 0; i < tree.Size(); ++i) {
+        auto entry = tree[i];
+        std::string path = prefix.empty()
+            ? std::string(entry.Key())
+            : prefix + '/' + std::string(entry.Key());
+
+        auto file = entry.Find("");
+        if (file.IsDict()) {
+            files.push_back(TorrentFile::File{
+                path,
+                static_cast<size_t>(file.Find("length").AsInteger()),
+                0,
+                std::string(file.Find("pieces root").StringOr(""))
+            });
+        } else if (entry.IsDict()) {
+            CollectFileTree(entry, path, files);
         }
+    }
+}
+
+utils::Sha256Digest ToDigest(std::string_view bytes) {
+    utils::Sha256Digest digest;
+    std::memcpy(digest.data(), bytes.data(), digest.size());
+    return digest;
+}
+
+PieceLayers BuildPieceLayers(
+    const TorrentFile& torrent,
+    const utils::BencodeDocument::Value& layers
+) {
+    const size_t piece_length = torrent.piece_length;
+    if (piece_length < kMerkleBlockSize || (piece_length & (piece_length - 1)) != 0) {
+        throw std::runtime_error("v2 piece length must be a power of two of at least 16 KiB");
+    }
+    const size_t leaves_per_piece = piece_length / kMerkleBlockSize;
+    const auto piece_pad = utils::PadDigest(leaves_per_piece);
 
-        if (res[i] == "comment") {
-            ++i;
-            result.comment = res[i];
+    std::vector<PieceLayers::Entry> entries(torrent.PieceCount(), PieceLayers::Entry{});
+    for (size_t file_index = 0; file_index < torrent.files.size(); ++file_index) {
+        const auto& file = torrent.files[file_index];
+        if (file.pieces_root.empty() || file.length == 0) {
             continue;
         }
+        if (file.pieces_root.size() != sizeof(utils::Sha256Digest)) {
+            throw std::runtime_error("Invalid pieces root for " + file.path);
+        }
+        if (file.offset % piece_length != 0) {
+            throw std::runtime_error(file.path + " does not start on a piece boundary");
+        }
 
-        if (res[i] == "piece length") {
-            ++i;
-            result.piece_length = std::stol(res[i]);
-            continue;
+        size_t first_piece = file.offset / piece_length;
+        size_t piece_count = (file.length + piece_length - 1) / piece_length;
+        if (first_piece + piece_count > entries.size()) {
+            throw std::runtime_error(file.path + " extends past the last piece");
         }
 
-        if (res[i] == "length") {
-            ++i;
-            result.length = std::stol(res[i]);
+        auto root = ToDigest(file.pieces_root);
+        if (piece_count == 1) {
+            entries[first_piece] = PieceLayers::Entry{
+                root,
+                static_cast<uint32_t>(file_index),
+                0,
+                static_cast<uint32_t>(utils::NextPowerOfTwo(
+                    (file.length + kMerkleBlockSize - 1) / kMerkleBlockSize
+                )),
+                static_cast<uint32_t>(file.length)
+            };
             continue;
         }
 
-        if (res[i] == "name") {
-            ++i;
-            result.name = res[i];
-            continue;
+        auto layer = layers.Find(file.pieces_root).StringOr("");
+        if (layer.size() != piece_count * sizeof(utils::Sha256Digest)) {
+            throw std::runtime_error("Missing or truncated piece layer for " + file.path);
+        }
+
+        std::vector<utils::Sha256Digest> hashes(piece_count);
+        std::memcpy(hashes.data(), layer.data(), layer.size());
+        if (utils::MerkleRoot(hashes, utils::NextPowerOfTwo(piece_count), piece_pad) != root) {
+            throw std::runtime_error("Piece layer of " + file.path + " does not match its root");
+        }
+
+        for (size_t i = 0; i < piece_count; ++i) {
+            entries[first_piece + i] = PieceLayers::Entry{
+                hashes[i],
+                static_cast<uint32_t>(file_index),
+                static_cast<uint32_t>(i * leaves_per_piece),
+                static_cast<uint32_t>(leaves_per_piece),
+                static_cast<uint32_t>(std::min(piece_length, file.length - i * piece_length))
+            };
         }
     }
 
-    result.info_hash = bencode_parser.GetInfoHash();
-    result.piece_hashes = bencode_parser.GetPieceHashes();
-    return result;
+    return PieceLayers(std::move(entries));
+}
+
+void LoadV1Layout(const utils::BencodeDocument::Value& info, TorrentFile& result) {
+    auto files = info.Find("files");
+    if (files.IsList()) {
+        // Multi-file torrents are stored as one contiguous blob, files
+        // only describe which ranges belong together.
+        size_t offset = 0;
+        for (size_t i = 0; i < files.Size(); ++i) {
+            size_t file_length = files[i].Find("length").AsInteger();
+            result.files.push_back(TorrentFile::File{
+                JoinPath(files[i].Find("path")),
+                file_length,
+                offset,
+                ""
+            });
+            offset += file_length;
+        }
+        result.length = offset;
+    } else {
+        result.length = info.Find("length").AsInteger();
+        result.files.push_back(TorrentFile::File{result.name, result.length, 0, ""});
+    }
+
+    result.piece_hashes = PieceHashes(info.Find("pieces").AsString());
+    result.info_hash = utils::CalculateSha1(info.Raw());
 }
 
+void LoadV2Layout(
+    const utils::BencodeDocument::Value& info,
+    std::vector<TorrentFile::File> tree_files,
+    TorrentFile& result
+) {
+    size_t offset = 0;
+    result.length = 0;
+    for (auto& file : tree_files) {
+        file.offset = offset;
+        if (file.length > 0) {
+            result.length = offset + file.length;
+            offset += (file.length + result.piece_length - 1)
+                / result.piece_length * result.piece_length;
+        }
+    }
+    result.files = std::move(tree_files);
+
+    auto digest = utils::Sha256(info.Raw());
+    result.info_hash.assign(digest.data(), 20);
+}
+
+} // namespace
+
+size_t TorrentFile::PieceCount() const {
+    if (!piece_hashes.Empty() || piece_length == 0) {
+        return piece_hashes.Size();
+    }
+    return (length + piece_length - 1) / piece_length;
+}
+
+TorrentFile LoadTorrentFile(const std::string& filename) {
+    TorrentFile result;
+
+    auto document = utils::BencodeDocument::FromFile(filename);
+    auto root = document.Root();
+    auto info = root.Find("info");
+    if (!info.IsDict()) {
+        throw std::runtime_error("No info dictionary in " + filename);
+    }
+
+    result.announce = root.Find("announce").StringOr("");
+    result.comment = root.Find("comment").StringOr("");
+
+    auto tiers = root.Find("announce-list");
+    for (size_t i = 0; tiers.IsList() && i < tiers.Size(); ++i) {
+        for (size_t j = 0; tiers[i].IsList() && j < tiers[i].Size(); ++j) {
+            result.announce_list.emplace_back(tiers[i][j].StringOr(""));
+        }
+    }
+
+    result.name = info.Find("name").AsString();
+    result.piece_length = info.Find("piece length").AsInteger();
+    result.meta_version = info.Find("meta version").IntegerOr(1);
+
+    bool has_v1 = info.Find("pieces").IsString();
+    if (result.meta_version < 2) {
+        LoadV1Layout(info, result);
+        return result;
+    }
+
+    std::vector<TorrentFile::File> tree_files;
+    CollectFileTree(info.Find("file tree"), "", tree_files);
+
+    if (has_v1) {
+        // Hybrid: v1 files include pad files, so every v2 file already
+        // starts on a piece boundary of the v1 layout.
+        LoadV1Layout(info, result);
+        std::map<std::string, std::string> roots;
+        for (auto& file : tree_files) {
+            roots[file.path] = std::move(file.pieces_root);
+        }
+        for (auto& file : result.files) {
+            if (auto it = roots.find(file.path); it != roots.end()) {
+                file.pieces_root = it->second;
+            }
+        }
+    } else {
+        LoadV2Layout(info, std::move(tree_files), result);
+    }
+
+    result.piece_layers = BuildPieceLayers(result, root.Find("piece layers"));
+    return result;
+}
@@ -60,6 +60,8 @@ std::string TorrentTask::GetStatusString() const {
         return "Error";
     case TorrentStatus::kConnected:
         return "Connecting";
+    case TorrentStatus::kFetchingMetadata:
+        return "Fetching Metadata";
     default:
         return "Unknown";
     
@@ -79,12 +81,17 @@ void TorrentTask::UpdateFromPieceStorage(
     total_pieces_count = storage.TotalPiecesCount();
     downloaded_pieces_count = storage.PiecesSavedToDiscCount();
     missing_pieces = storage.GetMissingPieces();
+    size_t wanted_pieces_count = storage.WantedPiecesCount();
     
     if (total_pieces_count > 0) {
-        progress = (
-            static_cast<double>(downloaded_pieces_count)
-            / total_pieces_count
-        ) * 100.0;
+        if (wanted_pieces_count > 0) {
+            progress = (
+                static_cast<double>(wanted_pieces_count - missing_pieces.size())
+                / wanted_pieces_count
+            ) * 100.0;
+        } else {
+            progress = 100.0;
+        }
 
         downloaded = downloaded_pieces_count * default_piece_length;
         
@@ -0,0 +1,584 @@
+#include "core/TrackerAnnouncer.hpp"
+
+#include <arpa/inet.h>
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <tuple>
+
+#include "core/HttpTracker.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct HttpAnnounce {
+    std::string url;
+    std::string host;
+    std::string port;
+    CURL* handle = nullptr;
+    curl_slist* resolve = nullptr;
+    std::unique_ptr<utils::BencodeHandler> reader;
+    std::unique_ptr<utils::BencodeStreamParser> parser;
+    std::function<void(std::chrono::milliseconds)> report;
+    // Why the body was rejected while it arrived.
+    std::string body_error;
+    bool added = false;
+    bool done = false;
+};
+
+struct UdpAnnounce {
+    std::string url;
+    int port = 0;
+    uint64_t announce_id = 0;
+    bool started = false;
+    bool done = false;
+};
+
+// Hands results over from the resolver and engine threads. Shared with the
+// callbacks so that late answers after a round returned are harmless.
+struct Inbox {
+    std::mutex mutex;
+    CURLM* multi = nullptr;
+    std::vector<std::pair<size_t, DnsResolver::Result>> http_resolved;
+    std::vector<std::pair<size_t, DnsResolver::Result>> udp_resolved;
+    // Reports of finished UDP requests, run on the round's thread.
+    std::vector<std::pair<size_t, std::function<void()>>> udp_results;
+};
+
+void Deliver(Inbox& inbox, const std::function<void(Inbox&)>& store) {
+    std::lock_guard<std::mutex> lock(inbox.mutex);
+    store(inbox);
+    if (inbox.multi) {
+        curl_multi_wakeup(inbox.multi);
+    }
+}
+
+// Feeds the body to the tracker's reader as it arrives. Returning less than
+// was handed over makes curl abort the transfer.
+size_t ReadBody(char* data, size_t size, size_t count, void* target) {
+    auto& announce = *static_cast<HttpAnnounce*>(target);
+    long status = 0;
+    curl_easy_getinfo(announce.handle, CURLINFO_RESPONSE_CODE, &status);
+    if (status != 200) {
+        // Error pages are not bencoded, the status is reported instead.
+        return size * count;
+    }
+
+    try {
+        std::string_view chunk(data, size * count);
+        if (announce.parser->Feed(chunk) != chunk.size()) {
+            throw std::runtime_error("Data after the end of the tracker response");
+        }
+    } catch (const std::exception& error) {
+        announce.body_error = error.what();
+        return 0;
+    }
+    return size * count;
+}
+
+std::string Escape(CURL* handle, const std::string& bytes) {
+    char* escaped = curl_easy_escape(handle, bytes.data(), bytes.size());
+    std::string result(escaped);
+    curl_free(escaped);
+    return result;
+}
+
+std::string EventParameter(TrackerEvent event) {
+    switch (event) {
+    case TrackerEvent::kStarted:
+        return "&event=started";
+    case TrackerEvent::kCompleted:
+        return "&event=completed";
+    case TrackerEvent::kStopped:
+        return "&event=stopped";
+    default:
+        return "";
+    }
+}
+
+std::string HttpAnnounceUrl(
+    CURL* handle,
+    const std::string& url,
+    const AnnounceParams& params
+) {
+    return url
+        + (url.find('?') == std::string::npos ? "?" : "&")
+        + "info_hash=" + Escape(handle, params.info_hash)
+        + "&peer_id=" + Escape(handle, params.peer_id)
+        + "&port=" + std::to_string(params.port)
+        + "&uploaded=" + std::to_string(params.uploaded)
+        + "&downloaded=" + std::to_string(params.downloaded)
+        + "&left=" + std::to_string(params.left)
+        + "&compact=1"
+        + EventParameter(params.event);
+}
+
+// Host and port of an HTTP(S) URL. The host is empty when it is an address
+// literal or the URL does not parse, leaving the lookup to curl.
+std::pair<std::string, std::string> HttpHost(const std::string& url) {
+    CURLU* parsed = curl_url();
+    char* host = nullptr;
+    char* port = nullptr;
+
+    std::pair<std::string, std::string> result;
+    if (
+        curl_url_set(parsed, CURLUPART_URL, url.c_str(), 0) == CURLUE_OK
+        && curl_url_get(parsed, CURLUPART_HOST, &host, 0) == CURLUE_OK
+        && curl_url_get(parsed, CURLUPART_PORT, &port, CURLU_DEFAULT_PORT) == CURLUE_OK
+    ) {
+        in_addr ipv4;
+        if (host[0] != '[' && inet_pton(AF_INET, host, &ipv4) != 1) {
+            result = { host, port };
+        }
+    }
+
+    curl_free(host);
+    curl_free(port);
+    curl_url_cleanup(parsed);
+    return result;
+}
+
+std::string FormatAddress(const sockaddr_storage& address) {
+    char text[INET6_ADDRSTRLEN] = {};
+    if (address.ss_family == AF_INET) {
+        const auto& ipv4 = reinterpret_cast<const sockaddr_in&>(address);
+        inet_ntop(AF_INET, &ipv4.sin_addr, text, sizeof(text));
+        return text;
+    }
+
+    const auto& ipv6 = reinterpret_cast<const sockaddr_in6&>(address);
+    inet_ntop(AF_INET6, &ipv6.sin6_addr, text, sizeof(text));
+    return "[" + std::string(text) + "]";
+}
+
+// Prefers IPv4, which more trackers answer on.
+UdpEndpoint ChooseEndpoint(const DnsResolver::Result& resolved, int port) {
+    auto chosen = std::find_if(
+        resolved.addresses.begin(),
+        resolved.addresses.end(),
+        [](const sockaddr_storage& address) { return address.ss_family == AF_INET; }
+    );
+    if (chosen == resolved.addresses.end()) {
+        chosen = resolved.addresses.begin();
+    }
+
+    UdpEndpoint endpoint;
+    endpoint.address = *chosen;
+    if (chosen->ss_family == AF_INET) {
+        endpoint.length = sizeof(sockaddr_in);
+        reinterpret_cast<sockaddr_in&>(endpoint.address).sin_port = htons(port);
+    } else {
+        endpoint.length = sizeof(sockaddr_in6);
+        reinterpret_cast<sockaddr_in6&>(endpoint.address).sin6_port = htons(port);
+    }
+    return endpoint;
+}
+
+} // namespace
+
+TrackerAnnouncer::TrackerAnnouncer(
+    UdpTrackerEngine& udp_engine,
+    DnsResolver& resolver,
+    CurlShare& curl_share
+) :
+    udp_engine(udp_engine),
+    resolver(resolver),
+    curl_share(curl_share)
+{
+    multi = curl_multi_init();
+    if (!multi) {
+        throw std::runtime_error("Failed to create curl multi handle");
+    }
+
+    // Idle connections outlive the round, so the next announce to the same
+    // tracker skips the TCP and TLS handshakes.
+    curl_multi_setopt(multi, CURLMOPT_MAXCONNECTS, kMaxIdleConnections);
+}
+
+TrackerAnnouncer::~TrackerAnnouncer() {
+    curl_multi_cleanup(multi);
+}
+
+void TrackerAnnouncer::AnnounceAll(
+    const std::vector<std::string>& urls,
+    const AnnounceParams& params,
+    const std::atomic<bool>& stop,
+    const ResultCallback& on_result,
+    std::optional<std::chrono::milliseconds> timeout
+) {
+    UdpTrackerEngine::AnnounceRequest udp_request;
+    udp_request.info_hash = params.info_hash;
+    udp_request.peer_id = params.peer_id;
+    udp_request.downloaded = params.downloaded;
+    udp_request.left = params.left;
+    udp_request.uploaded = params.uploaded;
+    udp_request.event = static_cast<int>(params.event);
+    udp_request.port = params.port;
+
+    RoundHandlers handlers;
+    handlers.http_url = [&params](CURL* handle, const std::string& url) {
+        return HttpAnnounceUrl(handle, url, params);
+    };
+    handlers.http_reader = [&on_result](const std::string& url) {
+        auto reader = std::make_unique<HttpTracker::AnnounceReader>();
+        auto report = [&on_result, &response = *reader, url](
+            std::chrono::milliseconds latency
+        ) {
+            response.CheckFailure();
+            on_result({
+                url,
+                response.GetPeers(),
+                std::chrono::seconds(response.GetInterval()),
+                std::chrono::seconds(response.GetMinInterval()),
+                latency,
+                ""
+            });
+        };
+        return HttpReader{ std::move(reader), report };
+    };
+    handlers.start_udp = [this, &udp_request, &on_result](
+        const std::string& url,
+        const UdpEndpoint& endpoint,
+        Delivery deliver
+    ) {
+        auto sent = Clock::now();
+        return udp_engine.Announce(
+            endpoint,
+            udp_request,
+            [&on_result, url, sent, deliver](UdpTrackerEngine::AnnounceResult result) {
+                auto latency = std::chrono::ceil<std::chrono::milliseconds>(Clock::now() - sent);
+                deliver([&on_result, url, latency, result = std::move(result)] {
+                    on_result({
+                        url,
+                        result.response.peers,
+                        std::chrono::seconds(result.error.empty() ? result.response.interval : 0),
+                        std::chrono::seconds(0),
+                        latency,
+                        result.error
+                    });
+                });
+            }
+        );
+    };
+    handlers.on_error = [&on_result](
+        const std::string& url,
+        const std::string& error,
+        std::chrono::milliseconds latency
+    ) {
+        on_result({ url, {}, std::chrono::seconds(0), std::chrono::seconds(0), latency, error });
+    };
+
+    RunRound(urls, stop, handlers, timeout.value_or(RoundBudget()), timeout.has_value());
+}
+
+void TrackerAnnouncer::ScrapeAll(
+    const std::vector<std::string>& urls,
+    const std::vector<std::string>& info_hashes,
+    const std::atomic<bool>& stop,
+    const ScrapeCallback& on_result,
+    std::optional<std::chrono::milliseconds> timeout
+) {
+    if (info_hashes.empty() || info_hashes.size() > UdpTracker::kMaxScrapeHashes) {
+        throw std::runtime_error(
+            "Scrape takes 1 to " + std::to_string(UdpTracker::kMaxScrapeHashes) + " info-hashes"
+        );
+    }
+
+    RoundHandlers handlers;
+    handlers.http_url = [&info_hashes](CURL* handle, const std::string& url) {
+        std::string scrape_url = HttpTracker::ScrapeUrl(url);
+        for (const auto& info_hash : info_hashes) {
+            scrape_url += (scrape_url.find('?') == std::string::npos ? "?" : "&");
+            scrape_url += "info_hash=" + Escape(handle, info_hash);
+        }
+        return scrape_url;
+    };
+    handlers.http_reader = [&info_hashes, &on_result](const std::string& url) {
+        auto reader = std::make_unique<HttpTracker::ScrapeReader>(info_hashes);
+        auto report = [&on_result, &response = *reader, url](
+            std::chrono::milliseconds latency
+        ) {
+            on_result({ url, response.GetStats(), latency, "" });
+        };
+        return HttpReader{ std::move(reader), report };
+    };
+    handlers.start_udp = [this, &info_hashes, &on_result](
+        const std::string& url,
+        const UdpEndpoint& endpoint,
+        Delivery deliver
+    ) {
+        auto sent = Clock::now();
+        return udp_engine.Scrape(
+            endpoint,
+            info_hashes,
+            [&on_result, url, sent, deliver](UdpTrackerEngine::ScrapeResult result) {
+                auto latency = std::chrono::ceil<std::chrono::milliseconds>(Clock::now() - sent);
+                deliver([&on_result, url, latency, result = std::move(result)] {
+                    on_result({ url, result.stats, latency, result.error });
+                });
+            }
+        );
+    };
+    handlers.on_error = [&on_result](
+        const std::string& url,
+        const std::string& error,
+        std::chrono::milliseconds latency
+    ) {
+        on_result({ url, {}, latency, error });
+    };
+
+    RunRound(urls, stop, handlers, timeout.value_or(RoundBudget()), timeout.has_value());
+}
+
+std::chrono::milliseconds TrackerAnnouncer::RoundBudget() const {
+    return std::max(kHttpTimeout, udp_engine.RequestBudget()) + kLookupAllowance;
+}
+
+void TrackerAnnouncer::RunRound(
+    const std::vector<std::string>& urls,
+    const std::atomic<bool>& stop,
+    const RoundHandlers& handlers,
+    std::chrono::milliseconds timeout,
+    bool wait_for_all
+) {
+    std::vector<std::unique_ptr<HttpAnnounce>> http;
+    std::vector<std::unique_ptr<UdpAnnounce>> udp;
+    size_t pending = 0;
+
+    auto round_start = Clock::now();
+    auto fail = [&](const std::string& url, const std::string& error) {
+        --pending;
+        handlers.on_error(
+            url,
+            error,
+            std::chrono::ceil<std::chrono::milliseconds>(Clock::now() - round_start)
+        );
+    };
+
+    auto inbox = std::make_shared<Inbox>();
+    inbox->multi = multi;
+
+    for (const auto& url : urls) {
+        if (HttpTracker::IsUdpTracker(url)) {
+            ++pending;
+            try {
+                auto [host, port] = HttpTracker::ParseUdpUrl(url);
+                auto announce = std::make_unique<UdpAnnounce>();
+                announce->url = url;
+                announce->port = port;
+                udp.push_back(std::move(announce));
+
+                resolver.Resolve(host, [inbox, index = udp.size() - 1](const auto& resolved) {
+                    Deliver(*inbox, [&](Inbox& box) {
+                        box.udp_resolved.emplace_back(index, resolved);
+                    });
+                });
+            } catch (const std::exception& error) {
+                fail(url, error.what());
+            }
+            continue;
+        }
+
+        auto announce = std::make_unique<HttpAnnounce>();
+        announce->url = url;
+        announce->handle = curl_easy_init();
+        if (!announce->handle) {
+            continue;
+        }
+        ++pending;
+
+        CURL* handle = announce->handle;
+        std::string request_url;
+        try {
+            request_url = handlers.http_url(handle, url);
+        } catch (const std::exception& error) {
+            curl_easy_cleanup(handle);
+            fail(url, error.what());
+            continue;
+        }
+
+        auto reader = handlers.http_reader(url);
+        announce->reader = std::move(reader.handler);
+        announce->report = std::move(reader.report);
+        announce->parser = std::make_unique<utils::BencodeStreamParser>(*announce->reader);
+
+        curl_easy_setopt(handle, CURLOPT_URL, request_url.c_str());
+        curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, ReadBody);
+        curl_easy_setopt(handle, CURLOPT_WRITEDATA, announce.get());
+        curl_easy_setopt(handle, CURLOPT_PRIVATE, announce.get());
+        curl_easy_setopt(handle, CURLOPT_TIMEOUT_MS, static_cast<long>(kHttpTimeout.count()));
+        curl_easy_setopt(
+            handle,
+            CURLOPT_CONNECTTIMEOUT_MS,
+            static_cast<long>(kHttpConnectTimeout.count())
+        );
+        curl_easy_setopt(handle, CURLOPT_FOLLOWLOCATION, 1L);
+        curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1L);
+        curl_share.Attach(handle);
+        std::tie(announce->host, announce->port) = HttpHost(url);
+        http.push_back(std::move(announce));
+
+        // curl is handed the shared resolver's answer instead of looking the
+        // host up again on its own.
+        if (http.back()->host.empty()) {
+            curl_multi_add_handle(multi, handle);
+            http.back()->added = true;
+            continue;
+        }
+        resolver.Resolve(http.back()->host, [inbox, index = http.size() - 1](const auto& resolved) {
+            Deliver(*inbox, [&](Inbox& box) {
+                box.http_resolved.emplace_back(index, resolved);
+            });
+        });
+    }
+
+    auto round_deadline = round_start + timeout;
+    auto http_pending = [&http] {
+        return std::any_of(http.begin(), http.end(), [](const auto& announce) {
+            return !announce->done;
+        });
+    };
+    std::optional<Clock::time_point> udp_grace_end;
+
+    while (pending > 0 && !stop && Clock::now() < round_deadline) {
+        if (udp_grace_end && Clock::now() >= *udp_grace_end && !http_pending()) {
+            break;
+        }
+
+        std::vector<std::pair<size_t, DnsResolver::Result>> http_resolved;
+        std::vector<std::pair<size_t, DnsResolver::Result>> udp_resolved;
+        std::vector<std::pair<size_t, std::function<void()>>> udp_results;
+        {
+            std::lock_guard<std::mutex> lock(inbox->mutex);
+            http_resolved.swap(inbox->http_resolved);
+            udp_resolved.swap(inbox->udp_resolved);
+            udp_results.swap(inbox->udp_results);
+        }
+
+        for (auto& [index, resolved] : http_resolved) {
+            auto& announce = *http[index];
+            if (!resolved.error.empty()) {
+                announce.done = true;
+                fail(announce.url, resolved.error);
+                continue;
+            }
+
+            std::string addresses;
+            for (const auto& address : resolved.addresses) {
+                addresses += (addresses.empty() ? "" : ",") + FormatAddress(address);
+            }
+            announce.resolve = curl_slist_append(
+                nullptr,
+                (announce.host + ":" + announce.port + ":" + addresses).c_str()
+            );
+            curl_easy_setopt(announce.handle, CURLOPT_RESOLVE, announce.resolve);
+            curl_multi_add_handle(multi, announce.handle);
+            announce.added = true;
+        }
+
+        for (auto& [index, resolved] : udp_resolved) {
+            auto& announce = *udp[index];
+            if (!resolved.error.empty()) {
+                announce.done = true;
+                fail(announce.url, resolved.error);
+                continue;
+            }
+
+            try {
+                announce.announce_id = handlers.start_udp(
+                    announce.url,
+                    ChooseEndpoint(resolved, announce.port),
+                    [inbox, index](std::function<void()> report) {
+                        Deliver(*inbox, [&](Inbox& box) {
+                            box.udp_results.emplace_back(index, std::move(report));
+                        });
+                    }
+                );
+                announce.started = true;
+            } catch (const std::exception& error) {
+                announce.done = true;
+                fail(announce.url, error.what());
+            }
+        }
+
+        for (auto& [index, report] : udp_results) {
+            udp[index]->done = true;
+            --pending;
+            report();
+        }
+        if (!wait_for_all && !udp_results.empty() && !udp_grace_end) {
+            udp_grace_end = Clock::now() + kUdpGrace;
+        }
+
+        if (pending == 0) {
+            break;
+        }
+
+        curl_multi_poll(multi, nullptr, 0, static_cast<int>(kPollInterval.count()), nullptr);
+
+        int running = 0;
+        curl_multi_perform(multi, &running);
+
+        int queued = 0;
+        while (CURLMsg* message = curl_multi_info_read(multi, &queued)) {
+            if (message->msg != CURLMSG_DONE) {
+                continue;
+            }
+
+            HttpAnnounce* announce = nullptr;
+            curl_easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, &announce);
+            long status = 0;
+            curl_easy_getinfo(message->easy_handle, CURLINFO_RESPONSE_CODE, &status);
+            announce->done = true;
+
+            if (!announce->body_error.empty()) {
+                fail(announce->url, announce->body_error);
+            } else if (message->data.result != CURLE_OK) {
+                fail(announce->url, curl_easy_strerror(message->data.result));
+            } else if (status != 200) {
+                fail(announce->url, "HTTP " + std::to_string(status));
+            } else {
+                curl_off_t total_time = 0;
+                curl_easy_getinfo(message->easy_handle, CURLINFO_TOTAL_TIME_T, &total_time);
+                auto latency = std::chrono::ceil<std::chrono::milliseconds>(
+                    std::chrono::microseconds(total_time)
+                );
+
+                --pending;
+                try {
+                    announce->parser->Finish();
+                    announce->report(latency);
+                } catch (const std::exception& error) {
+                    handlers.on_error(announce->url, error.what(), latency);
+                }
+            }
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(inbox->mutex);
+        inbox->multi = nullptr;
+    }
+
+    for (auto& announce : http) {
+        if (announce->added) {
+            curl_multi_remove_handle(multi, announce->handle);
+        }
+        curl_easy_cleanup(announce->handle);
+        curl_slist_free_all(announce->resolve);
+        if (!announce->done && !stop) {
+            fail(announce->url, "Tracker timed out");
+        }
+    }
+    for (auto& announce : udp) {
+        if (announce->started && !announce->done) {
+            udp_engine.Cancel(announce->announce_id);
+        }
+        if (!announce->done && !stop) {
+            fail(announce->url, "Tracker timed out");
+        }
+    }
+}
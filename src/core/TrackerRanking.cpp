@@ -0,0 +1,109 @@
+#include "core/TrackerRanking.hpp"
+
+#include <algorithm>
+#include <bit>
+
+namespace {
+
+// Latency is smoothed so one slow answer does not reorder the trackers.
+std::chrono::milliseconds Smooth(
+    std::chrono::milliseconds average,
+    std::chrono::milliseconds sample,
+    bool first
+) {
+    return first ? sample : (average * 3 + sample) / 4;
+}
+
+} // namespace
+
+void TrackerRanking::RecordAnnounce(const AnnounceResult& result) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& health = trackers[result.url];
+
+    if (!result.error.empty()) {
+        ++health.failures;
+        return;
+    }
+
+    health.latency = Smooth(health.latency, result.latency, !health.answered);
+    health.answered = true;
+    health.failures = 0;
+    health.announced_peers = result.peers.size();
+}
+
+void TrackerRanking::RecordScrape(const ScrapeResult& result) {
+    if (!result.error.empty()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& health = trackers[result.url];
+    health.seeders = 0;
+    health.leechers = 0;
+    for (const auto& stats : result.stats) {
+        health.seeders += stats.seeders;
+        health.leechers += stats.leechers;
+    }
+    health.scraped = true;
+
+    health.latency = Smooth(health.latency, result.latency, !health.answered);
+    health.answered = true;
+}
+
+std::vector<std::string> TrackerRanking::Rank(const std::vector<std::string>& urls) const {
+    struct Entry {
+        const std::string* url;
+        int tier;
+        int swarm_class;
+        std::chrono::milliseconds latency;
+    };
+
+    std::vector<Entry> entries;
+    entries.reserve(urls.size());
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& url : urls) {
+            auto found = trackers.find(url);
+            const Health* health = found == trackers.end() ? nullptr : &found->second;
+            entries.push_back({
+                &url,
+                Tier(health),
+                health ? SwarmClass(*health) : 0,
+                health ? health->latency : std::chrono::milliseconds(0)
+            });
+        }
+    }
+
+    std::stable_sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        if (a.tier != b.tier) {
+            return a.tier < b.tier;
+        }
+        if (a.swarm_class != b.swarm_class) {
+            return a.swarm_class > b.swarm_class;
+        }
+        return a.latency < b.latency;
+    });
+
+    std::vector<std::string> ranked;
+    ranked.reserve(entries.size());
+    for (const auto& entry : entries) {
+        ranked.push_back(*entry.url);
+    }
+    return ranked;
+}
+
+int TrackerRanking::Tier(const Health* health) {
+    if (!health || (!health->answered && health->failures == 0)) {
+        return 1;
+    }
+    return health->failures == 0 ? 0 : 2;
+}
+
+int TrackerRanking::SwarmClass(const Health& health) {
+    // Seeders count double, they can serve every piece. Swarms within a
+    // factor of two share a class, so the faster tracker of the two wins.
+    uint64_t size = health.scraped
+        ? health.seeders * 2 + health.leechers
+        : health.announced_peers;
+    return std::bit_width(size);
+}
@@ -5,48 +5,9 @@
 
 #include "utils/byte_tools.hpp"
 
-UdpTracker::UdpTracker(
-    const std::string& host,
-    int port,
-    int timeout_sec
-) :
-    host(host),
-    port(port),
-    timeout_sec(timeout_sec),
-    udp_client(host, port, timeout_sec)
-{}
-
-UdpTracker::TrackerResponse UdpTracker::Announce(
-    const std::string& info_hash,
-    const std::string& peer_id,
-    uint64_t downloaded,
-    uint64_t left,
-    uint64_t uploaded,
-    int event,
-    int num_want,
-    uint16_t port
-) {
-    uint64_t connection_id = Connect();
-
-    return AnnounceWithConnection(
-        connection_id,
-        info_hash,
-        peer_id,
-        downloaded,
-        left,
-        uploaded,
-        event,
-        num_want,
-        port
-    );
-}
-
-uint64_t UdpTracker::Connect() {
+std::string UdpTracker::ConnectRequest(uint32_t transaction_id) {
     uint64_t protocol_id = 0x41727101980;
     uint32_t action = 0; // connect = 0
-    uint32_t transaction_id = utils::BytesToInt32(
-        utils::Int32ToBytes(rand())
-    );
 
     std::string request;
     request.reserve(16);
@@ -54,9 +15,13 @@ uint64_t UdpTracker::Connect() {
     request += utils::Int64ToBytes(protocol_id);
     request += utils::Int32ToBytes(action);
     request += utils::Int32ToBytes(transaction_id);
+    return request;
+}
 
-    std::string response = udp_client.SendReceive(request);
-
+uint64_t UdpTracker::ParseConnectResponse(
+    std::string_view response,
+    uint32_t transaction_id
+) {
     if (response.size() < 16) {
         throw std::runtime_error(
             "CONNECT response too small: " +
@@ -78,13 +43,12 @@ uint64_t UdpTracker::Connect() {
         throw std::runtime_error("CONNECT transaction_id mismatch");
     }
 
-    uint64_t connection_id = utils::BytesToInt64(response.substr(8, 8));
-
-    return connection_id;
+    return utils::BytesToInt64(response.substr(8, 8));
 }
 
-UdpTracker::TrackerResponse UdpTracker::AnnounceWithConnection(
+std::string UdpTracker::AnnounceRequest(
     uint64_t connection_id,
+    uint32_t transaction_id,
     const std::string& info_hash,
     const std::string& peer_id,
     uint64_t downloaded,
@@ -102,9 +66,6 @@ UdpTracker::TrackerResponse UdpTracker::AnnounceWithConnection(
     }
 
     uint32_t action = 1; // announce
-    uint32_t transaction_id = utils::BytesToInt32(
-        utils::Int32ToBytes(rand())
-    );
 
     std::string request;
     request.reserve(98);
@@ -124,11 +85,17 @@ UdpTracker::TrackerResponse UdpTracker::AnnounceWithConnection(
     request += utils::Int32ToBytes(0); // IP = default
     request += utils::Int32ToBytes(rand()); // key
     request += utils::Int32ToBytes(num_want);
-    request += utils::Int32ToBytes(port << 16 | (port & 0xFFFF));
-
-    std::string response = udp_client.SendReceive(request);
+    request += static_cast<char>(port >> 8);
+    request += static_cast<char>(port & 0xFF);
+    return request;
+}
 
-    if (response.size() < 20) {
+UdpTracker::TrackerResponse UdpTracker::ParseAnnounceResponse(
+    std::string_view response,
+    uint32_t transaction_id,
+    int family
+) {
+    if (response.size() < 8) {
         throw std::runtime_error(
             "ANNOUNCE response too small: " +
             std::to_string(response.size())
@@ -139,10 +106,17 @@ UdpTracker::TrackerResponse UdpTracker::AnnounceWithConnection(
     uint32_t resp_trans  = utils::BytesToInt32(response.substr(4, 4));
 
     if (resp_action == 3) { // error
-        std::string err_msg = response.substr(8);
+        std::string err_msg(response.substr(8));
         throw std::runtime_error("Tracker error: " + err_msg);
     }
 
+    if (response.size() < 20) {
+        throw std::runtime_error(
+            "ANNOUNCE response too small: " +
+            std::to_string(response.size())
+        );
+    }
+
     if (resp_action != 1) {
         throw std::runtime_error(
             "ANNOUNCE failed: wrong action=" +
@@ -159,20 +133,87 @@ UdpTracker::TrackerResponse UdpTracker::AnnounceWithConnection(
     tracker_response.leechers = utils::BytesToInt32(response.substr(12, 4));
     tracker_response.seeders = utils::BytesToInt32(response.substr(16, 4));
 
+    size_t peer_size = family == AF_INET6 ? Peer::kCompactIpv6Size : Peer::kCompactIpv4Size;
     size_t offset = 20;
-    while (offset + 6 <= response.size()) {
-        TrackerPeer peer;
+    while (offset + peer_size <= response.size()) {
+        tracker_response.peers.push_back(Peer::FromCompact(response.substr(offset, peer_size)));
+        offset += peer_size;
+    }
 
-        peer.ip = utils::BytesToInt32(response.substr(offset, 4));
-        peer.port = static_cast<uint16_t>(
-            (static_cast<unsigned char>(response[offset + 4]) << 8) |
-            static_cast<unsigned char>(response[offset + 5])
-        );
+    return tracker_response;
+}
 
-        tracker_response.peers.push_back(peer);
-        offset += 6;
+std::string UdpTracker::ScrapeRequest(
+    uint64_t connection_id,
+    uint32_t transaction_id,
+    const std::vector<std::string>& info_hashes
+) {
+    if (info_hashes.empty() || info_hashes.size() > kMaxScrapeHashes) {
+        throw std::runtime_error(
+            "Scrape takes 1 to " + std::to_string(kMaxScrapeHashes) + " info-hashes"
+        );
     }
 
-    return tracker_response;
+    uint32_t action = 2; // scrape
+
+    std::string request;
+    request.reserve(16 + 20 * info_hashes.size());
+
+    request += utils::Int64ToBytes(connection_id);
+    request += utils::Int32ToBytes(action);
+    request += utils::Int32ToBytes(transaction_id);
+    for (const auto& info_hash : info_hashes) {
+        if (info_hash.size() != 20) {
+            throw std::runtime_error("Info_hash must be 20 bytes");
+        }
+        request += info_hash;
+    }
+    return request;
 }
 
+std::vector<UdpTracker::ScrapeStats> UdpTracker::ParseScrapeResponse(
+    std::string_view response,
+    uint32_t transaction_id,
+    size_t hash_count
+) {
+    if (response.size() < 8) {
+        throw std::runtime_error(
+            "SCRAPE response too small: " +
+            std::to_string(response.size())
+        );
+    }
+
+    uint32_t resp_action = utils::BytesToInt32(response.substr(0, 4));
+    uint32_t resp_trans = utils::BytesToInt32(response.substr(4, 4));
+
+    if (resp_action == 3) { // error
+        throw std::runtime_error("Tracker error: " + std::string(response.substr(8)));
+    }
+
+    if (resp_action != 2) {
+        throw std::runtime_error(
+            "SCRAPE failed: wrong action=" +
+            std::to_string(resp_action)
+        );
+    }
+
+    if (resp_trans != transaction_id) {
+        throw std::runtime_error("SCRAPE transaction_id mismatch");
+    }
+
+    if (response.size() < 8 + 12 * hash_count) {
+        throw std::runtime_error(
+            "SCRAPE response too small: " +
+            std::to_string(response.size())
+        );
+    }
+
+    std::vector<ScrapeStats> stats(hash_count);
+    for (size_t i = 0; i < hash_count; ++i) {
+        size_t offset = 8 + 12 * i;
+        stats[i].seeders = utils::BytesToInt32(response.substr(offset, 4));
+        stats[i].completed = utils::BytesToInt32(response.substr(offset + 4, 4));
+        stats[i].leechers = utils::BytesToInt32(response.substr(offset + 8, 4));
+    }
+    return stats;
+}
@@ -0,0 +1,460 @@
+#include "core/UdpTrackerEngine.hpp"
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+
+#include "utils/byte_tools.hpp"
+
+bool UdpEndpoint::operator==(const UdpEndpoint& other) const {
+    if (address.ss_family != other.address.ss_family) {
+        return false;
+    }
+
+    if (address.ss_family == AF_INET) {
+        const auto& a = reinterpret_cast<const sockaddr_in&>(address);
+        const auto& b = reinterpret_cast<const sockaddr_in&>(other.address);
+        return a.sin_port == b.sin_port && a.sin_addr.s_addr == b.sin_addr.s_addr;
+    }
+
+    const auto& a = reinterpret_cast<const sockaddr_in6&>(address);
+    const auto& b = reinterpret_cast<const sockaddr_in6&>(other.address);
+    return a.sin6_port == b.sin6_port
+        && std::memcmp(&a.sin6_addr, &b.sin6_addr, sizeof(a.sin6_addr)) == 0;
+}
+
+size_t UdpEndpointHash::operator()(const UdpEndpoint& endpoint) const {
+    std::string_view bytes;
+    if (endpoint.address.ss_family == AF_INET) {
+        const auto& address = reinterpret_cast<const sockaddr_in&>(endpoint.address);
+        bytes = { reinterpret_cast<const char*>(&address.sin_addr), sizeof(address.sin_addr) };
+    } else {
+        const auto& address = reinterpret_cast<const sockaddr_in6&>(endpoint.address);
+        bytes = { reinterpret_cast<const char*>(&address.sin6_addr), sizeof(address.sin6_addr) };
+    }
+
+    // Both families keep the port at the same offset.
+    uint16_t port = reinterpret_cast<const sockaddr_in&>(endpoint.address).sin_port;
+    return std::hash<std::string_view>{}(bytes) ^ (size_t(port) << 1);
+}
+
+UdpTrackerEngine& UdpTrackerEngine::Shared() {
+    static UdpTrackerEngine engine;
+    return engine;
+}
+
+UdpTrackerEngine::UdpTrackerEngine(const UdpTrackerOptions& options) :
+    options(options)
+{
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd < 0) {
+        throw std::runtime_error(
+            "Failed to create eventfd: " + std::string(strerror(errno))
+        );
+    }
+
+    // A missing address family only fails the trackers that need it.
+    ipv4_socket = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    ipv6_socket = socket(AF_INET6, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (ipv6_socket >= 0) {
+        int v6_only = 1;
+        setsockopt(ipv6_socket, IPPROTO_IPV6, IPV6_V6ONLY, &v6_only, sizeof(v6_only));
+    }
+
+    // Every torrent's answers land in the same queue, so give bursts room.
+    for (int fd : { ipv4_socket, ipv6_socket }) {
+        if (fd >= 0) {
+            setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &kReceiveBufferSize, sizeof(kReceiveBufferSize));
+        }
+    }
+
+    worker = std::thread(&UdpTrackerEngine::Run, this);
+}
+
+UdpTrackerEngine::~UdpTrackerEngine() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    Wake();
+    worker.join();
+
+    for (int fd : { ipv4_socket, ipv6_socket, wake_fd }) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+uint64_t UdpTrackerEngine::Announce(
+    const UdpEndpoint& tracker,
+    AnnounceRequest request,
+    AnnounceCallback on_done
+) {
+    Transaction transaction;
+    transaction.tracker = tracker;
+    transaction.request = std::move(request);
+    transaction.on_announced = std::move(on_done);
+    return Submit(std::move(transaction));
+}
+
+uint64_t UdpTrackerEngine::Scrape(
+    const UdpEndpoint& tracker,
+    std::vector<std::string> info_hashes,
+    ScrapeCallback on_done
+) {
+    // Throws here rather than on the engine thread.
+    UdpTracker::ScrapeRequest(0, 0, info_hashes);
+
+    Transaction transaction;
+    transaction.tracker = tracker;
+    transaction.scrape_hashes = std::move(info_hashes);
+    transaction.on_scraped = std::move(on_done);
+    return Submit(std::move(transaction));
+}
+
+uint64_t UdpTrackerEngine::Submit(Transaction transaction) {
+    uint64_t request_id;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        request_id = next_request_id++;
+        transaction.request_id = request_id;
+        submitted.push_back(std::move(transaction));
+    }
+    Wake();
+    return request_id;
+}
+
+void UdpTrackerEngine::Cancel(uint64_t request_id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::erase_if(submitted, [request_id](const Transaction& transaction) {
+        return transaction.request_id == request_id;
+    });
+    std::erase_if(transactions, [request_id](const auto& entry) {
+        return entry.second.request_id == request_id;
+    });
+}
+
+size_t UdpTrackerEngine::PendingCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return submitted.size() + transactions.size();
+}
+
+void UdpTrackerEngine::Wake() const {
+    uint64_t one = 1;
+    [[maybe_unused]] auto written = write(wake_fd, &one, sizeof(one));
+}
+
+void UdpTrackerEngine::Run() {
+    while (true) {
+        int wait_ms;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping) {
+                return;
+            }
+
+            auto wait = kMaxPollWait;
+            if (!timers.empty()) {
+                wait = std::clamp(
+                    std::chrono::ceil<std::chrono::milliseconds>(
+                        timers.begin()->first - Clock::now()
+                    ),
+                    std::chrono::milliseconds(0),
+                    kMaxPollWait
+                );
+            }
+            wait_ms = static_cast<int>(wait.count());
+        }
+
+        pollfd fds[3] = {
+            { wake_fd, POLLIN, 0 },
+            { ipv4_socket, POLLIN, 0 },
+            { ipv6_socket, POLLIN, 0 },
+        };
+        poll(fds, 3, wait_ms);
+
+        if (fds[0].revents & POLLIN) {
+            uint64_t count;
+            [[maybe_unused]] auto read_size = read(wake_fd, &count, sizeof(count));
+        }
+
+        std::vector<Completion> completed;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (fds[1].revents & POLLIN) {
+                Receive(ipv4_socket, completed);
+            }
+            if (fds[2].revents & POLLIN) {
+                Receive(ipv6_socket, completed);
+            }
+            ExpireTimers(completed);
+
+            auto starting = std::move(submitted);
+            submitted.clear();
+            for (auto& transaction : starting) {
+                Start(std::move(transaction), completed);
+            }
+        }
+
+        for (auto& completion : completed) {
+            completion();
+        }
+    }
+}
+
+void UdpTrackerEngine::Start(
+    Transaction transaction,
+    std::vector<Completion>& completed
+) {
+    if (SocketFor(transaction.tracker) < 0) {
+        CompleteWithError(transaction, "No UDP socket for the tracker's address family", completed);
+        return;
+    }
+
+    auto cached = connections.find(transaction.tracker);
+    if (cached != connections.end() && cached->second.expires > Clock::now()) {
+        transaction.stage = Stage::kRequest;
+        transaction.connection_id = cached->second.connection_id;
+        transaction.connection_expires = cached->second.expires;
+        transaction.cached_connection = true;
+    }
+
+    Dispatch(std::move(transaction));
+}
+
+void UdpTrackerEngine::Dispatch(Transaction transaction) {
+    uint32_t transaction_id = NewTransactionId();
+    auto& stored = transactions[transaction_id] = std::move(transaction);
+    Send(transaction_id, stored);
+}
+
+void UdpTrackerEngine::Send(uint32_t transaction_id, Transaction& transaction) {
+    std::string packet;
+    if (transaction.stage == Stage::kConnect) {
+        packet = UdpTracker::ConnectRequest(transaction_id);
+    } else if (!transaction.scrape_hashes.empty()) {
+        packet = UdpTracker::ScrapeRequest(
+            transaction.connection_id,
+            transaction_id,
+            transaction.scrape_hashes
+        );
+    } else {
+        const auto& request = transaction.request;
+        packet = UdpTracker::AnnounceRequest(
+            transaction.connection_id,
+            transaction_id,
+            request.info_hash,
+            request.peer_id,
+            request.downloaded,
+            request.left,
+            request.uploaded,
+            request.event,
+            request.num_want,
+            request.port
+        );
+    }
+
+    // A failed send is handled like a lost datagram, by the timer.
+    sendto(
+        SocketFor(transaction.tracker),
+        packet.data(),
+        packet.size(),
+        0,
+        reinterpret_cast<const sockaddr*>(&transaction.tracker.address),
+        transaction.tracker.length
+    );
+
+    transaction.deadline = Clock::now() + RetransmitTimeout(transaction.retransmits);
+    timers.emplace(transaction.deadline, transaction_id);
+}
+
+void UdpTrackerEngine::Receive(int socket_fd, std::vector<Completion>& completed) {
+    char buffer[65536];
+    while (true) {
+        UdpEndpoint from;
+        from.length = sizeof(from.address);
+        ssize_t received = recvfrom(
+            socket_fd,
+            buffer,
+            sizeof(buffer),
+            0,
+            reinterpret_cast<sockaddr*>(&from.address),
+            &from.length
+        );
+        if (received < 0) {
+            return;
+        }
+        if (received < 8) {
+            continue;
+        }
+
+        std::string_view response(buffer, received);
+        uint32_t transaction_id = utils::BytesToInt32(response.substr(4, 4));
+        auto transaction = transactions.find(transaction_id);
+        if (transaction == transactions.end() || !(transaction->second.tracker == from)) {
+            continue;
+        }
+
+        HandleResponse(transaction_id, response, completed);
+    }
+}
+
+void UdpTrackerEngine::HandleResponse(
+    uint32_t transaction_id,
+    std::string_view response,
+    std::vector<Completion>& completed
+) {
+    auto node = transactions.extract(transaction_id);
+    Transaction& transaction = node.mapped();
+
+    try {
+        if (transaction.stage == Stage::kConnect) {
+            auto now = Clock::now();
+            transaction.connection_id = UdpTracker::ParseConnectResponse(
+                response,
+                transaction_id
+            );
+            transaction.connection_expires = now + kConnectionIdLifetime;
+            transaction.stage = Stage::kRequest;
+
+            std::erase_if(connections, [now](const auto& entry) {
+                return entry.second.expires <= now;
+            });
+            connections[transaction.tracker] = {
+                transaction.connection_id,
+                transaction.connection_expires
+            };
+
+            Dispatch(std::move(transaction));
+            return;
+        }
+
+        Complete(transaction, transaction_id, response, completed);
+    } catch (const std::exception& error) {
+        // The tracker may have forgotten a cached connection id early, so
+        // get a fresh one before believing the error.
+        if (transaction.cached_connection) {
+            connections.erase(transaction.tracker);
+            transaction.stage = Stage::kConnect;
+            transaction.cached_connection = false;
+            Dispatch(std::move(transaction));
+            return;
+        }
+
+        CompleteWithError(transaction, error.what(), completed);
+    }
+}
+
+void UdpTrackerEngine::Complete(
+    Transaction& transaction,
+    uint32_t transaction_id,
+    std::string_view response,
+    std::vector<Completion>& completed
+) {
+    if (transaction.scrape_hashes.empty()) {
+        AnnounceResult result{
+            UdpTracker::ParseAnnounceResponse(
+                response,
+                transaction_id,
+                transaction.tracker.address.ss_family
+            ),
+            ""
+        };
+        completed.push_back([on_done = std::move(transaction.on_announced), result]() mutable {
+            on_done(std::move(result));
+        });
+        return;
+    }
+
+    ScrapeResult result{
+        UdpTracker::ParseScrapeResponse(response, transaction_id, transaction.scrape_hashes.size()),
+        ""
+    };
+    completed.push_back([on_done = std::move(transaction.on_scraped), result]() mutable {
+        on_done(std::move(result));
+    });
+}
+
+void UdpTrackerEngine::CompleteWithError(
+    Transaction& transaction,
+    const std::string& error,
+    std::vector<Completion>& completed
+) {
+    if (transaction.scrape_hashes.empty()) {
+        completed.push_back([on_done = std::move(transaction.on_announced), error] {
+            on_done({ {}, error });
+        });
+    } else {
+        completed.push_back([on_done = std::move(transaction.on_scraped), error] {
+            on_done({ {}, error });
+        });
+    }
+}
+
+void UdpTrackerEngine::ExpireTimers(std::vector<Completion>& completed) {
+    auto now = Clock::now();
+    while (!timers.empty() && timers.begin()->first <= now) {
+        auto [deadline, transaction_id] = *timers.begin();
+        timers.erase(timers.begin());
+
+        // Entries of answered or re-sent transactions are stale.
+        auto entry = transactions.find(transaction_id);
+        if (entry == transactions.end() || entry->second.deadline != deadline) {
+            continue;
+        }
+
+        auto& transaction = entry->second;
+        if (transaction.retransmits >= options.max_retransmits) {
+            Fail(transaction_id, "UDP tracker timed out", completed);
+            continue;
+        }
+
+        ++transaction.retransmits;
+        if (transaction.stage == Stage::kRequest && transaction.connection_expires <= now) {
+            transaction.stage = Stage::kConnect;
+            transaction.cached_connection = false;
+        }
+        Send(transaction_id, transaction);
+    }
+}
+
+void UdpTrackerEngine::Fail(
+    uint32_t transaction_id,
+    const std::string& error,
+    std::vector<Completion>& completed
+) {
+    auto node = transactions.extract(transaction_id);
+    CompleteWithError(node.mapped(), error, completed);
+}
+
+uint32_t UdpTrackerEngine::NewTransactionId() {
+    static thread_local std::mt19937 generator(std::random_device{}());
+    uint32_t transaction_id;
+    do {
+        transaction_id = generator();
+    } while (transactions.contains(transaction_id));
+    return transaction_id;
+}
+
+std::chrono::milliseconds UdpTrackerEngine::RequestBudget() const {
+    // Connect and request stages share the retransmit count.
+    std::chrono::milliseconds budget{0};
+    for (int attempt = 0; attempt <= options.max_retransmits; ++attempt) {
+        budget += RetransmitTimeout(attempt);
+    }
+    return budget;
+}
+
+std::chrono::milliseconds UdpTrackerEngine::RetransmitTimeout(int attempt) const {
+    return options.retransmit_timeout * (1 << std::min(attempt, kMaxBackoffExponent));
+}
+
+int UdpTrackerEngine::SocketFor(const UdpEndpoint& endpoint) const {
+    return endpoint.address.ss_family == AF_INET6 ? ipv6_socket : ipv4_socket;
+}
@@ -0,0 +1,256 @@
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include "core/LocalTracker.hpp"
+#include "core/TrackerAnnouncer.hpp"
+
+namespace {
+
+void PrintUsage(const char* program) {
+    std::cerr
+        << "Usage: " << program << " [options]\n"
+        << "  --bind ADDRESS       address to listen on (default 127.0.0.1)\n"
+        << "  --http-port PORT     HTTP tracker port (default: any free port)\n"
+        << "  --udp-port PORT      UDP tracker port (default: any free port)\n"
+        << "  --peer IP:PORT       peer handed out for every torrent, repeatable\n"
+        << "  --synthetic-peers N  add N made-up peers from 10.0.0.0/8\n"
+        << "  --interval SECONDS   re-announce interval (default 1800)\n"
+        << "  --latency MS         delay before every answer (default 0)\n"
+        << "  --loss RATE          share of UDP packets dropped, 0 to 1 (default 0)\n"
+        << "  --self-test          announce to and scrape in-process trackers, exit 1 on failure\n";
+}
+
+Peer ParsePeer(std::string_view text) {
+    size_t colon = text.rfind(':');
+    if (colon == std::string_view::npos) {
+        throw std::runtime_error("Peer must be IP:PORT: " + std::string(text));
+    }
+    return Peer::FromString(text.substr(0, colon), static_cast<uint16_t>(std::stoi(std::string(text.substr(colon + 1)))));
+}
+
+class SelfTest {
+public:
+    void Check(bool passed, const std::string& what) {
+        std::cout << (passed ? "ok    " : "FAIL  ") << what << std::endl;
+        failures += passed ? 0 : 1;
+    }
+
+    int ExitCode() const {
+        std::cout << (failures == 0 ? "All checks passed" : std::to_string(failures) + " checks failed") << std::endl;
+        return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+private:
+    int failures = 0;
+};
+
+std::string Detail(const std::string& error) {
+    return error.empty() ? "" : ": " + error;
+}
+
+bool SamePeers(std::vector<Peer> left, std::vector<Peer> right) {
+    auto order = [](const Peer& a, const Peer& b) {
+        return std::tie(a.address, a.port) < std::tie(b.address, b.port);
+    };
+    std::sort(left.begin(), left.end(), order);
+    std::sort(right.begin(), right.end(), order);
+    return left == right;
+}
+
+AnnounceResult AnnounceOnce(TrackerAnnouncer& announcer, const std::string& url, const AnnounceParams& params) {
+    std::atomic<bool> stop{false};
+    AnnounceResult answer;
+    answer.error = "no answer";
+    announcer.AnnounceAll({ url }, params, stop, [&](const AnnounceResult& result) { answer = result; });
+    return answer;
+}
+
+ScrapeResult ScrapeOnce(TrackerAnnouncer& announcer, const std::string& url, const std::string& info_hash) {
+    std::atomic<bool> stop{false};
+    ScrapeResult answer;
+    answer.error = "no answer";
+    announcer.ScrapeAll({ url }, { info_hash }, stop, [&](const ScrapeResult& result) { answer = result; });
+    return answer;
+}
+
+// Round trips through TrackerAnnouncer against LocalTracker: announce and
+// scrape over HTTP and UDP, then UDP through a lossy tracker, which only
+// passes when lost datagrams are retransmitted.
+int RunSelfTest() {
+    SelfTest test;
+
+    std::vector<Peer> seeds = {
+        Peer::FromString("10.0.0.1", 6881),
+        Peer::FromString("10.0.0.2", 6882),
+        Peer::FromString("2001:db8::1", 6883),
+    };
+    std::vector<Peer> ipv4_seeds(seeds.begin(), seeds.begin() + 2);
+
+    AnnounceParams params;
+    params.info_hash = std::string(20, 's');
+    params.peer_id = "-ST0001-selftest0000";
+    params.port = 7000;
+    params.left = 100;
+    params.event = TrackerEvent::kStarted;
+
+    {
+        LocalTrackerOptions options;
+        options.peers = seeds;
+        options.interval = 900;
+        LocalTracker tracker(options);
+        TrackerAnnouncer announcer;
+
+        auto http = AnnounceOnce(announcer, tracker.HttpAnnounceUrl(), params);
+        test.Check(http.error.empty(), "HTTP announce answered" + Detail(http.error));
+        test.Check(SamePeers(http.peers, seeds), "HTTP announce returns IPv4 and IPv6 peers");
+        test.Check(http.interval == std::chrono::seconds(900), "HTTP announce returns the interval");
+
+        auto udp = AnnounceOnce(announcer, tracker.UdpAnnounceUrl(), params);
+        test.Check(udp.error.empty(), "UDP announce answered" + Detail(udp.error));
+        test.Check(SamePeers(udp.peers, ipv4_seeds), "UDP announce returns the IPv4 peers");
+        test.Check(udp.interval == std::chrono::seconds(900), "UDP announce returns the interval");
+
+        for (const auto& url : { tracker.HttpAnnounceUrl(), tracker.UdpAnnounceUrl() }) {
+            auto scrape = ScrapeOnce(announcer, url, params.info_hash);
+            bool counted =
+                scrape.error.empty()
+                && scrape.stats.size() == 1
+                && scrape.stats[0].seeders == seeds.size()
+                && scrape.stats[0].leechers == 1;
+            test.Check(counted, "scrape of " + url + " counts the seeds and this client" + Detail(scrape.error));
+        }
+
+        auto stats = tracker.Stats();
+        test.Check(
+            stats.http_announces == 1 && stats.udp_announces == 1
+                && stats.http_scrapes == 1 && stats.udp_scrapes == 1,
+            "tracker saw one announce and one scrape per protocol"
+        );
+    }
+
+    {
+        LocalTrackerOptions options;
+        options.peers = seeds;
+        options.track_announcers = false;
+        options.latency = std::chrono::milliseconds(10);
+        options.loss_rate = 0.2;
+        LocalTracker tracker(options);
+
+        // Short retransmits and a generous budget, so the check is fast and
+        // practically never loses a tracker to bad luck.
+        UdpTrackerOptions udp_options;
+        udp_options.retransmit_timeout = std::chrono::milliseconds(50);
+        udp_options.max_retransmits = 12;
+        UdpTrackerEngine engine(udp_options);
+        TrackerAnnouncer announcer(engine);
+
+        std::vector<std::string> urls;
+        for (int i = 0; i < 16; ++i) {
+            urls.push_back(tracker.UdpAnnounceUrl() + "?tracker=" + std::to_string(i));
+        }
+
+        std::atomic<bool> stop{false};
+        size_t answered = 0;
+        // With a timeout the round waits for every tracker.
+        announcer.AnnounceAll(urls, params, stop, [&](const AnnounceResult& result) {
+            answered += result.error.empty() && SamePeers(result.peers, ipv4_seeds) ? 1 : 0;
+        }, announcer.RoundBudget());
+        test.Check(answered == urls.size(), "lossy UDP announces all answered (" + std::to_string(answered) + "/16)");
+
+        size_t scraped = 0;
+        announcer.ScrapeAll(urls, { params.info_hash }, stop, [&](const ScrapeResult& result) {
+            scraped += result.error.empty() && result.stats.size() == 1 ? 1 : 0;
+        }, announcer.RoundBudget());
+        test.Check(scraped == urls.size(), "lossy UDP scrapes all answered (" + std::to_string(scraped) + "/16)");
+        test.Check(tracker.Stats().udp_dropped > 0, "lossy tracker dropped datagrams that were resent");
+    }
+
+    return test.ExitCode();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    LocalTrackerOptions options;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string_view flag = argv[i];
+            if (flag == "--help" || flag == "-h") {
+                PrintUsage(argv[0]);
+                return EXIT_SUCCESS;
+            }
+            if (flag == "--self-test") {
+                return RunSelfTest();
+            }
+            if (i + 1 >= argc) {
+                throw std::runtime_error("Missing value for " + std::string(flag));
+            }
+            std::string value = argv[++i];
+
+            if (flag == "--bind") {
+                options.bind_address = value;
+            } else if (flag == "--http-port") {
+                options.http_port = static_cast<uint16_t>(std::stoi(value));
+            } else if (flag == "--udp-port") {
+                options.udp_port = static_cast<uint16_t>(std::stoi(value));
+            } else if (flag == "--peer") {
+                options.peers.push_back(ParsePeer(value));
+            } else if (flag == "--synthetic-peers") {
+                uint32_t count = static_cast<uint32_t>(std::stoul(value));
+                for (uint32_t n = 1; n <= count; ++n) {
+                    options.peers.push_back(Peer::FromIpv4(0x0A000000 | n, 6881));
+                }
+            } else if (flag == "--interval") {
+                options.interval = static_cast<uint32_t>(std::stoul(value));
+            } else if (flag == "--latency") {
+                options.latency = std::chrono::milliseconds(std::stol(value));
+            } else if (flag == "--loss") {
+                options.loss_rate = std::stod(value);
+            } else {
+                throw std::runtime_error("Unknown option " + std::string(flag));
+            }
+        }
+    } catch (const std::exception& error) {
+        std::cerr << "Error: " << error.what() << std::endl;
+        PrintUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // Blocked before the tracker thread starts, so only sigwait sees them.
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    try {
+        LocalTracker tracker(options);
+        std::cout
+            << tracker.HttpAnnounceUrl() << "\n"
+            << tracker.UdpAnnounceUrl() << std::endl;
+
+        int signal = 0;
+        sigwait(&signals, &signal);
+
+        auto stats = tracker.Stats();
+        std::cout
+            << "HTTP: " << stats.http_announces << " announces, "
+            << stats.http_scrapes << " scrapes\n"
+            << "UDP: " << stats.udp_connects << " connects, "
+            << stats.udp_announces << " announces, "
+            << stats.udp_scrapes << " scrapes, "
+            << stats.udp_dropped << " dropped" << std::endl;
+    } catch (const std::exception& error) {
+        std::cerr << "Error: " << error.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
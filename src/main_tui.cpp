@@ -1,19 +1,83 @@
 #include <filesystem>
 #include <future>
 #include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string_view>
 #include <thread>
+#include <utility>
+#include <vector>
 
+#include "core/MagnetLink.hpp"
 #include "core/TorrentClient.hpp"
 #include "ui/TorrentUi.hpp"
 
+struct PriorityOption {
+    bool per_file = true;
+    size_t index = 0;
+    PiecePriority priority = PiecePriority::kNormal;
+};
+
+void PrintUsage(const char* program) {
+    std::cerr
+        << "Usage: "
+        << program
+        << " <torrent-file | magnet-link> <output-directory> [options]\n"
+        << "  --file-priority INDEX=LEVEL   skip, low, normal or high for one file\n"
+        << "  --piece-priority INDEX=LEVEL  same for one piece, after file priorities\n"
+        << "  --read-cache MIB              memory for pieces served to peers (default 64)\n"
+        << "  --direct-io                   write with O_DIRECT, bypassing the page cache\n"
+        << "  --metadata-cache              cache parsed torrents in $XDG_CACHE_HOME/torrent-client\n";
+}
+
+PiecePriority ParsePriority(std::string_view level) {
+    if (level == "skip") {
+        return PiecePriority::kSkip;
+    }
+    if (level == "low") {
+        return PiecePriority::kLow;
+    }
+    if (level == "normal") {
+        return PiecePriority::kNormal;
+    }
+    if (level == "high") {
+        return PiecePriority::kHigh;
+    }
+    throw std::runtime_error("Unknown priority " + std::string(level));
+}
+
+PriorityOption ParsePriorityOption(bool per_file, std::string_view text) {
+    size_t equals = text.find('=');
+    if (equals == std::string_view::npos) {
+        throw std::runtime_error("Priority must be INDEX=LEVEL: " + std::string(text));
+    }
+    return {
+        per_file,
+        std::stoul(std::string(text.substr(0, equals))),
+        ParsePriority(text.substr(equals + 1)),
+    };
+}
+
+size_t ParseMebibytes(std::string_view text) {
+    size_t mebibytes = std::stoul(std::string(text));
+    if (mebibytes > (std::numeric_limits<size_t>::max() >> 20)) {
+        throw std::runtime_error("Size out of range: " + std::string(text));
+    }
+    return mebibytes << 20;
+}
+
 void DownloadThreadFunction(
     TorrentClient* client,
-    const std::filesystem::path& torrent_file_path,
+    const std::string& torrent_source,
     const std::filesystem::path& output_directory,
     std::promise<bool>& download_promise
 ) {
     try {
-        client->DownloadTorrent(torrent_file_path, output_directory);
+        if (IsMagnetLink(torrent_source)) {
+            client->DownloadMagnet(torrent_source, output_directory);
+        } else {
+            client->DownloadTorrent(torrent_source, output_directory);
+        }
         if (client->IsStopRequested()) {
             download_promise.set_value(false);
         } else {
@@ -26,22 +90,60 @@ void DownloadThreadFunction(
 }
 
 int main(int argc, char* argv[]) {
-    if (argc != 3) {
-        std::cerr
-            << "Usage: "
-            << argv[0]
-            << " <torrent-file> <output-directory>"
-            << std::endl;
+    if (argc < 3) {
+        PrintUsage(argv[0]);
         return EXIT_FAILURE;
     }
     
-    std::filesystem::path torrent_file_path = argv[1];
+    std::string torrent_source = argv[1];
     std::filesystem::path output_directory = argv[2];
+
+    std::vector<PriorityOption> priorities;
+    StorageOptions storage_options;
+    bool metadata_cache = false;
+    try {
+        for (int i = 3; i < argc; ++i) {
+            std::string_view flag = argv[i];
+            if (flag == "--direct-io") {
+                storage_options.direct_io = true;
+                continue;
+            }
+            if (flag == "--metadata-cache") {
+                metadata_cache = true;
+                continue;
+            }
+            if (i + 1 >= argc) {
+                throw std::runtime_error("Missing value for " + std::string(flag));
+            }
+            std::string_view value = argv[++i];
+
+            if (flag == "--file-priority") {
+                priorities.push_back(ParsePriorityOption(true, value));
+            } else if (flag == "--piece-priority") {
+                priorities.push_back(ParsePriorityOption(false, value));
+            } else if (flag == "--read-cache") {
+                storage_options.read_cache_bytes = ParseMebibytes(value);
+            } else {
+                throw std::runtime_error("Unknown option " + std::string(flag));
+            }
+        }
+    } catch (const std::exception& error) {
+        std::cerr << "Error: " << error.what() << std::endl;
+        PrintUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
     
-    if (!std::filesystem::exists(torrent_file_path)) {
+    if (IsMagnetLink(torrent_source)) {
+        try {
+            ParseMagnetLink(torrent_source);
+        } catch (const std::exception& error) {
+            std::cerr << "Error: " << error.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    } else if (!std::filesystem::exists(torrent_source)) {
         std::cerr
             << "Error: Torrent file not found: "
-            << torrent_file_path
+            << torrent_source
             << std::endl;
         return EXIT_FAILURE;
     }
@@ -52,6 +154,15 @@ int main(int argc, char* argv[]) {
     
     try {
         auto client = std::make_unique<TorrentClient>();
+        client->SetMetadataCacheEnabled(metadata_cache);
+        client->SetStorageOptions(storage_options);
+        for (const auto& option : priorities) {
+            if (option.per_file) {
+                client->SetFilePriority(option.index, option.priority);
+            } else {
+                client->SetPiecePriority(option.index, option.priority);
+            }
+        }
         TorrentClient* client_raw = client.get();
         
         std::promise<bool> download_promise;
@@ -61,7 +172,7 @@ int main(int argc, char* argv[]) {
         std::thread download_thread(
             DownloadThreadFunction, 
             client_raw, 
-            torrent_file_path, 
+            torrent_source, 
             output_directory,
             std::ref(download_promise)
         );
@@ -0,0 +1,49 @@
+#include "net/CurlShare.hpp"
+
+#include <stdexcept>
+
+CurlShare& CurlShare::Shared() {
+    static CurlShare share;
+    return share;
+}
+
+CurlShare::CurlShare() {
+    static std::once_flag curl_initialized;
+    std::call_once(curl_initialized, [] {
+        curl_global_init(CURL_GLOBAL_DEFAULT);
+    });
+
+    share = curl_share_init();
+    if (!share) {
+        throw std::runtime_error("Failed to create curl share handle");
+    }
+
+    curl_share_setopt(share, CURLSHOPT_LOCKFUNC, &CurlShare::Lock);
+    curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, &CurlShare::Unlock);
+    curl_share_setopt(share, CURLSHOPT_USERDATA, this);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+}
+
+CurlShare::~CurlShare() {
+    curl_share_cleanup(share);
+}
+
+void CurlShare::Attach(CURL* handle) const {
+    curl_easy_setopt(handle, CURLOPT_SHARE, share);
+    curl_easy_setopt(handle, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(
+        handle,
+        CURLOPT_MAXAGE_CONN,
+        static_cast<long>(kIdleConnectionLifetime.count())
+    );
+    curl_easy_setopt(handle, CURLOPT_ACCEPT_ENCODING, "");
+}
+
+void CurlShare::Lock(CURL*, curl_lock_data data, curl_lock_access, void* self) {
+    static_cast<CurlShare*>(self)->locks[data].lock();
+}
+
+void CurlShare::Unlock(CURL*, curl_lock_data data, void* self) {
+    static_cast<CurlShare*>(self)->locks[data].unlock();
+}
@@ -0,0 +1,134 @@
+#include "net/DnsResolver.hpp"
+
+#include <netdb.h>
+
+#include <algorithm>
+#include <cstring>
+#include <future>
+
+DnsResolver& DnsResolver::Shared() {
+    static DnsResolver resolver;
+    return resolver;
+}
+
+DnsResolver::DnsResolver(const DnsResolverOptions& options) : options(options) {
+    for (size_t i = 0; i < std::max<size_t>(options.worker_count, 1); ++i) {
+        workers.emplace_back(&DnsResolver::Run, this);
+    }
+}
+
+DnsResolver::~DnsResolver() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    queue_changed.notify_all();
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void DnsResolver::Resolve(const std::string& host, Callback on_done) {
+    std::unique_lock<std::mutex> lock(mutex);
+    auto now = Clock::now();
+
+    auto cached = cache.find(host);
+    if (cached != cache.end() && now < cached->second.expires) {
+        Result result = cached->second.result;
+        lock.unlock();
+        on_done(result);
+        return;
+    }
+
+    bool serve_stale = cached != cache.end()
+        && cached->second.result.error.empty()
+        && now < cached->second.expires + options.stale_ttl;
+
+    auto [waiting, first] = in_flight.try_emplace(host);
+    if (!serve_stale) {
+        waiting->second.push_back(std::move(on_done));
+    }
+    if (first) {
+        queue.push_back(host);
+        queue_changed.notify_one();
+    }
+
+    if (serve_stale) {
+        Result result = cached->second.result;
+        lock.unlock();
+        on_done(result);
+    }
+}
+
+DnsResolver::Result DnsResolver::ResolveNow(const std::string& host) {
+    auto done = std::make_shared<std::promise<Result>>();
+    auto result = done->get_future();
+    Resolve(host, [done](const Result& resolved) { done->set_value(resolved); });
+    return result.get();
+}
+
+void DnsResolver::Run() {
+    while (true) {
+        std::string host;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            queue_changed.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (stopping) {
+                return;
+            }
+            host = std::move(queue.front());
+            queue.pop_front();
+        }
+
+        Result result = Lookup(host);
+
+        std::vector<Callback> callbacks;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto now = Clock::now();
+            std::erase_if(cache, [this, now](const auto& entry) {
+                return entry.second.expires + options.stale_ttl <= now;
+            });
+
+            auto ttl = result.error.empty() ? options.cache_ttl : options.negative_ttl;
+            cache[host] = { result, now + ttl };
+
+            auto waiting = in_flight.find(host);
+            callbacks = std::move(waiting->second);
+            in_flight.erase(waiting);
+        }
+
+        for (auto& callback : callbacks) {
+            callback(result);
+        }
+    }
+}
+
+DnsResolver::Result DnsResolver::Lookup(const std::string& host) {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+
+    addrinfo* found = nullptr;
+    int code = getaddrinfo(host.c_str(), nullptr, &hints, &found);
+    if (code != 0 || !found) {
+        return { {}, "Failed to resolve " + host + ": " + gai_strerror(code) };
+    }
+
+    Result result;
+    for (const addrinfo* entry = found; entry; entry = entry->ai_next) {
+        if (entry->ai_family != AF_INET && entry->ai_family != AF_INET6) {
+            continue;
+        }
+        sockaddr_storage address{};
+        std::memcpy(&address, entry->ai_addr, entry->ai_addrlen);
+        result.addresses.push_back(address);
+    }
+    freeaddrinfo(found);
+
+    if (result.addresses.empty()) {
+        result.error = "No IPv4 or IPv6 address for " + host;
+    }
+    return result;
+}
@@ -0,0 +1,411 @@
+#include "net/MetadataFetcher.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+#include "net/Message.hpp"
+#include "utils/BencodeDocument.hpp"
+#include "utils/BencodeTokenizer.hpp"
+#include "utils/BencodeWriter.hpp"
+#include "utils/byte_tools.hpp"
+
+using namespace std::chrono_literals;
+
+namespace {
+
+enum class MetadataMessageType : int64_t {
+    kRequest = 0,
+    kData = 1,
+    kReject = 2,
+};
+
+// ut_metadata data messages carry the raw piece right after the bencoded
+// header, so the header has to be delimited before it can be parsed.
+size_t BencodedLength(std::string_view data) {
+    utils::BencodeTokenizer tokenizer(data);
+    utils::BencodeToken token;
+    while (tokenizer.Next(token)) {
+    }
+    return tokenizer.Offset();
+}
+
+std::string ExtendedMessage(uint8_t extension_id, std::string_view payload) {
+    return wire::EncodeWithTrailer(wire::ExtendedHeader{ extension_id }, payload);
+}
+
+} // namespace
+
+MetadataFetcher::MetadataFetcher(std::string info_hash, std::string self_peer_id) :
+    info_hash(std::move(info_hash)),
+    self_peer_id(std::move(self_peer_id))
+{}
+
+MetadataFetcher::~MetadataFetcher() {
+    Finish(false);
+    JoinWorkers();
+}
+
+void MetadataFetcher::AddPeers(const std::vector<Peer>& peers) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (done) {
+        return;
+    }
+    pending_peers.insert(pending_peers.end(), peers.begin(), peers.end());
+
+    size_t idle_slots = kMaxParallelPeers - running_workers;
+    size_t new_workers = std::min(idle_slots, pending_peers.size());
+    for (size_t i = 0; i < new_workers; ++i) {
+        workers.emplace_back(&MetadataFetcher::Worker, this);
+    }
+    running_workers += new_workers;
+}
+
+void MetadataFetcher::EndOfPeers() {
+    std::lock_guard<std::mutex> lock(mutex);
+    peers_complete = true;
+    finished.notify_all();
+}
+
+std::string MetadataFetcher::Fetch(
+    const std::vector<Peer>& peers,
+    const std::atomic<bool>& stop_requested,
+    std::chrono::seconds timeout
+) {
+    AddPeers(peers);
+    EndOfPeers();
+    return Fetch(stop_requested, timeout);
+}
+
+std::string MetadataFetcher::Fetch(
+    const std::atomic<bool>& stop_requested,
+    std::chrono::seconds timeout
+) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (
+            !done
+            && (running_workers > 0 || !peers_complete)
+            && !stop_requested
+            && std::chrono::steady_clock::now() < deadline
+        ) {
+            finished.wait_for(lock, 100ms);
+        }
+    }
+    Finish(false);
+    JoinWorkers();
+
+    if (!verified) {
+        throw std::runtime_error("Failed to fetch metadata from peers");
+    }
+    return metadata;
+}
+
+void MetadataFetcher::Finish(bool success) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!done) {
+        done = true;
+        verified = success;
+    }
+    // Unblocks workers still waiting on slower peers, each closes its own
+    // socket.
+    for (auto& socket : connections) {
+        socket->Interrupt();
+    }
+    finished.notify_all();
+}
+
+void MetadataFetcher::JoinWorkers() {
+    // Workers are only started while not done, so none are added once
+    // Finish has run.
+    std::vector<std::thread> finished_workers;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        finished_workers.swap(workers);
+    }
+    for (auto& worker : finished_workers) {
+        worker.join();
+    }
+}
+
+void MetadataFetcher::Worker() {
+    while (true) {
+        Peer peer;
+        {
+            // Leaving in the same critical section as the empty check lets
+            // AddPeers count on running_workers for peers it queues.
+            std::lock_guard<std::mutex> lock(mutex);
+            if (done || pending_peers.empty()) {
+                --running_workers;
+                finished.notify_all();
+                return;
+            }
+            peer = pending_peers.front();
+            pending_peers.pop_front();
+        }
+
+        try {
+            FetchFromPeer(peer);
+        } catch (const std::exception&) {
+        }
+    }
+}
+
+bool MetadataFetcher::RegisterConnection(
+    const std::shared_ptr<TcpConnection>& socket
+) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (done) {
+        return false;
+    }
+    connections.push_back(socket);
+    return true;
+}
+
+void MetadataFetcher::UnregisterConnection(
+    const std::shared_ptr<TcpConnection>& socket
+) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::erase(connections, socket);
+}
+
+void MetadataFetcher::FetchFromPeer(const Peer& peer) {
+    auto socket = std::make_shared<TcpConnection>(peer, 3000ms, 3000ms);
+    if (!RegisterConnection(socket)) {
+        return;
+    }
+
+    std::vector<size_t> own_requests;
+    try {
+        socket->EstablishConnection();
+        PerformHandshake(*socket);
+        uint8_t peer_metadata_id = PerformExtendedHandshake(*socket);
+
+        int idle_reads = 0;
+        while (true) {
+            size_t index;
+            while (
+                own_requests.size() < kMaxInflightRequests
+                && ClaimPiece(own_requests, index)
+            ) {
+                std::string request;
+                utils::BencodeWriter writer(request);
+                writer.BeginDict()
+                    .Key("msg_type").Integer(static_cast<int64_t>(MetadataMessageType::kRequest))
+                    .Key("piece").Integer(index)
+                .End();
+                socket->SendData(ExtendedMessage(peer_metadata_id, request));
+                own_requests.push_back(index);
+            }
+
+            if (own_requests.empty()) {
+                break;
+            }
+
+            auto data = socket->ReceiveData();
+            if (data.empty()) {
+                if (++idle_reads >= kMaxIdleReads) {
+                    throw std::runtime_error("Peer stopped answering metadata requests");
+                }
+                continue;
+            }
+            idle_reads = 0;
+
+            auto frame = wire::ParseFrame(data);
+            if (
+                frame.id != MessageId::kExtended
+                || frame.payload.empty()
+                || wire::Decode<wire::ExtendedHeader>(frame.payload).extension_id
+                    != kUtMetadataId
+            ) {
+                continue;
+            }
+
+            auto body = wire::Trailer<wire::ExtendedHeader>(frame.payload);
+            size_t header_length = BencodedLength(body);
+            auto header = utils::BencodeDocument::FromString(
+                std::string(body.substr(0, header_length))
+            );
+            auto type = header.Root().Find("msg_type").IntegerOr(-1);
+            auto piece = static_cast<size_t>(header.Root().Find("piece").IntegerOr(-1));
+
+            auto position = std::find(own_requests.begin(), own_requests.end(), piece);
+            if (position == own_requests.end()) {
+                continue;
+            }
+            own_requests.erase(position);
+
+            if (type == static_cast<int64_t>(MetadataMessageType::kReject)) {
+                throw std::runtime_error("Peer rejected metadata request");
+            }
+            if (type == static_cast<int64_t>(MetadataMessageType::kData)) {
+                StorePiece(piece, body.substr(header_length));
+            }
+        }
+    } catch (...) {
+        ReleasePieces(own_requests);
+        UnregisterConnection(socket);
+        throw;
+    }
+
+    UnregisterConnection(socket);
+}
+
+void MetadataFetcher::PerformHandshake(TcpConnection& socket) const {
+    std::string reserved(8, '\0');
+    reserved[5] = 0x10;
+
+    std::string msg;
+    msg += char(19);
+    msg += "BitTorrent protocol";
+    msg += reserved;
+    msg += info_hash;
+    msg += self_peer_id;
+
+    socket.SendData(msg);
+    auto resp = socket.ReceiveData(68);
+    if (resp.substr(28, 20) != info_hash) {
+        throw std::runtime_error("Peer answered with a different info-hash");
+    }
+    if (!(resp[25] & 0x10)) {
+        throw std::runtime_error("Peer does not support the extension protocol");
+    }
+}
+
+uint8_t MetadataFetcher::PerformExtendedHandshake(TcpConnection& socket) {
+    std::string handshake;
+    utils::BencodeWriter writer(handshake);
+    writer.BeginDict()
+        .Key("m").BeginDict()
+            .Key("ut_metadata").Integer(kUtMetadataId)
+        .End()
+    .End();
+    socket.SendData(ExtendedMessage(kExtendedHandshakeId, handshake));
+
+    // Bitfield and have messages may arrive before the peer's handshake.
+    for (int idle_reads = 0; idle_reads < kMaxIdleReads;) {
+        auto data = socket.ReceiveData();
+        if (data.empty()) {
+            ++idle_reads;
+            continue;
+        }
+
+        auto frame = wire::ParseFrame(data);
+        if (
+            frame.id != MessageId::kExtended
+            || frame.payload.empty()
+            || wire::Decode<wire::ExtendedHeader>(frame.payload).extension_id
+                != kExtendedHandshakeId
+        ) {
+            continue;
+        }
+
+        auto document = utils::BencodeDocument::FromString(
+            std::string(wire::Trailer<wire::ExtendedHeader>(frame.payload))
+        );
+        auto root = document.Root();
+        auto peer_metadata_id = root.Find("m").Find("ut_metadata").IntegerOr(0);
+        if (peer_metadata_id <= 0 || peer_metadata_id > 255) {
+            throw std::runtime_error("Peer does not support ut_metadata");
+        }
+
+        SetMetadataSize(root.Find("metadata_size").IntegerOr(0));
+        return static_cast<uint8_t>(peer_metadata_id);
+    }
+
+    throw std::runtime_error("No extension handshake from peer");
+}
+
+void MetadataFetcher::SetMetadataSize(size_t size) {
+    if (size == 0 || size > kMaxMetadataSize) {
+        throw std::runtime_error("Invalid metadata size " + std::to_string(size));
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (metadata_size == size) {
+        return;
+    }
+    if (metadata_size != 0) {
+        throw std::runtime_error("Peer disagrees on metadata size");
+    }
+
+    metadata_size = size;
+    metadata.assign(size, '\0');
+    piece_states.assign(
+        (size + kMetadataPieceSize - 1) / kMetadataPieceSize,
+        PieceState::kMissing
+    );
+}
+
+bool MetadataFetcher::ClaimPiece(const std::vector<size_t>& own_requests, size_t& index) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (done) {
+        return false;
+    }
+
+    auto missing = std::find(piece_states.begin(), piece_states.end(), PieceState::kMissing);
+    if (missing != piece_states.end()) {
+        *missing = PieceState::kRequested;
+        index = missing - piece_states.begin();
+        return true;
+    }
+
+    // Nothing left to hand out: race the peers still holding requests.
+    for (size_t i = 0; i < piece_states.size(); ++i) {
+        if (
+            piece_states[i] == PieceState::kRequested
+            && std::find(own_requests.begin(), own_requests.end(), i) == own_requests.end()
+        ) {
+            index = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+void MetadataFetcher::ReleasePieces(const std::vector<size_t>& indices) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t index : indices) {
+        if (piece_states[index] == PieceState::kRequested) {
+            piece_states[index] = PieceState::kMissing;
+        }
+    }
+}
+
+void MetadataFetcher::StorePiece(size_t index, std::string_view data) {
+    bool success;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (done || index >= piece_states.size()) {
+            return;
+        }
+
+        size_t offset = index * kMetadataPieceSize;
+        size_t expected = std::min(kMetadataPieceSize, metadata_size - offset);
+        if (data.size() != expected) {
+            throw std::runtime_error("Metadata piece has wrong size");
+        }
+        if (piece_states[index] == PieceState::kReceived) {
+            return;
+        }
+
+        std::copy(data.begin(), data.end(), metadata.begin() + offset);
+        piece_states[index] = PieceState::kReceived;
+        if (++received_pieces < piece_states.size()) {
+            return;
+        }
+
+        if (utils::CalculateSha1(metadata) != info_hash) {
+            // The bad piece cannot be attributed, so start over.
+            std::fill(piece_states.begin(), piece_states.end(), PieceState::kMissing);
+            received_pieces = 0;
+            if (++hash_failures < kMaxHashFailures) {
+                return;
+            }
+        }
+        success = hash_failures < kMaxHashFailures;
+    }
+
+    Finish(success);
+}
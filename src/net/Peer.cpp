@@ -0,0 +1,141 @@
+#include "net/Peer.hpp"
+
+#include <arpa/inet.h>
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+
+namespace {
+
+constexpr std::array<uint8_t, 12> kIpv4MappedPrefix = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff
+};
+
+// IPv4-mapped IPv6 addresses are stored as IPv4 peers, so both spellings
+// of one endpoint compare and hash equal.
+int FamilyOf(const std::array<uint8_t, 16>& address) {
+    bool mapped = std::equal(kIpv4MappedPrefix.begin(), kIpv4MappedPrefix.end(), address.begin());
+    return mapped ? AF_INET : AF_INET6;
+}
+
+} // namespace
+
+Peer Peer::FromIpv4(uint32_t address, uint16_t port) {
+    Peer peer;
+    std::copy(kIpv4MappedPrefix.begin(), kIpv4MappedPrefix.end(), peer.address.begin());
+    peer.address[12] = static_cast<uint8_t>(address >> 24);
+    peer.address[13] = static_cast<uint8_t>(address >> 16);
+    peer.address[14] = static_cast<uint8_t>(address >> 8);
+    peer.address[15] = static_cast<uint8_t>(address);
+    peer.port = port;
+    peer.family = AF_INET;
+    return peer;
+}
+
+Peer Peer::FromCompact(std::string_view bytes) {
+    if (bytes.size() != kCompactIpv4Size && bytes.size() != kCompactIpv6Size) {
+        throw std::runtime_error(
+            "Compact peer must be 6 or 18 bytes, got " + std::to_string(bytes.size())
+        );
+    }
+
+    auto byte = [&bytes](size_t index) { return static_cast<uint8_t>(bytes[index]); };
+    size_t address_size = bytes.size() - 2;
+    uint16_t port = static_cast<uint16_t>((byte(address_size) << 8) | byte(address_size + 1));
+
+    if (address_size == 4) {
+        return FromIpv4(
+            (uint32_t(byte(0)) << 24) | (uint32_t(byte(1)) << 16) | (uint32_t(byte(2)) << 8) | byte(3),
+            port
+        );
+    }
+
+    Peer peer;
+    std::memcpy(peer.address.data(), bytes.data(), peer.address.size());
+    peer.port = port;
+    peer.family = FamilyOf(peer.address);
+    return peer;
+}
+
+Peer Peer::FromString(std::string_view ip, uint16_t port) {
+    std::string text(ip);
+    if (text.size() > 2 && text.front() == '[' && text.back() == ']') {
+        text = text.substr(1, text.size() - 2);
+    }
+
+    in_addr ipv4;
+    if (inet_pton(AF_INET, text.c_str(), &ipv4) == 1) {
+        return FromIpv4(ntohl(ipv4.s_addr), port);
+    }
+
+    Peer peer;
+    if (inet_pton(AF_INET6, text.c_str(), peer.address.data()) != 1) {
+        throw std::runtime_error("Invalid peer address: " + text);
+    }
+    peer.port = port;
+    peer.family = FamilyOf(peer.address);
+    return peer;
+}
+
+Peer Peer::FromSockaddr(const sockaddr_storage& storage) {
+    if (storage.ss_family == AF_INET) {
+        const auto& ipv4 = reinterpret_cast<const sockaddr_in&>(storage);
+        return FromIpv4(ntohl(ipv4.sin_addr.s_addr), ntohs(ipv4.sin_port));
+    }
+    if (storage.ss_family != AF_INET6) {
+        throw std::runtime_error("Unsupported address family " + std::to_string(storage.ss_family));
+    }
+
+    const auto& ipv6 = reinterpret_cast<const sockaddr_in6&>(storage);
+    Peer peer;
+    std::memcpy(peer.address.data(), &ipv6.sin6_addr, peer.address.size());
+    peer.port = ntohs(ipv6.sin6_port);
+    peer.family = FamilyOf(peer.address);
+    return peer;
+}
+
+std::string Peer::Ip() const {
+    char text[INET6_ADDRSTRLEN] = {};
+    if (IsIpv6()) {
+        inet_ntop(AF_INET6, address.data(), text, sizeof(text));
+    } else {
+        inet_ntop(AF_INET, address.data() + 12, text, sizeof(text));
+    }
+    return text;
+}
+
+std::string Peer::ToString() const {
+    return (IsIpv6() ? "[" + Ip() + "]" : Ip()) + ":" + std::to_string(port);
+}
+
+socklen_t Peer::ToSockaddr(sockaddr_storage& storage) const {
+    storage = {};
+    if (IsIpv6()) {
+        auto& ipv6 = reinterpret_cast<sockaddr_in6&>(storage);
+        ipv6.sin6_family = AF_INET6;
+        ipv6.sin6_port = htons(port);
+        std::memcpy(&ipv6.sin6_addr, address.data(), address.size());
+        return sizeof(sockaddr_in6);
+    }
+
+    auto& ipv4 = reinterpret_cast<sockaddr_in&>(storage);
+    ipv4.sin_family = AF_INET;
+    ipv4.sin_port = htons(port);
+    std::memcpy(&ipv4.sin_addr, address.data() + 12, 4);
+    return sizeof(sockaddr_in);
+}
+
+std::string Peer::ToCompact() const {
+    size_t offset = IsIpv6() ? 0 : 12;
+    std::string bytes(reinterpret_cast<const char*>(address.data()) + offset, address.size() - offset);
+    bytes += static_cast<char>(port >> 8);
+    bytes += static_cast<char>(port & 0xff);
+    return bytes;
+}
+
+size_t PeerHash::operator()(const Peer& peer) const {
+    std::string_view bytes(reinterpret_cast<const char*>(peer.address.data()), peer.address.size());
+    return std::hash<std::string_view>{}(bytes) ^ (size_t(peer.port) << 1);
+}
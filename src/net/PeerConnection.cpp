@@ -1,36 +1,25 @@
 #include "net/PeerConnection.hpp"
 
+#include <cstring>
+#include <stdexcept>
+#include <string>
 #include <thread>
 
-#include "net/Message.hpp"
-#include "utils/byte_tools.hpp"
-
 using namespace std::chrono_literals;
 
-PeerConnection::PeerPiecesAvailability::PeerPiecesAvailability(
-    std::string bitfield,
-    size_t size
-) :
-    bitfield(std::move(bitfield)),
-    size(size)
-{}
-
-bool PeerConnection::PeerPiecesAvailability::IsPieceAvailable(
-    size_t index
-) const {
-    if (index >= size * 8) {
-        return false;
-    }
-    return (bitfield[index >> 3] >> (7 - (index & 7))) & 1;
-}
-
-void PeerConnection::PeerPiecesAvailability::SetPieceAvailability(
-    size_t index
-) {
-    if (index < size * 8) {
-        bitfield[index >> 3] |= (1 << (7 - (index & 7)));
-    }
-}
+const std::array<PeerConnection::MessageHandler, wire::kMessageIdCount>
+PeerConnection::kMessageHandlers = [] {
+    std::array<MessageHandler, wire::kMessageIdCount> handlers{};
+    handlers[static_cast<size_t>(MessageId::kChoke)] = &PeerConnection::OnChoke;
+    handlers[static_cast<size_t>(MessageId::kUnchoke)] = &PeerConnection::OnUnchoke;
+    handlers[static_cast<size_t>(MessageId::kInterested)] = &PeerConnection::OnInterested;
+    handlers[static_cast<size_t>(MessageId::kNotInterested)] = &PeerConnection::OnNotInterested;
+    handlers[static_cast<size_t>(MessageId::kHave)] = &PeerConnection::OnHave;
+    handlers[static_cast<size_t>(MessageId::kRequest)] = &PeerConnection::OnRequest;
+    handlers[static_cast<size_t>(MessageId::kPiece)] = &PeerConnection::OnPiece;
+    handlers[static_cast<size_t>(MessageId::kHashes)] = &PeerConnection::OnHashes;
+    return handlers;
+}();
 
 PeerConnection::PeerConnection(
     const Peer& peer,
@@ -39,8 +28,9 @@ PeerConnection::PeerConnection(
     PieceStorage& piece_storage
 ) : 
     torrent_file(torrent_file),
-    socket(peer.ip, peer.port, 3500ms, 3500ms),
+    socket(peer, 3500ms, 3500ms),
     self_peer_id(std::move(self_peer_id)),
+    pieces_availability(torrent_file.PieceCount()),
     piece_storage(piece_storage)
 {}
 
@@ -62,54 +52,96 @@ void PeerConnection::Run() {
     }
 
     Terminate();
+    socket.CloseConnection();
 }
 
 bool PeerConnection::EstablishConnection() {
     socket.EstablishConnection();
+    is_choking_peer = true;
     PerformHandshake();
+    SendBitfield();
     ReceiveBitfield();
     SendInterested();
     return true;
 }
 
 void PeerConnection::PerformHandshake() {
+    std::string reserved(8, '\0');
+    if (torrent_file.meta_version >= 2) {
+        reserved[7] |= 0x10;
+    }
+
     std::string msg;
     msg += char(19);
     msg += "BitTorrent protocol";
-    msg += std::string(8, '\0');
+    msg += reserved;
     msg += torrent_file.info_hash;
     msg += self_peer_id;
 
     socket.SendData(msg);
     auto resp = socket.ReceiveData(68);
     peer_id = resp.substr(48, 20);
+    supports_v2 = torrent_file.meta_version >= 2 && (resp[27] & 0x10);
+}
+
+void PeerConnection::SendBitfield() {
+    if (piece_storage.PiecesSavedToDiscCount() == 0) {
+        return;
+    }
+
+    auto message = wire::EncodeWithTrailer(
+        wire::BitField{},
+        piece_storage.SavedPiecesBitfield()
+    );
+    socket.SendData(message);
 }
 
 void PeerConnection::ReceiveBitfield() {
     auto data = socket.ReceiveData();
-    if (data.size() < 5) {
+    if (data.size() < wire::kHeaderSize) {
         return;
     }
 
-    if (data[4] == static_cast<char>(MessageId::kBitField)) {
-        auto bf = data.substr(5);
-        pieces_availability = PeerPiecesAvailability(
-            bf, (torrent_file.piece_hashes.size() + 7) / 8
+    auto frame = wire::ParseFrame(data);
+    if (frame.id == MessageId::kBitField) {
+        auto expected = (torrent_file.PieceCount() + 7) / 8;
+        if (frame.payload.size() != expected) {
+            throw std::runtime_error(
+                "Bitfield of " +
+                std::to_string(frame.payload.size()) +
+                " bytes, expected " +
+                std::to_string(expected)
+            );
+        }
+        pieces_availability = PieceSet::FromBitfield(
+            frame.payload,
+            torrent_file.PieceCount()
         );
     }
 }
 
 void PeerConnection::SendInterested() {
-    socket.SendData(
-        Message::Init(MessageId::kInterested, "").ToString()
-    );
+    auto message = wire::Encode<wire::Interested>();
+    socket.SendData({ message.data(), message.size() });
 }
 
 void PeerConnection::MainLoop() {
     while (!is_terminated) {
+        if (piece_in_progress && !piece_storage.IsInFlight(piece_in_progress)) {
+            piece_in_progress.reset();
+        }
+
         if (!piece_in_progress) {
             piece_in_progress = GetNextAvailablePiece();
             inflight_offsets.clear();
+            if (
+                piece_in_progress
+                && piece_in_progress->HasMerkleRoot()
+                && !piece_in_progress->HasBlockHashes()
+                && supports_v2
+            ) {
+                RequestBlockHashes(*piece_in_progress);
+            }
         }
 
         if (!piece_in_progress) {
@@ -142,72 +174,150 @@ void PeerConnection::MainLoop() {
 }
 
 PiecePtr PeerConnection::GetNextAvailablePiece() {
-    while (!is_terminated) {
-        auto piece = piece_storage.GetNextPieceToDownload();
-        if (!piece) {
-            return nullptr;
-        }
+    if (is_terminated) {
+        return nullptr;
+    }
 
-        if (pieces_availability.IsPieceAvailable(piece->GetIndex())) {
-            return piece;
-        }
+    return piece_storage.GetNextPieceToDownload(pieces_availability);
+}
+
+void PeerConnection::ProcessMessage(std::string_view data) {
+    auto frame = wire::ParseFrame(data);
+    auto id = static_cast<size_t>(frame.id);
+    if (id < kMessageHandlers.size() && kMessageHandlers[id]) {
+        (this->*kMessageHandlers[id])(frame.payload);
+    }
+}
 
-        piece_storage.Enqueue(piece);
+void PeerConnection::OnChoke(std::string_view) {
+    is_choked = true;
+    inflight_offsets.clear();
+    if (piece_in_progress) {
+        piece_in_progress->ResetPendingBlocks();
     }
-    return nullptr;
 }
 
-void PeerConnection::ProcessMessage(const std::string& data) {
-    auto msg = Message::Parse(data);
+void PeerConnection::OnUnchoke(std::string_view) {
+    is_choked = false;
+}
 
-    switch (msg.id) {
+// Peers that are interested are unchoked right away, uploads are only
+// served while this connection is downloading.
+void PeerConnection::OnInterested(std::string_view) {
+    if (is_choking_peer) {
+        is_choking_peer = false;
+        auto message = wire::Encode<wire::Unchoke>();
+        socket.SendData({ message.data(), message.size() });
+    }
+}
 
-    case MessageId::kUnchoke:
-        is_choked = false;
-        break;
+void PeerConnection::OnNotInterested(std::string_view) {
+    is_choking_peer = true;
+}
 
-    case MessageId::kChoke:
-        is_choked = true;
-        inflight_offsets.clear();
-        break;
+void PeerConnection::OnHave(std::string_view payload) {
+    auto have = wire::Decode<wire::Have>(payload);
+    pieces_availability.Insert(have.index);
+}
 
-    case MessageId::kHave: {
-        size_t index = utils::BytesToInt32(msg.payload);
-        pieces_availability.SetPieceAvailability(index);
-        break;
+void PeerConnection::OnRequest(std::string_view payload) {
+    auto request = wire::Decode<wire::Request>(payload);
+    if (
+        is_choking_peer
+        || request.length > kMaxServedBlockLength
+        || !piece_storage.IsPieceAlreadySaved(request.index)
+    ) {
+        return;
     }
 
-    case MessageId::kPiece: {
-        size_t index = utils::BytesToInt32(msg.payload.substr(0, 4));
-        size_t offset = utils::BytesToInt32(msg.payload.substr(4, 4));
-        auto block = msg.payload.substr(8);
-
-        if (piece_in_progress && piece_in_progress->GetIndex() == index) {
+    // A range outside of the piece throws and drops the connection.
+    auto block = piece_storage.ReadBlock(
+        request.index,
+        request.offset,
+        request.length
+    );
+    socket.SendData(wire::EncodeWithTrailer(
+        wire::PieceHeader{ request.index, request.offset },
+        block
+    ));
+}
 
-            piece_in_progress->SaveBlock(offset, block);
-            inflight_offsets.erase(offset);
+void PeerConnection::OnPiece(std::string_view payload) {
+    auto header = wire::Decode<wire::PieceHeader>(payload);
+    if (!piece_in_progress || piece_in_progress->GetIndex() != header.index) {
+        return;
+    }
 
-            if (piece_in_progress->AllBlocksRetrieved()) {
-                piece_storage.PieceProcessed(piece_in_progress);
-                piece_in_progress.reset();
-                inflight_offsets.clear();
-            }
-        }
-        break;
+    // A block of the wrong size or offset throws and drops the connection.
+    // One failing its merkle leaf is missing again and is requested once
+    // more by MainLoop, unless this peer keeps sending bad data.
+    bool valid = piece_in_progress->SaveBlock(
+        header.offset,
+        std::string(wire::Trailer<wire::PieceHeader>(payload))
+    );
+    inflight_offsets.erase(header.offset);
+    if (!valid && ++leaf_failures >= kMaxLeafFailures) {
+        has_failed = true;
+        HandleConnectionError();
+        Terminate();
+        return;
     }
 
-    default:
-        break;
-    
+    if (piece_in_progress->AllBlocksRetrieved()) {
+        piece_storage.PieceProcessed(piece_in_progress);
+        piece_in_progress.reset();
+        inflight_offsets.clear();
     }
 }
 
 void PeerConnection::RequestBlock(const Block* block) {
-    std::string payload;
-    payload += utils::Int32ToBytes(block->piece);
-    payload += utils::Int32ToBytes(block->offset);
-    payload += utils::Int32ToBytes(block->length);
-    socket.SendData(Message::Init(MessageId::kRequest, payload).ToString());
+    auto message = wire::Encode(wire::Request{
+        static_cast<uint32_t>(block->piece),
+        static_cast<uint32_t>(block->offset),
+        static_cast<uint32_t>(block->length),
+    });
+    socket.SendData({ message.data(), message.size() });
+}
+
+// BEP 52 hash request for the leaf layer under one piece. No proof is
+// needed, the leaves are checked against the piece's known root.
+void PeerConnection::RequestBlockHashes(const Piece& piece) {
+    const auto& layer = torrent_file.piece_layers[piece.GetIndex()];
+    wire::HashRequest request;
+    const auto& root = torrent_file.files[layer.file_index].pieces_root;
+    std::memcpy(request.pieces_root.data(), root.data(), request.pieces_root.size());
+    request.index = layer.first_leaf;
+    request.length = layer.leaf_count;
+
+    auto message = wire::Encode(request);
+    socket.SendData({ message.data(), message.size() });
+}
+
+void PeerConnection::OnHashes(std::string_view payload) {
+    static constexpr size_t kHashSize = sizeof(utils::Sha256Digest);
+    if (!piece_in_progress) {
+        return;
+    }
+
+    const auto& layer = torrent_file.piece_layers[piece_in_progress->GetIndex()];
+    auto header = wire::Decode<wire::HashesHeader>(payload);
+    auto hashes = wire::Trailer<wire::HashesHeader>(payload);
+    if (
+        std::string_view(header.pieces_root.data(), header.pieces_root.size())
+            != torrent_file.files[layer.file_index].pieces_root
+        || header.base_layer != 0
+        || header.index != layer.first_leaf
+        || header.length != layer.leaf_count
+        || hashes.size() < header.length * kHashSize
+    ) {
+        return;
+    }
+
+    std::vector<utils::Sha256Digest> leaves(header.length);
+    std::memcpy(leaves.data(), hashes.data(), header.length * kHashSize);
+    // Saved blocks that fail the check become missing and are requested
+    // again by MainLoop.
+    piece_in_progress->SetBlockHashes(std::move(leaves));
 }
 
 void PeerConnection::HandleConnectionError() {
@@ -219,7 +329,7 @@ void PeerConnection::HandleConnectionError() {
 
 void PeerConnection::Terminate() {
     is_terminated = true;
-    socket.CloseConnection();
+    socket.Interrupt();
 }
 
 bool PeerConnection::IsTerminated() const {
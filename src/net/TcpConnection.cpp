@@ -5,13 +5,11 @@
 #include "utils/byte_tools.hpp"
 
 TcpConnection::TcpConnection(
-    std::string ip,
-    int port,
+    const Peer& peer,
     std::chrono::milliseconds connect_timeout,
     std::chrono::milliseconds read_timeout
 ) :
-      ip(std::move(ip)),
-      port(port),
+      peer(peer),
       connect_timeout(connect_timeout),
       read_timeout(read_timeout),
       socket_fd(-1)
@@ -23,11 +21,7 @@ TcpConnection::~TcpConnection() {
 
 void TcpConnection::CloseConnection() {
     force_close.store(true);
-    if (socket_fd != -1) {
-        shutdown(socket_fd, SHUT_RDWR);
-        close(socket_fd);
-        socket_fd = -1;
-    }
+    CloseSocket();
 }
 
 bool TcpConnection::IsTerminated() const {
@@ -35,21 +29,40 @@ bool TcpConnection::IsTerminated() const {
 }
 
 void TcpConnection::ForceClose() {
+    CloseConnection();
+}
+
+void TcpConnection::Interrupt() {
     force_close.store(true);
+    std::lock_guard<std::mutex> lock(fd_mutex);
+    if (socket_fd != -1) {
+        shutdown(socket_fd, SHUT_RDWR);
+    }
+}
+
+void TcpConnection::CloseSocket() {
+    std::lock_guard<std::mutex> lock(fd_mutex);
     if (socket_fd != -1) {
+        shutdown(socket_fd, SHUT_RDWR);
         close(socket_fd);
         socket_fd = -1;
     }
 }
 
 void TcpConnection::EstablishConnection() {
-    force_close.store(false);
+    CloseSocket();
 
-    if (socket_fd != -1) {
-        close(socket_fd);
+    int new_fd = socket(peer.family, SOCK_STREAM, 0);
+    {
+        std::lock_guard<std::mutex> lock(fd_mutex);
+        socket_fd = new_fd;
+    }
+    // Checked once the descriptor is visible, so an Interrupt either shuts
+    // it down or is seen here.
+    if (force_close.load()) {
+        CloseSocket();
+        throw std::runtime_error("Connection closed");
     }
-
-    socket_fd = socket(AF_INET, SOCK_STREAM, 0);
     if (socket_fd == -1) {
         throw std::runtime_error(
             "Failed to create socket: " +
@@ -75,10 +88,8 @@ void TcpConnection::EstablishConnection() {
         sizeof(buffer_size)
     );
 
-    struct sockaddr_in server;
-    server.sin_addr.s_addr = inet_addr(ip.c_str());
-    server.sin_family = AF_INET;
-    server.sin_port = htons(port);
+    sockaddr_storage server;
+    socklen_t server_length = peer.ToSockaddr(server);
 
     fd_set fdset;
     struct timeval time_val;
@@ -89,7 +100,7 @@ void TcpConnection::EstablishConnection() {
     int code = connect(
         socket_fd,
         reinterpret_cast<struct sockaddr*>(&server),
-        sizeof(struct sockaddr_in)
+        server_length
     );
 
     if (code == 0) {
@@ -112,8 +123,7 @@ void TcpConnection::EstablishConnection() {
     switch (code) {
 
     case 0:
-        close(socket_fd);
-        socket_fd = -1;
+        CloseSocket();
         throw std::runtime_error("Connection timeout");
         break;
 
@@ -129,8 +139,7 @@ void TcpConnection::EstablishConnection() {
             return;
         }
 
-        close(socket_fd);
-        socket_fd = -1;
+        CloseSocket();
         throw std::runtime_error("Socket connection error");
         break;
     }
@@ -138,7 +147,7 @@ void TcpConnection::EstablishConnection() {
     }
 }
 
-void TcpConnection::SendData(const std::string& data) const {
+void TcpConnection::SendData(std::string_view data) const {
     if (force_close.load() || socket_fd == -1) {
         throw std::runtime_error("Connection closed");
     }
@@ -224,11 +233,7 @@ std::string TcpConnection::ReceiveData(size_t buffer_size) const {
     return message;
 }
 
-const std::string& TcpConnection::GetIp() const {
-    return ip;
-}
-
-int TcpConnection::GetPort() const {
-    return port;
+const Peer& TcpConnection::GetPeer() const {
+    return peer;
 }
 
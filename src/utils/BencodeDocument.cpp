@@ -0,0 +1,266 @@
+#include "utils/BencodeDocument.hpp"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <stdexcept>
+
+#include "utils/BencodeTokenizer.hpp"
+
+utils::BencodeDocument utils::BencodeDocument::Parse(InputBuffer buffer) {
+    BencodeDocument document;
+    document.buffer = std::move(buffer);
+    document.Build();
+    return document;
+}
+
+utils::BencodeDocument utils::BencodeDocument::FromFile(
+    const std::string& filename
+) {
+    return Parse(InputBuffer::FromFile(filename));
+}
+
+utils::BencodeDocument utils::BencodeDocument::FromString(std::string data) {
+    return Parse(InputBuffer::FromString(std::move(data)));
+}
+
+void utils::BencodeDocument::Build() {
+    std::string_view input = buffer.View();
+    BencodeTokenizer tokenizer(input);
+    BencodeToken token;
+
+    std::vector<uint32_t> parents;
+    std::array<uint32_t, BencodeTokenizer::kMaxDepth> open_containers;
+    std::array<size_t, BencodeTokenizer::kMaxDepth> open_offsets;
+    std::string_view pending_key;
+
+    while (tokenizer.Next(token)) {
+        if (token.is_key) {
+            pending_key = token.data;
+            continue;
+        }
+
+        if (token.type == BencodeToken::Type::kEnd) {
+            auto& container = nodes[open_containers[token.depth]];
+            size_t start = open_offsets[token.depth];
+            container.data = input.substr(start, token.offset + 1 - start);
+            continue;
+        }
+
+        uint32_t node_index = nodes.size();
+        uint32_t parent = UINT32_MAX;
+        if (token.depth > 0) {
+            parent = open_containers[token.depth];
+            ++nodes[parent].child_count;
+        }
+
+        Node node{};
+        node.key = pending_key;
+        pending_key = {};
+
+        switch (token.type) {
+
+        case BencodeToken::Type::kInteger:
+            node.type = Type::kInteger;
+            node.integer = token.integer;
+            node.data = input.substr(
+                token.offset,
+                token.data.data() + token.data.size() + 1 - input.data() - token.offset
+            );
+            break;
+
+        case BencodeToken::Type::kString:
+            node.type = Type::kString;
+            node.prefix_length = token.data.data() - input.data() - token.offset;
+            node.data = token.data;
+            break;
+
+        case BencodeToken::Type::kListBegin:
+        case BencodeToken::Type::kDictBegin:
+            node.type = token.type == BencodeToken::Type::kListBegin
+                ? Type::kList
+                : Type::kDict;
+            open_containers[token.depth + 1] = node_index;
+            open_offsets[token.depth + 1] = token.offset;
+            break;
+
+        default:
+            break;
+
+        }
+
+        nodes.push_back(node);
+        parents.push_back(parent);
+    }
+
+    uint32_t next_child = 0;
+    for (auto& node : nodes) {
+        node.first_child = next_child;
+        next_child += node.child_count;
+    }
+
+    children.resize(next_child);
+    std::vector<uint32_t> filled(nodes.size(), 0);
+    for (uint32_t i = 1; i < nodes.size(); ++i) {
+        uint32_t parent = parents[i];
+        children[nodes[parent].first_child + filled[parent]++] = i;
+    }
+
+    // Well-formed input already has sorted keys, which makes this cheap.
+    for (const auto& node : nodes) {
+        if (node.type != Type::kDict) {
+            continue;
+        }
+
+        auto begin = children.begin() + node.first_child;
+        auto by_key = [this](uint32_t lhs, uint32_t rhs) {
+            return nodes[lhs].key < nodes[rhs].key;
+        };
+        if (!std::is_sorted(begin, begin + node.child_count, by_key)) {
+            std::stable_sort(begin, begin + node.child_count, by_key);
+        }
+    }
+}
+
+utils::BencodeDocument::Value utils::BencodeDocument::Root() const {
+    if (nodes.empty()) {
+        return {};
+    }
+    return Value(this, 0);
+}
+
+utils::BencodeDocument::Value utils::BencodeDocument::Query(
+    std::string_view path
+) const {
+    Value current = Root();
+    size_t position = 0;
+
+    while (current && position < path.size()) {
+        if (path[position] == '.') {
+            ++position;
+            continue;
+        }
+
+        if (path[position] == '[') {
+            size_t close = path.find(']', position);
+            if (close == std::string_view::npos) {
+                throw std::invalid_argument(
+                    "Unterminated index in path: " + std::string(path)
+                );
+            }
+
+            size_t list_index = 0;
+            auto [end, error] = std::from_chars(
+                path.data() + position + 1,
+                path.data() + close,
+                list_index
+            );
+            if (error != std::errc() || end != path.data() + close) {
+                throw std::invalid_argument(
+                    "Invalid index in path: " + std::string(path)
+                );
+            }
+
+            current = current[list_index];
+            position = close + 1;
+            continue;
+        }
+
+        size_t end = path.find_first_of(".[", position);
+        if (end == std::string_view::npos) {
+            end = path.size();
+        }
+
+        current = current.Find(path.substr(position, end - position));
+        position = end;
+    }
+
+    return current;
+}
+
+bool utils::BencodeDocument::Value::Is(Type type) const {
+    return nodes && Get().type == type;
+}
+
+int64_t utils::BencodeDocument::Value::AsInteger() const {
+    if (!IsInteger()) {
+        throw std::runtime_error("Bencode value is not an integer");
+    }
+    return Get().integer;
+}
+
+std::string_view utils::BencodeDocument::Value::AsString() const {
+    if (!IsString()) {
+        throw std::runtime_error("Bencode value is not a string");
+    }
+    return Get().data;
+}
+
+int64_t utils::BencodeDocument::Value::IntegerOr(int64_t fallback) const {
+    return IsInteger() ? Get().integer : fallback;
+}
+
+std::string_view utils::BencodeDocument::Value::StringOr(
+    std::string_view fallback
+) const {
+    return IsString() ? Get().data : fallback;
+}
+
+std::string_view utils::BencodeDocument::Value::Raw() const {
+    if (!nodes) {
+        return {};
+    }
+
+    const Node& node = Get();
+    return {
+        node.data.data() - node.prefix_length,
+        node.data.size() + node.prefix_length
+    };
+}
+
+std::string_view utils::BencodeDocument::Value::Key() const {
+    return nodes ? Get().key : std::string_view();
+}
+
+size_t utils::BencodeDocument::Value::Size() const {
+    return nodes ? Get().child_count : 0;
+}
+
+utils::BencodeDocument::Value utils::BencodeDocument::Value::operator[](
+    size_t child_index
+) const {
+    if (!nodes || child_index >= Get().child_count) {
+        return {};
+    }
+
+    Value child = *this;
+    child.index = children[Get().first_child + child_index];
+    return child;
+}
+
+utils::BencodeDocument::Value utils::BencodeDocument::Value::Find(
+    std::string_view key
+) const {
+    if (!IsDict()) {
+        return {};
+    }
+
+    const uint32_t* begin = children + Get().first_child;
+    const uint32_t* end = begin + Get().child_count;
+    auto it = std::lower_bound(
+        begin,
+        end,
+        key,
+        [this](uint32_t node_index, std::string_view target) {
+            return nodes[node_index].key < target;
+        }
+    );
+
+    if (it == end || nodes[*it].key != key) {
+        return {};
+    }
+
+    Value child = *this;
+    child.index = *it;
+    return child;
+}
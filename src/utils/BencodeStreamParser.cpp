@@ -0,0 +1,200 @@
+#include "utils/BencodeStreamParser.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <stdexcept>
+
+utils::BencodeStreamParser::BencodeStreamParser(BencodeHandler& handler) :
+    handler(handler),
+    state(State::kValue),
+    depth(0),
+    digits_count(0),
+    string_remaining(0),
+    string_is_key(false)
+{}
+
+bool utils::BencodeStreamParser::IsComplete() const {
+    return state == State::kComplete;
+}
+
+void utils::BencodeStreamParser::Finish() const {
+    if (!IsComplete()) {
+        throw std::runtime_error("Unexpected end of input");
+    }
+}
+
+bool utils::BencodeStreamParser::ExpectsKey() const {
+    return is_dict[depth] && expects_key[depth];
+}
+
+void utils::BencodeStreamParser::EnterContainer(bool dict) {
+    if (depth + 1 >= kMaxDepth) {
+        throw std::runtime_error("Bencode nesting is too deep");
+    }
+
+    ++depth;
+    is_dict[depth] = dict;
+    expects_key[depth] = dict;
+}
+
+void utils::BencodeStreamParser::EndValue() {
+    if (depth == 0) {
+        state = State::kComplete;
+        return;
+    }
+
+    if (is_dict[depth]) {
+        expects_key[depth] = !expects_key[depth];
+    }
+    state = State::kValue;
+}
+
+void utils::BencodeStreamParser::BeginValue(char current_char) {
+    bool is_key = ExpectsKey();
+    if (is_key && current_char != 'e' && !('0' <= current_char && current_char <= '9')) {
+        throw std::runtime_error("Dictionary key must be a string");
+    }
+
+    if ('0' <= current_char && current_char <= '9') {
+        state = State::kStringLength;
+        string_is_key = is_key;
+        digits[0] = current_char;
+        digits_count = 1;
+        return;
+    }
+
+    switch (current_char) {
+
+    case 'i':
+        state = State::kInteger;
+        digits_count = 0;
+        break;
+
+    case 'l':
+    case 'd':
+        if (is_dict[depth]) {
+            expects_key[depth] = !expects_key[depth];
+        }
+        EnterContainer(current_char == 'd');
+        if (current_char == 'd') {
+            handler.OnDictBegin();
+        } else {
+            handler.OnListBegin();
+        }
+        break;
+
+    case 'e':
+        if (depth == 0) {
+            throw std::runtime_error("Unexpected end marker");
+        }
+        if (is_dict[depth] && !expects_key[depth]) {
+            throw std::runtime_error("Dictionary key without value");
+        }
+        --depth;
+        handler.OnEnd();
+        if (depth == 0) {
+            state = State::kComplete;
+        }
+        break;
+
+    default:
+        throw std::runtime_error(
+            "Invalid bencode character: " + std::string(1, current_char)
+        );
+
+    }
+}
+
+size_t utils::BencodeStreamParser::Feed(std::string_view chunk) {
+    size_t position = 0;
+
+    while (position < chunk.size() && state != State::kComplete) {
+        char current_char = chunk[position];
+
+        switch (state) {
+
+        case State::kValue:
+            BeginValue(current_char);
+            ++position;
+            break;
+
+        case State::kStringLength:
+        case State::kInteger: {
+            char terminator = state == State::kInteger ? 'e' : ':';
+            if (current_char != terminator) {
+                if (digits_count == digits.size()) {
+                    throw std::runtime_error("Bencode number is too long");
+                }
+                digits[digits_count++] = current_char;
+                ++position;
+                break;
+            }
+            ++position;
+
+            if (state == State::kInteger) {
+                int64_t value = 0;
+                auto [end, error] = std::from_chars(
+                    digits.data(),
+                    digits.data() + digits_count,
+                    value
+                );
+                if (error != std::errc() || end != digits.data() + digits_count) {
+                    throw std::runtime_error("Invalid integer");
+                }
+                handler.OnInteger(value);
+                EndValue();
+                break;
+            }
+
+            auto [end, error] = std::from_chars(
+                digits.data(),
+                digits.data() + digits_count,
+                string_remaining
+            );
+            if (error != std::errc() || end != digits.data() + digits_count) {
+                throw std::runtime_error("Invalid string length");
+            }
+
+            if (string_is_key) {
+                if (string_remaining > kMaxKeyLength) {
+                    throw std::runtime_error("Dictionary key is too long");
+                }
+                key.clear();
+            } else {
+                handler.OnStringBegin(string_remaining);
+            }
+            state = State::kStringData;
+            [[fallthrough]];
+        }
+
+        case State::kStringData: {
+            size_t available = std::min(string_remaining, chunk.size() - position);
+            auto fragment = chunk.substr(position, available);
+            position += available;
+            string_remaining -= available;
+
+            if (string_is_key) {
+                key.append(fragment);
+            } else if (!fragment.empty()) {
+                handler.OnStringData(fragment);
+            }
+
+            if (string_remaining == 0) {
+                if (string_is_key) {
+                    handler.OnKey(key);
+                } else {
+                    handler.OnStringEnd();
+                }
+                EndValue();
+            }
+            break;
+        }
+
+        default:
+            break;
+
+        }
+    }
+
+    return position;
+}
@@ -0,0 +1,141 @@
+#include "utils/BencodeTokenizer.hpp"
+
+#include <charconv>
+#include <stdexcept>
+#include <string>
+
+utils::BencodeTokenizer::BencodeTokenizer(std::string_view input) :
+    input(input),
+    index(0),
+    depth(0),
+    finished(false)
+{}
+
+size_t utils::BencodeTokenizer::Offset() const {
+    return index;
+}
+
+std::string_view utils::BencodeTokenizer::ReadString(size_t& position) const {
+    size_t colon = input.find(':', position);
+    if (colon == std::string_view::npos) {
+        throw std::runtime_error("Delimiter not found");
+    }
+
+    size_t length = 0;
+    auto [end, error] = std::from_chars(
+        input.data() + position,
+        input.data() + colon,
+        length
+    );
+    if (error != std::errc() || end != input.data() + colon) {
+        throw std::runtime_error(
+            "Invalid string length at offset " + std::to_string(position)
+        );
+    }
+
+    if (length > input.size() - colon - 1) {
+        throw std::runtime_error("Not enough data to read fixed amount");
+    }
+
+    position = colon + 1 + length;
+    return input.substr(colon + 1, length);
+}
+
+void utils::BencodeTokenizer::EnterContainer(bool dict) {
+    if (depth + 1 >= kMaxDepth) {
+        throw std::runtime_error("Bencode nesting is too deep");
+    }
+
+    ++depth;
+    is_dict[depth] = dict;
+    expects_key[depth] = dict;
+}
+
+bool utils::BencodeTokenizer::Next(BencodeToken& token) {
+    if (finished) {
+        return false;
+    }
+
+    if (index >= input.size()) {
+        throw std::runtime_error("Unexpected end of input");
+    }
+
+    token.offset = index;
+    token.depth = depth;
+    token.is_key = is_dict[depth] && expects_key[depth];
+    token.data = {};
+    token.integer = 0;
+
+    char current_char = input[index];
+    if (token.is_key && current_char != 'e' && !('0' <= current_char && current_char <= '9')) {
+        throw std::runtime_error(
+            "Dictionary key must be a string at offset " + std::to_string(index)
+        );
+    }
+
+    if ('0' <= current_char && current_char <= '9') {
+        token.type = BencodeToken::Type::kString;
+        token.data = ReadString(index);
+    } else if (current_char == 'i') {
+        size_t end = input.find('e', index + 1);
+        if (end == std::string_view::npos) {
+            throw std::runtime_error("Delimiter not found");
+        }
+
+        token.type = BencodeToken::Type::kInteger;
+        token.data = input.substr(index + 1, end - index - 1);
+        auto [last, error] = std::from_chars(
+            token.data.data(),
+            token.data.data() + token.data.size(),
+            token.integer
+        );
+        if (error != std::errc() || last != token.data.data() + token.data.size()) {
+            throw std::runtime_error(
+                "Invalid integer at offset " + std::to_string(index)
+            );
+        }
+        index = end + 1;
+    } else if (current_char == 'l' || current_char == 'd') {
+        token.type = current_char == 'l'
+            ? BencodeToken::Type::kListBegin
+            : BencodeToken::Type::kDictBegin;
+        ++index;
+    } else if (current_char == 'e') {
+        if (depth == 0) {
+            throw std::runtime_error("Unexpected end marker");
+        }
+        if (is_dict[depth] && !expects_key[depth]) {
+            throw std::runtime_error("Dictionary key without value");
+        }
+
+        token.type = BencodeToken::Type::kEnd;
+        token.is_key = false;
+        ++index;
+        --depth;
+    } else {
+        throw std::runtime_error(
+            "Invalid bencode character: " + std::string(1, current_char)
+        );
+    }
+
+    if (token.type != BencodeToken::Type::kEnd && is_dict[depth]) {
+        expects_key[depth] = !expects_key[depth];
+    }
+
+    if (
+        token.type == BencodeToken::Type::kListBegin
+        || token.type == BencodeToken::Type::kDictBegin
+    ) {
+        EnterContainer(token.type == BencodeToken::Type::kDictBegin);
+    }
+
+    if (depth == 0 && (
+        token.type == BencodeToken::Type::kEnd
+        || token.type == BencodeToken::Type::kString
+        || token.type == BencodeToken::Type::kInteger
+    )) {
+        finished = true;
+    }
+
+    return true;
+}
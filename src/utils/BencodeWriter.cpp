@@ -0,0 +1,205 @@
+#include "utils/BencodeWriter.hpp"
+
+#include <charconv>
+#include <stdexcept>
+
+utils::BencodeWriter::BencodeWriter(std::string& output) :
+    output(output),
+    depth(0),
+    complete(false),
+    hashed_offset(0)
+{
+    frames[0] = Frame{false, false, 0, 0, false};
+}
+
+bool utils::BencodeWriter::IsComplete() const {
+    return complete;
+}
+
+void utils::BencodeWriter::BeforeValue() {
+    if (complete) {
+        throw std::logic_error("Bencode value is already complete");
+    }
+
+    if (frames[depth].is_dict && frames[depth].expects_key) {
+        throw std::logic_error("Dictionary value written without a key");
+    }
+}
+
+void utils::BencodeWriter::AfterValue() {
+    if (depth == 0) {
+        complete = true;
+        return;
+    }
+
+    if (frames[depth].is_dict) {
+        frames[depth].expects_key = true;
+    }
+}
+
+void utils::BencodeWriter::Append(std::string_view data) {
+    output.append(data);
+    if (hasher && output.size() - hashed_offset >= kHashFlushSize) {
+        FlushHash();
+    }
+}
+
+void utils::BencodeWriter::Append(char ch) {
+    Append(std::string_view(&ch, 1));
+}
+
+void utils::BencodeWriter::FlushHash() {
+    hasher->Update(std::string_view(output).substr(hashed_offset));
+    hashed_offset = output.size();
+}
+
+utils::BencodeWriter& utils::BencodeWriter::Integer(int64_t value) {
+    BeforeValue();
+
+    char buffer[24];
+    buffer[0] = 'i';
+    auto [end, error] = std::to_chars(buffer + 1, buffer + sizeof(buffer) - 1, value);
+    static_cast<void>(error);
+    *end++ = 'e';
+    Append(std::string_view(buffer, end - buffer));
+
+    AfterValue();
+    return *this;
+}
+
+utils::BencodeWriter& utils::BencodeWriter::String(std::string_view value) {
+    BeforeValue();
+
+    char buffer[24];
+    auto [end, error] = std::to_chars(buffer, buffer + sizeof(buffer) - 1, value.size());
+    static_cast<void>(error);
+    *end++ = ':';
+    Append(std::string_view(buffer, end - buffer));
+    Append(value);
+
+    AfterValue();
+    return *this;
+}
+
+utils::BencodeWriter& utils::BencodeWriter::BeginList() {
+    BeforeValue();
+    if (depth + 1 >= kMaxDepth) {
+        throw std::logic_error("Bencode nesting is too deep");
+    }
+
+    Append('l');
+    frames[++depth] = Frame{false, false, 0, 0, false};
+    return *this;
+}
+
+utils::BencodeWriter& utils::BencodeWriter::BeginDict() {
+    BeforeValue();
+    if (depth + 1 >= kMaxDepth) {
+        throw std::logic_error("Bencode nesting is too deep");
+    }
+
+    Append('d');
+    frames[++depth] = Frame{true, true, 0, 0, false};
+    return *this;
+}
+
+utils::BencodeWriter& utils::BencodeWriter::Key(std::string_view key) {
+    Frame& frame = frames[depth];
+    if (!frame.is_dict || !frame.expects_key) {
+        throw std::logic_error("Dictionary key written outside of a dictionary");
+    }
+
+    if (frame.has_key) {
+        auto previous = std::string_view(output).substr(
+            frame.last_key_offset,
+            frame.last_key_length
+        );
+        if (key <= previous) {
+            throw std::logic_error(
+                "Dictionary keys must be unique and sorted: " + std::string(key)
+            );
+        }
+    }
+
+    char buffer[24];
+    auto [end, error] = std::to_chars(buffer, buffer + sizeof(buffer) - 1, key.size());
+    static_cast<void>(error);
+    *end++ = ':';
+    Append(std::string_view(buffer, end - buffer));
+
+    frame.last_key_offset = output.size();
+    frame.last_key_length = key.size();
+    frame.has_key = true;
+    Append(key);
+
+    frame.expects_key = false;
+    return *this;
+}
+
+utils::BencodeWriter& utils::BencodeWriter::End() {
+    if (depth == 0) {
+        throw std::logic_error("No open list or dictionary to end");
+    }
+    if (frames[depth].is_dict && !frames[depth].expects_key) {
+        throw std::logic_error("Dictionary key without value");
+    }
+
+    Append('e');
+    --depth;
+    AfterValue();
+    return *this;
+}
+
+utils::BencodeWriter& utils::BencodeWriter::Value(
+    const BencodeDocument::Value& value
+) {
+    if (value.IsInteger()) {
+        return Integer(value.AsInteger());
+    }
+
+    if (value.IsString()) {
+        return String(value.AsString());
+    }
+
+    if (value.IsList()) {
+        BeginList();
+        for (size_t i = 0; i < value.Size(); ++i) {
+            Value(value[i]);
+        }
+        return End();
+    }
+
+    if (value.IsDict()) {
+        BeginDict();
+        for (size_t i = 0; i < value.Size(); ++i) {
+            Key(value[i].Key());
+            Value(value[i]);
+        }
+        return End();
+    }
+
+    throw std::invalid_argument("Cannot encode a null bencode value");
+}
+
+utils::BencodeWriter& utils::BencodeWriter::Raw(std::string_view encoded) {
+    BeforeValue();
+    Append(encoded);
+    AfterValue();
+    return *this;
+}
+
+void utils::BencodeWriter::BeginHash() {
+    hasher.emplace();
+    hashed_offset = output.size();
+}
+
+utils::Sha1Digest utils::BencodeWriter::EndHash() {
+    if (!hasher) {
+        throw std::logic_error("EndHash called without BeginHash");
+    }
+
+    FlushHash();
+    auto digest = hasher->Finish();
+    hasher.reset();
+    return digest;
+}
@@ -0,0 +1,99 @@
+#include "utils/InputBuffer.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+utils::InputBuffer::~InputBuffer() {
+    Release();
+}
+
+utils::InputBuffer::InputBuffer(InputBuffer&& other) noexcept :
+    mapping(std::exchange(other.mapping, nullptr)),
+    mapping_size(std::exchange(other.mapping_size, 0)),
+    owned(std::move(other.owned))
+{}
+
+utils::InputBuffer& utils::InputBuffer::operator=(InputBuffer&& other) noexcept {
+    if (this != &other) {
+        Release();
+        mapping = std::exchange(other.mapping, nullptr);
+        mapping_size = std::exchange(other.mapping_size, 0);
+        owned = std::move(other.owned);
+    }
+    return *this;
+}
+
+utils::InputBuffer utils::InputBuffer::FromFile(const std::string& filename) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open file: " + filename);
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) < 0) {
+        int error = errno;
+        close(fd);
+        throw std::runtime_error(
+            "Cannot stat file " + filename + ": " + strerror(error)
+        );
+    }
+
+    InputBuffer result;
+    if (file_stat.st_size == 0) {
+        close(fd);
+        return result;
+    }
+
+    void* address = mmap(
+        nullptr,
+        file_stat.st_size,
+        PROT_READ,
+        MAP_PRIVATE,
+        fd,
+        0
+    );
+    int error = errno;
+    close(fd);
+
+    if (address == MAP_FAILED) {
+        throw std::runtime_error(
+            "Cannot map file " + filename + ": " + strerror(error)
+        );
+    }
+
+    result.mapping = address;
+    result.mapping_size = file_stat.st_size;
+    return result;
+}
+
+utils::InputBuffer utils::InputBuffer::FromString(std::string data) {
+    InputBuffer result;
+    result.owned = std::make_unique<std::string>(std::move(data));
+    return result;
+}
+
+std::string_view utils::InputBuffer::View() const {
+    if (mapping) {
+        return { static_cast<const char*>(mapping), mapping_size };
+    }
+
+    if (owned) {
+        return *owned;
+    }
+    return {};
+}
+
+void utils::InputBuffer::Release() {
+    if (mapping) {
+        munmap(mapping, mapping_size);
+        mapping = nullptr;
+        mapping_size = 0;
+    }
+}
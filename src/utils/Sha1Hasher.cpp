@@ -0,0 +1,31 @@
+#include "utils/Sha1Hasher.hpp"
+
+#include <stdexcept>
+
+utils::Sha1Hasher::Sha1Hasher() : context(EVP_MD_CTX_new()) {
+    if (!context || !EVP_DigestInit_ex(context.get(), EVP_sha1(), nullptr)) {
+        throw std::runtime_error("Failed to initialize SHA-1 context");
+    }
+}
+
+void utils::Sha1Hasher::Update(std::string_view data) {
+    if (!EVP_DigestUpdate(context.get(), data.data(), data.size())) {
+        throw std::runtime_error("SHA-1 update failed");
+    }
+}
+
+utils::Sha1Digest utils::Sha1Hasher::Finish() {
+    Sha1Digest digest;
+    unsigned int hash_length = 0;
+
+    if (!EVP_DigestFinal_ex(
+            context.get(),
+            reinterpret_cast<unsigned char*>(digest.data()),
+            &hash_length
+        ) || hash_length != digest.size()
+    ) {
+        throw std::runtime_error("SHA-1 finalization failed");
+    }
+
+    return digest;
+}
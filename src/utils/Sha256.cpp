@@ -0,0 +1,112 @@
+#include "utils/Sha256.hpp"
+
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include <openssl/evp.h>
+
+namespace {
+
+struct ContextDeleter {
+    void operator()(EVP_MD_CTX* context) const { EVP_MD_CTX_free(context); }
+};
+
+// Merkle trees hash many 64-byte nodes, where looking the digest up and
+// creating a context per call would cost more than the hash itself.
+const EVP_MD* Sha256Md() {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    static const EVP_MD* const md = EVP_MD_fetch(nullptr, "SHA256", nullptr);
+#else
+    static const EVP_MD* const md = EVP_sha256();
+#endif
+    return md;
+}
+
+EVP_MD_CTX* ThreadContext() {
+    thread_local std::unique_ptr<EVP_MD_CTX, ContextDeleter> context(EVP_MD_CTX_new());
+    if (!context) {
+        throw std::runtime_error("Failed to allocate SHA-256 context");
+    }
+    return context.get();
+}
+
+} // namespace
+
+utils::Sha256Digest utils::Sha256(std::string_view data) {
+    Sha256Digest digest;
+    unsigned int hash_length = 0;
+    EVP_MD_CTX* context = ThreadContext();
+    if (
+        !EVP_DigestInit_ex(context, Sha256Md(), nullptr)
+        || !EVP_DigestUpdate(context, data.data(), data.size())
+        || !EVP_DigestFinal_ex(
+            context,
+            reinterpret_cast<unsigned char*>(digest.data()),
+            &hash_length
+        )
+        || hash_length != digest.size()
+    ) {
+        throw std::runtime_error("SHA-256 failed");
+    }
+    return digest;
+}
+
+utils::Sha256Digest utils::Sha256Pair(
+    const Sha256Digest& left,
+    const Sha256Digest& right
+) {
+    char buffer[2 * sizeof(Sha256Digest)];
+    std::memcpy(buffer, left.data(), left.size());
+    std::memcpy(buffer + left.size(), right.data(), right.size());
+    return Sha256(std::string_view(buffer, sizeof(buffer)));
+}
+
+utils::Sha256Digest utils::MerkleRoot(
+    std::span<const Sha256Digest> nodes,
+    size_t width,
+    const Sha256Digest& pad
+) {
+    if (width == 0 || (width & (width - 1)) != 0 || nodes.size() > width) {
+        throw std::invalid_argument("Merkle tree width must be a power of two");
+    }
+    if (width == 1) {
+        return nodes.empty() ? pad : nodes[0];
+    }
+
+    // Only the populated prefix of each layer is stored; everything to its
+    // right is padding, which collapses to a single digest per layer.
+    std::vector<Sha256Digest> layer((nodes.size() + 1) / 2);
+    Sha256Digest layer_pad = pad;
+    std::span<const Sha256Digest> current = nodes;
+
+    while (width > 1) {
+        size_t count = (current.size() + 1) / 2;
+        for (size_t i = 0; i < count; ++i) {
+            const auto& right = 2 * i + 1 < current.size() ? current[2 * i + 1] : layer_pad;
+            layer[i] = Sha256Pair(current[2 * i], right);
+        }
+        layer_pad = Sha256Pair(layer_pad, layer_pad);
+        current = std::span<const Sha256Digest>(layer.data(), count);
+        width /= 2;
+    }
+
+    return current.empty() ? layer_pad : current[0];
+}
+
+utils::Sha256Digest utils::PadDigest(size_t leaf_count) {
+    Sha256Digest digest{};
+    for (size_t width = 1; width < leaf_count; width *= 2) {
+        digest = Sha256Pair(digest, digest);
+    }
+    return digest;
+}
+
+size_t utils::NextPowerOfTwo(size_t value) {
+    size_t result = 1;
+    while (result < value) {
+        result *= 2;
+    }
+    return result;
+}
@@ -4,6 +4,23 @@
 
 #include <openssl/sha.h>
 
+namespace {
+
+int HexValue(char ch) {
+    if (ch >= '0' && ch <= '9') {
+        return ch - '0';
+    }
+    if (ch >= 'a' && ch <= 'f') {
+        return ch - 'a' + 10;
+    }
+    if (ch >= 'A' && ch <= 'F') {
+        return ch - 'A' + 10;
+    }
+    return -1;
+}
+
+} // namespace
+
 std::int32_t utils::BytesToInt32(std::string_view bytes) {
     if (bytes.size() < 4) {
         throw std::runtime_error("BytesToInt32: not enough bytes");
@@ -78,3 +95,25 @@ std::string utils::BytesToHex(std::string_view bytes) {
     return HexEncode(bytes);
 }
 
+std::string utils::PercentDecode(std::string_view value) {
+    std::string result;
+    result.reserve(value.size());
+    for (size_t i = 0; i < value.size(); ++i) {
+        if (value[i] == '+') {
+            result += ' ';
+        } else if (
+            value[i] == '%'
+            && i + 2 < value.size()
+            && HexValue(value[i + 1]) >= 0
+            && HexValue(value[i + 2]) >= 0
+        ) {
+            result += static_cast<char>(
+                HexValue(value[i + 1]) << 4 | HexValue(value[i + 2])
+            );
+            i += 2;
+        } else {
+            result += value[i];
+        }
+    }
+    return result;
+}